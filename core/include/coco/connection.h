@@ -10,6 +10,8 @@
 
 #pragma once
 #include "coco/util/threading.h"
+#include "coco/util/histogram.h"
+#include "coco/util/rcu.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -81,6 +83,72 @@ enum FlowStatus
 };
 
 class PortBase;
+class TaskContext;
+
+/*! \brief Latency source that contributed to a sample, with the time spent
+ *  by its data queued in connections and computed by tasks along the path.
+ *  Times are in microseconds.
+ */
+struct TraceOrigin
+{
+    const TaskContext *source = nullptr;  //!< The latency source task
+    int long time = 0;          //!< When the source started the step that produced the data
+    int long queue_time = 0;    //!< Time spent waiting in connections
+    int long compute_time = 0;  //!< Time spent in the tasks between reading and writing the data
+};
+
+/*! \brief Origins of the data processed by a task in its current step.
+ *  Filled by the execution engine when latency is measured, that is when profiling
+ *  is enabled, and shared read-only by the samples written in the same step.
+ */
+struct TraceOrigins
+{
+    static const unsigned MAX_ORIGINS = 4;
+
+    TraceOrigin origins[MAX_ORIGINS];
+    unsigned origins_count = 0;
+    int long read_time = 0;  //!< Time up to which compute_time is accounted
+
+    /*! \brief Remove all the origins.
+     */
+    void clear() { origins_count = 0; }
+    /*! \brief Add a new origin. If the source is already present its timestamp is updated.
+     */
+    void addOrigin(const TaskContext *source, int long time);
+    /*! \brief Add the origins of another context. When both contain the same source
+     *  the freshest one, the one the task is actually computing on, is kept.
+     */
+    void merge(const TraceOrigins &other);
+};
+
+/*! \brief Trace context travelling with each sample through the connections.
+ *  It is filled by the writer task when the sample is added to a connection
+ *  and merged in the reader task when the sample is read, so that latency
+ *  can be measured along any path of the graph. The origins are referenced, not
+ *  copied, so a sample carries only a null pointer when latency is not measured.
+ */
+struct TraceContext
+{
+    std::shared_ptr<const TraceOrigins> origins;  //!< Null if no origin reached the writer
+    int long enqueue_time = 0;  //!< When the sample was added to the connection, 0 if not traced
+    uint64_t flow_id = 0;       //!< Identifier of the message in the execution trace, see util::Tracer
+
+    void clear() { origins.reset(); enqueue_time = 0; flow_id = 0; }
+};
+
+/*! \brief Size of the buffer of a connection and the data written into it.
+ *  Both are estimated from the size of the sample type, the memory owned by a sample,
+ *  e.g. the elements of a vector, is not included.
+ */
+struct ConnectionBufferStatistics
+{
+    std::size_t buffer_bytes = 0;  //!< Slots of the buffer times the size of a sample
+    uint64_t writes = 0;           //!< Samples written since the last reset, including the dropped ones
+    uint64_t written_bytes = 0;    //!< Bytes of the samples written since the last reset
+    double write_rate = 0;         //!< Bytes written per second since the last reset
+
+    std::string toString() const;
+};
 
 /*! \brief Base class for connections.
  *  Contains the basic funcitons to manage a connection.
@@ -119,6 +187,39 @@ public:
      * \return The lenght of the queue in the connection
      */
      virtual unsigned int queueLength() const = 0;
+    /*!
+     * \return Percentiles of the time spent by samples in the connection,
+     * available when profiling is enabled.
+     */
+    util::HistogramStatistics queueStatistics() const { return queue_histogram_.statistics(); }
+    /*!
+     * \return The number of samples of queueStatistics(), without computing the percentiles
+     */
+    uint64_t queueSamples() const { return queue_histogram_.count(); }
+    /*! \brief Reset the queueing statistics
+     */
+    void resetQueueStatistics() { queue_histogram_.reset(); }
+    /*!
+     * \return The size of the connection buffer and the bytes written per second.
+     */
+    ConnectionBufferStatistics bufferStatistics() const;
+    /*! \brief Restart counting the writes from now
+     */
+    void resetBufferStatistics();
+    /*!
+     * \return The samples written in the connection, including the dropped ones.
+     */
+    uint64_t writtenSamples() const { return written_.load(std::memory_order_relaxed); }
+    /*!
+     * \return The samples lost, refused because the buffer was full or
+     * overwritten before being read.
+     */
+    uint64_t droppedSamples() const { return dropped_.load(std::memory_order_relaxed); }
+    /*!
+     * \return The length of the queue after the last read or write. Unlike queueLength()
+     * it never locks the connection, so it can be read while the tasks are running.
+     */
+    unsigned queuedSamples() const { return queued_.load(std::memory_order_relaxed); }
 protected:
     /*! \brief Call InputPort::triggerComponent() function to trigger the owner component execution.
      */
@@ -126,12 +227,38 @@ protected:
     /*! \brief Once data has been read remove the trigger calling InputPort::removeTriggerComponent()
     */
     void removeTrigger();
+    /*! \brief Fill the trace context of a sample being written with the one of the writer task.
+     *  Called by the writer with the connection locked.
+     */
+    void sendTrace(TraceContext &trace);
+    /*! \brief Record the time spent by the sample in the connection and pass
+     *  its trace context to the reader task. Called by the reader.
+     */
+    void receiveTrace(const TraceContext &trace);
+    /*! \brief Count a write, called by the writer only so no read-modify-write is needed.
+     */
+    void countWrite(bool dropped)
+    {
+        written_.store(written_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (dropped)
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    void setQueued(unsigned length) { queued_.store(length, std::memory_order_relaxed); }
 
     std::shared_ptr<PortBase> input_;
     std::shared_ptr<PortBase> output_;
 
     FlowStatus data_status_;
     ConnectionPolicy policy_;
+    util::Histogram queue_histogram_;
+    const char *trace_name_;  //!< Name of the connection in the execution trace, interned
+    std::size_t sample_size_ = 0;
+    std::size_t buffer_bytes_ = 0;
+    std::atomic<uint64_t> reset_written_ = {0};  //!< written_ at the last reset
+    std::atomic<int long> reset_time_;           //!< Time of the last reset in us
+    std::atomic<uint64_t> written_ = {0};
+    std::atomic<uint64_t> dropped_ = {0};
+    std::atomic<unsigned> queued_ = {0};
 };
 
 /*!\brief Used to specify to the port factory which connection manager to instantiate.
@@ -146,12 +273,23 @@ enum class ConnectionManagerType {DEFAULT = 0, FARM};
 class ConnectionManager
 {
 public:
+    typedef std::vector<std::shared_ptr<ConnectionBase> > ConnectionList;
+
     virtual ~ConnectionManager() {}
     
     /*!
      * \param connection Shared pointer of the connection to be added at the \ref owner_ port.
      */
     bool addConnection(std::shared_ptr<ConnectionBase> connection);
+    /*! \brief Substitute a connection with a new one in the same position.
+     *  \return False if old_connection is not a connection of the port.
+     */
+    bool replaceConnection(const std::shared_ptr<ConnectionBase> &old_connection,
+                           const std::shared_ptr<ConnectionBase> &connection);
+    /*! \brief Remove a connection, returns once the task using the port no longer sees it.
+     *  \return False if connection is not a connection of the port.
+     */
+    bool removeConnection(const std::shared_ptr<ConnectionBase> &connection);
     /*!
      * \return If the associated port has any active connection.
      */
@@ -163,17 +301,29 @@ public:
      * in all the connection if not specified
      */
     int queueLenght(int connection = -1) const;
+    /*!
+     * \param connection The connection id, if -1 the statistics of all the connections are summed.
+     * \return The size of the connection buffers and their write rate.
+     */
+    ConnectionBufferStatistics bufferStatistics(int connection = -1) const;
     /*!
      * \return Number of connections.
      */
     int connectionsCount() const;
+    /*!
+     * \return A copy of the current list of connections, safe to iterate while
+     * connections are added and removed.
+     */
+    ConnectionList connections() const { return *connections_.read(); }
 
 private:
     friend class GraphLoader;
-    const std::vector<std::shared_ptr<ConnectionBase>> & connections() const { return connections_; }
 
 protected:
-    std::vector<std::shared_ptr<ConnectionBase> > connections_;  //!< List of ConnectionBase associate to \ref owner_
+    /*! List of ConnectionBase associate to \ref owner_. The task using the port reads it
+     *  without locking while connections are added and removed at runtime.
+     */
+    util::Rcu<ConnectionList> connections_;
 };
 
 
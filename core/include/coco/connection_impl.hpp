@@ -25,13 +25,23 @@
 namespace coco
 {
 
+/*! \brief Sample stored in the lock free queues together with its trace context.
+ */
+template <class T>
+struct TracedSample
+{
+    T value;
+    TraceContext trace;
+};
+
 /*! \brief Template class to manage the specialization of a connection.
  */
 template <class T>
 class ConnectionT : public ConnectionBase
 {
 public:
-    /*! \brief Simply call ConnectionBase constructor with the templated ports.
+    /*! \brief Call ConnectionBase constructor with the templated ports
+     *  and record the size of the buffer of the connection.
      */
     ConnectionT(std::shared_ptr<InputPort<T> > in,
                 std::shared_ptr<OutputPort<T> > out,
@@ -39,7 +49,11 @@ public:
         : ConnectionBase(in->sharedPtr(),
                          out->sharedPtr(),
                          policy)
-    {}
+    {
+        this->sample_size_ = sizeof(TracedSample<T>);
+        std::size_t slots = policy.data_policy == ConnectionPolicy::DATA ? 1 : policy.buffer_size;
+        this->buffer_bytes_ = slots * this->sample_size_;
+    }
 
     using ConnectionBase::ConnectionBase;
     /*! \brief Retreive data from the connection if present.
@@ -91,11 +105,8 @@ public:
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
-
+            this->receiveTrace(trace_);
+            this->setQueued(0);
             return NEW_DATA;
         }
         return this->data_status_;
@@ -130,6 +141,9 @@ public:
                 this->data_status_ = NEW_DATA;
             }
         }
+        this->sendTrace(trace_);
+        this->countWrite(old_status == NEW_DATA);
+        this->setQueued(1);
         /* trigger if the input port is an event port */
         if (this->input()->isEvent() &&
             old_status != NEW_DATA )
@@ -150,6 +164,7 @@ private:
     {
         T value_;
     };
+    TraceContext trace_;
     mutable std::mutex mutex_;
 };
 
@@ -185,11 +200,8 @@ public:
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
-
+            this->receiveTrace(trace_);
+            this->setQueued(0);
             return NEW_DATA;
         }
         return this->data_status_;
@@ -223,6 +235,9 @@ public:
                 this->data_status_ = NEW_DATA;
             }
         }
+        this->sendTrace(trace_);
+        this->countWrite(old_status == NEW_DATA);
+        this->setQueued(1);
         /* trigger if the input port is an event port */
         if (this->input_->isEvent() && old_status != NEW_DATA)
             this->trigger();
@@ -239,6 +254,7 @@ private:
     {
         T value_;
     };
+    TraceContext trace_;
 };
 
 template <class T>
@@ -253,14 +269,12 @@ public:
 
     FlowStatus data(T & data) final
     {
-        bool new_data = queue_.pop(data);
-        if (new_data)
+        TracedSample<T> sample;
+        if (queue_.pop(sample))
         {
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
-
+            data = std::move(sample.value);
+            this->receiveTrace(sample.trace);
+            this->setQueued(0);
             return NEW_DATA;
         }
         return NO_DATA;
@@ -268,9 +282,13 @@ public:
 
     bool addData(const T &input) final
     {
-        T tmp;
-        queue_.pop(tmp);
-        queue_.push(input);
+        TracedSample<T> sample;
+        bool overwritten = queue_.pop(sample);
+        sample.value = input;
+        this->sendTrace(sample.trace);
+        queue_.push(sample);
+        this->countWrite(overwritten);
+        this->setQueued(1);
 
         this->data_status_ = NEW_DATA;
         if (this->input_->isEvent())
@@ -288,7 +306,7 @@ public:
         return 0;
     }
 private:
-    boost::lockfree::spsc_queue<T, boost::lockfree::capacity<1> > queue_;
+    boost::lockfree::spsc_queue<TracedSample<T>, boost::lockfree::capacity<1> > queue_;
 };
 
 /*! \brief Specialized class for the type T to manage ConnectionPolicy::BUFFER/CIRCULAR_BUFFER ConnectionPolicy::LOCKED
@@ -303,6 +321,7 @@ public:
     : ConnectionT<T>(in, out, policy)
     {
         buffer_.set_capacity(policy.buffer_size);
+        traces_.set_capacity(policy.buffer_size);
     }
     /*! \brief Remove all data in the buffer and return the last value
      *  \param data The variable where to store data
@@ -311,10 +330,13 @@ public:
     {
         std::unique_lock<std::mutex> mlock(this->mutex_);
         bool status = false;
+        TraceContext trace;
         while (!buffer_.empty())
         {
             data = buffer_.front();
             buffer_.pop_front();
+            trace = traces_.front();
+            traces_.pop_front();
             status = true;
         }
         if (status)
@@ -322,10 +344,8 @@ public:
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
+            this->receiveTrace(trace);
+            this->setQueued(0);
         }
         return status ? NEW_DATA : NO_DATA;
     }
@@ -340,11 +360,9 @@ public:
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
-
+            this->receiveTrace(traces_.front());
+            traces_.pop_front();
+            this->setQueued(buffer_.size());
             return NEW_DATA;
         }
         return NO_DATA;
@@ -354,14 +372,25 @@ public:
     {
         std::unique_lock<std::mutex> mlock(this->mutex_);
 
-        if (buffer_.full())
+        bool full = buffer_.full();
+        if (full)
         {
             if (this->policy_.data_policy == ConnectionPolicy::CIRCULAR)
+            {
                 buffer_.pop_front();
+                traces_.pop_front();
+            }
             else
+            {
+                this->countWrite(true);
                 return false;
+            }
         }
         buffer_.push_back(input);
+        traces_.push_back(TraceContext());
+        this->sendTrace(traces_.back());
+        this->countWrite(full);
+        this->setQueued(buffer_.size());
 
         if (this->input_->isEvent() && !buffer_.full())
             this->trigger();
@@ -375,6 +404,7 @@ public:
     }
 private:
     boost::circular_buffer<T> buffer_;
+    boost::circular_buffer<TraceContext> traces_;  //!< Trace context of each sample in buffer_
     mutable std::mutex mutex_;
 };
 
@@ -389,7 +419,8 @@ public:
                       ConnectionPolicy policy)
         : ConnectionT<T>(in, out, policy)
     {
-        buffer_.resize(policy.buffer_size);
+        buffer_.set_capacity(policy.buffer_size);
+        traces_.set_capacity(policy.buffer_size);
     }
     /*! \brief Remove all data in the buffer and return the last value
      *  \param data The variable where to store data
@@ -397,21 +428,22 @@ public:
     FlowStatus newestData(T &data)
     {
         bool status = false;
+        TraceContext trace;
         while (!buffer_.empty())
         {
             status = true;
             data = buffer_.front();
             buffer_.pop_front();
+            trace = traces_.front();
+            traces_.pop_front();
         }
         if (status)
         {
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
+            this->receiveTrace(trace);
+            this->setQueued(0);
         }
         return status ? NEW_DATA : NO_DATA;
     }
@@ -425,11 +457,9 @@ public:
             if (this->input_->isEvent())
                 this->removeTrigger();
 
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
-
+            this->receiveTrace(traces_.front());
+            traces_.pop_front();
+            this->setQueued(buffer_.size());
             return NEW_DATA;
         }
         else
@@ -438,14 +468,25 @@ public:
 
     bool addData(const T &input) final
     {
-        if (buffer_.full())
+        bool full = buffer_.full();
+        if (full)
         {
             if (this->policy_.data_policy == ConnectionPolicy::CIRCULAR)
+            {
                 buffer_.pop_front();
+                traces_.pop_front();
+            }
             else
+            {
+                this->countWrite(true);
                 return false;
+            }
         }
         buffer_.push_back(input);
+        traces_.push_back(TraceContext());
+        this->sendTrace(traces_.back());
+        this->countWrite(full);
+        this->setQueued(buffer_.size());
         this->data_status_ = NEW_DATA;
         if (this->input_->isEvent() && !buffer_.full())
             this->trigger();
@@ -459,6 +500,7 @@ public:
     }
 private:
     boost::circular_buffer<T> buffer_;
+    boost::circular_buffer<TraceContext> traces_;  //!< Trace context of each sample in buffer_
 };
 
 /**
@@ -473,34 +515,33 @@ public:
                        ConnectionPolicy policy)
         : ConnectionT<T>(in, out, policy)
     {
-        queue_ = new boost::lockfree::spsc_queue<T>(policy.buffer_size);
+        queue_ = new boost::lockfree::spsc_queue<TracedSample<T> >(policy.buffer_size);
     }
 
     FlowStatus newestData(T & data)
     {
+        TracedSample<T> sample;
         bool once = false;
-        while (queue_->pop(data))
+        while (queue_->pop(sample))
             once = true;
 
         if (once)
         {
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
+            data = std::move(sample.value);
+            this->receiveTrace(sample.trace);
+            this->setQueued(0);
         }
         return once ? NEW_DATA : NO_DATA;
     }
 
     FlowStatus data(T & data) final
     {
-        bool new_data = queue_->pop(data);
-        if (new_data)
+        TracedSample<T> sample;
+        if (queue_->pop(sample))
         {
-            /* Propagate timestamp to calculate latency */
-            int long latency_time = this->output_->task()->latencyTimestamp();
-            if (latency_time > 0)
-                this->input_->task()->setLatencyTimestamp(latency_time);
+            data = std::move(sample.value);
+            this->receiveTrace(sample.trace);
+            this->setQueued(queue_->read_available());
             return NEW_DATA;
         }
         return NO_DATA;
@@ -508,19 +549,26 @@ public:
 
     bool addData(const T &input) final
     {
-        if (!queue_->push(input))
+        TracedSample<T> sample;
+        sample.value = input;
+        this->sendTrace(sample.trace);
+        bool full = !queue_->push(sample);
+        if (full)
         {
             if (this->policy_.data_policy == ConnectionPolicy::CIRCULAR)
             {
-                T dummy;
+                TracedSample<T> dummy;
                 queue_->pop(dummy);
-                queue_->push(input);
+                queue_->push(sample);
             }
             else
             {
+                this->countWrite(true);
                 return false;
             }
         }
+        this->countWrite(full);
+        this->setQueued(this->policy_.buffer_size - queue_->write_available());
         if (this->input_->isEvent())
             this->trigger();
 
@@ -533,7 +581,7 @@ public:
         //return queue_->read_available();
     }
 private:
-    boost::lockfree::spsc_queue<T> *queue_;
+    boost::lockfree::spsc_queue<TracedSample<T> > *queue_;
 };
 
 
@@ -627,14 +675,37 @@ public:
      *  \return Wheter new data was present in the connections
      */
     virtual FlowStatus readAll(std::vector<T> &data) = 0;
+    /*! \brief Same as readAll() for vectors with any allocator, e.g. util::ScratchVector.
+     */
+    template <class Alloc>
+    FlowStatus readAllInto(std::vector<T, Alloc> &data)
+    {
+        T toutput;
+        data.clear();
+
+        auto connections = this->connections_.read();
+        for (auto & conn : *connections)
+        {
+            while (typed(conn)->data(toutput) == NEW_DATA)
+                data.push_back(toutput);
+        }
+        return data.empty() ? NO_DATA : NEW_DATA;
+    }
     /*! \brief Used to retreive a specific connection
      *  \param idx Index of the desired connection
-     *  \return Shared ptr to the connection
+     *  \return Shared ptr to the connection, null if out of bound
      */
     std::shared_ptr<ConnectionT<T> > connection(unsigned idx)
     {
-        assert(idx < connections_.size() && "trying to access a connection out of bound");
-        return std::static_pointer_cast<ConnectionT<T> >(connections_[idx]);
+        auto connections = this->connections_.read();
+        if (idx >= connections->size())
+            return nullptr;
+        return std::static_pointer_cast<ConnectionT<T> >((*connections)[idx]);
+    }
+protected:
+    static ConnectionT<T> * typed(const std::shared_ptr<ConnectionBase> &connection)
+    {
+        return static_cast<ConnectionT<T> *>(connection.get());
     }
 };
 
@@ -657,12 +728,19 @@ public:
     virtual bool write(const T &data, const std::string &task_name) = 0;
     /*! \brief Used to retreive a specific connection
      *  \param idx Index of the desired connection
-     *  \return Shared ptr to the connection
+     *  \return Shared ptr to the connection, null if out of bound
      */
     std::shared_ptr<ConnectionT<T> > connection(unsigned idx)
     {
-        assert(idx < connections_.size() && "trying to access a connection out of bound");
-        return std::static_pointer_cast<ConnectionT<T> >(connections_[idx]);
+        auto connections = this->connections_.read();
+        if (idx >= connections->size())
+            return nullptr;
+        return std::static_pointer_cast<ConnectionT<T> >((*connections)[idx]);
+    }
+protected:
+    static ConnectionT<T> * typed(const std::shared_ptr<ConnectionBase> &connection)
+    {
+        return static_cast<ConnectionT<T> *>(connection.get());
     }
 };
 /*! \brief Default input connection manager
@@ -677,12 +755,12 @@ public:
      */
     FlowStatus read(T &data) final
     {
-        size_t size = this->connections_.size();
-        std::shared_ptr<ConnectionT<T> > conn;
+        auto connections = this->connections_.read();
+        size_t size = connections->size();
 
         for (unsigned int i = 0; i < size; ++i)
         {
-            conn = this->connection(this->rr_index_ % size);
+            auto conn = this->typed((*connections)[this->rr_index_ % size]);
 
             this->rr_index_ = (this->rr_index_ + 1) % size;
             if (conn->data(data) == NEW_DATA)
@@ -699,15 +777,7 @@ public:
      */
     FlowStatus readAll(std::vector<T> &data) final
     {
-        T toutput;
-        data.clear();
-
-        for (unsigned int i = 0; i < this->connections_.size(); ++i)
-        {
-            while (this->connection(i)->data(toutput) == NEW_DATA)
-                data.push_back(toutput);
-        }
-        return data.empty() ? NO_DATA : NEW_DATA;
+        return this->readAllInto(data);
     }
 private:
     unsigned int rr_index_ = 0;
@@ -724,9 +794,10 @@ public:
     bool write(const T &data) final
     {
         bool written = false;
-        for (unsigned int i = 0; i < this->connections_.size(); ++i)
+        auto connections = this->connections_.read();
+        for (auto & conn : *connections)
         {
-            written = this->connection(i)->addData(data) || written;
+            written = this->typed(conn)->addData(data) || written;
         }
         return written;
     }
@@ -737,10 +808,11 @@ public:
      */
     bool write(const T &data, const std::string &task_name) final
     {
-        for (unsigned int i = 0; i < this->connections_.size(); ++i)
+        auto connections = this->connections_.read();
+        for (auto & conn : *connections)
         {
-            if (this->connection(i)->hasComponent(task_name))
-                return this->connection(i)->addData(data);
+            if (conn->hasComponent(task_name))
+                return this->typed(conn)->addData(data);
         }
         return false;
     }
@@ -761,12 +833,12 @@ public:
       */
     FlowStatus read(T &data) final
     {
-        unsigned int size = this->connections_.size();
-        std::shared_ptr<ConnectionT<T> > conn;
+        auto connections = this->connections_.read();
+        unsigned int size = connections->size();
 
         for (unsigned int i = 0; i < size; ++i)
         {
-            conn = this->connection(this->rr_index_ % size);
+            auto conn = this->typed((*connections)[this->rr_index_ % size]);
 
             this->rr_index_ = (this->rr_index_ + 1) % size;
             if (conn->data(data) == NEW_DATA)
@@ -779,15 +851,7 @@ public:
 
     FlowStatus readAll(std::vector<T> &data) final
     {
-        T toutput;
-        data.clear();
-
-        for (unsigned int i = 0; i < this->connections_.size(); ++i)
-        {
-            while (this->connection(i)->data(toutput) == NEW_DATA)
-                data.push_back(toutput);
-        }
-        return data.empty() ? NO_DATA : NEW_DATA;
+        return this->readAllInto(data);
     }
 
 private:
@@ -802,10 +866,12 @@ public:
     {
         /* Write to a connection which is empty and whose task is idle
          * auto tmp_rr_index_ = rr_index_; */
-        unsigned int size = this->connections_.size();
+        auto connections = this->connections_.read();
+        unsigned int size = connections->size();
         for (unsigned int i = 0; i < size; ++i)
         {
-            auto conn_ptr = this->connection(rr_index_);
+            rr_index_ %= size;
+            auto conn_ptr = this->typed((*connections)[rr_index_]);
             if (!conn_ptr->hasNewData() && conn_ptr->input()->task()->state() == TaskState::IDLE)
             {
                 return conn_ptr->addData(data);
@@ -815,7 +881,8 @@ public:
         /* If there are no idle components iterate and find one that has at least the connection empty */
         for (unsigned int i = 0; i < size; ++i)
         {
-            auto conn_ptr = this->connection(rr_index_);
+            rr_index_ %= size;
+            auto conn_ptr = this->typed((*connections)[rr_index_]);
             if (!conn_ptr->hasNewData())
             {
                 return conn_ptr->addData(data);
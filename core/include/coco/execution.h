@@ -14,12 +14,18 @@
 #include <memory>
 #include <thread>
 #include <list>
+#include <vector>
+#include <string>
 
 #include "coco/util/threading.h"
 
 
 
 #include "coco/util/timing.h"
+#include "coco/util/perf_counters.h"
+#include "coco/util/arena.h"
+#include "coco/util/memory_account.h"
+#include "coco/connection.h"
 
 namespace coco
 {
@@ -65,6 +71,8 @@ struct SchedulePolicy
     int affinity = -1;  //!< Specifies the core id where to pin the activity. If -1 no affinity
     int priority = 0;
     int runtime = 0;
+    bool lock_memory = false;  //!< Lock the memory and prefault the scratch arena, for realtime activities
+    std::size_t prefault_bytes = 2 << 20;  //!< Scratch memory prefaulted when lock_memory is set
     std::list<unsigned int> available_core_id;  //!< Contains the list of the available cores where the activity can run
 };
 
@@ -98,6 +106,11 @@ public:
      *  When data from an event port is read decreases the trigger counter.
      */
     virtual void removeTrigger() = 0;
+    /*! \brief Wake up a triggered activity to execute the pending operations of its tasks
+     *  without calling their onUpdate(). Wake ups arriving before the activity runs are merged.
+     *  Periodic activities execute them at their next period.
+     */
+    virtual void wakeUp() = 0;
     /*! \brief Main execution function.
      *  Contains the main execution loop. Manage the period timer in case of a periodic activity
      *  and the condition variable for trigger activityies.
@@ -144,11 +157,37 @@ public:
      * \return a global unique identifier for the activity
      */
     uint32_t id() const { return guid_; }
+    /*!
+     * \return The periods in which the tasks of a periodic activity ran longer than the period.
+     */
+    uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
 protected:
+    /*!
+     * \return The name of the activity thread in the execution trace, listing its tasks.
+     */
+    std::string traceThreadName() const;
+    /*! \brief Open the hardware counters of the calling thread if they are enabled.
+     *  Must be called by the activity thread before executing the tasks.
+     */
+    void openPerfCounters();
+    /*! \brief When the policy requests it, lock the memory and prefault the stack and the
+     *  scratch arena of the calling thread, before the tasks are initialized.
+     */
+    void prepareMemory();
+    /*! \brief Call init() of every runnable on the activity thread, each one as soon as
+     *  RunnableInterface::readyToConfigure() is true, waiting for the other activities
+     *  if none is ready. Returns early if the activity is stopped.
+     */
+    void configureRunnables();
+
+    std::unique_ptr<util::PerfCounters> perf_counters_;
+    util::Arena scratch_;  //!< Scratch memory of the tasks, reset after every step
+
     std::list<std::shared_ptr<RunnableInterface> > runnable_list_;
     SchedulePolicy policy_;
     bool active_;
     std::atomic<bool> stopping_;
+    std::atomic<uint64_t> overruns_ = {0};  //!< Written only by the activity thread
 
     static uint32_t guid_gen;
     const uint32_t  guid_;
@@ -175,6 +214,10 @@ public:
     /*! \brief NOT IMPLEMENTED FOR SEQUENTIAL ACTIVITY
      */
     void removeTrigger() final;
+    /*! \brief A periodic activity runs the pending operations without waiting for
+     *  the end of the period, a triggered one runs them at every step anyway.
+     */
+    void wakeUp() final;
     /*! \brief Does nothing, nothing to join
      */
     void join() final;
@@ -182,6 +225,10 @@ public:
 protected:
 
     void entry() final;
+
+    bool wake_up_ = false;  //!< Protected by mutex_
+    std::mutex mutex_;
+    std::condition_variable cond_;  //!< Interrupts the wait for the next period
 };
 
 /*!
@@ -199,6 +246,7 @@ public:
     void stop() final;
     void trigger() final;
     void removeTrigger() final;
+    void wakeUp() final;
     void join() final;
     std::thread::id threadId() const final;
 protected:
@@ -206,6 +254,8 @@ protected:
     void entry() final;
 
     std::atomic<int> pending_trigger_ = {0};
+    bool wake_up_ = false;  //!< Protected by mutex_
+    const char *trace_name_;  //!< Interned, see util::Tracer::intern()
     std::unique_ptr<std::thread> thread_;
     std::mutex mutex_;
     std::condition_variable cond_;
@@ -222,9 +272,17 @@ public:
     /*! \brief Calls the component initialization function
      */
     virtual void init() = 0;
+    /*!
+     * \return If init() can be called, false while the runnables it is configured after
+     * have not completed their init().
+     */
+    virtual bool readyToConfigure() const { return true; }
     /*! \brief Execute one step of the loop.
      */
     virtual void step() = 0;
+    /*! \brief Execute only the pending operations, without a step of the loop.
+     */
+    virtual void stepPending() = 0;
     /*! \brief It is called When the execution is stopped.
     */
     virtual void finalize() = 0;
@@ -232,6 +290,19 @@ protected:
 };
 
 class TaskContext;
+
+/*! \brief Latency measured by a target task for the data coming from one source.
+ *  The queue and compute percentiles split the latency in the time spent waiting
+ *  in connections and the time spent in the tasks along the path.
+ */
+struct LatencyPathStatistics
+{
+    std::string source;  //!< Name of the source task
+    util::HistogramStatistics latency;
+    util::HistogramStatistics queue;
+    util::HistogramStatistics compute;
+};
+
 /*! \brief Container to manage the execution of a component.
  *  It is in charge of the component initialization, loop function
  *  and pending operations.
@@ -250,14 +321,48 @@ public:
 
 
     /*! \brief Calls the TaskContext::onConfig() function of the associated task.
+     *  Only the first call after construction or finalize() configures the task.
+     *  The activity calls it on its thread; with the parallel configuration of the
+     *  launcher it is called before by a startup thread and the activity skips it.
      */
     void init() final;
+    /*!
+     * \return If all the engines set with configureAfter() have completed init(),
+     * engines already destroyed are ignored.
+     */
+    bool readyToConfigure() const final;
+    /*! \brief The activity calls init() only after the given engines completed theirs.
+     *  Set by the launcher before starting the activities, used only once.
+     */
+    void configureAfter(const std::vector<std::shared_ptr<ExecutionEngine> > &engines);
+    /*!
+     * \return If init() has been called since construction or the last finalize().
+     */
+    bool isConfigured() const { return configured_; }
+    /*!
+     * \return If onConfig() has completed since construction or the last finalize().
+     */
+    bool configCompleted() const { return config_completed_.load(std::memory_order_acquire); }
+    /*!
+     * \return If the configuration barrier waits for this task, see ComponentRegistry::scheduleConfig().
+     */
+    bool configScheduled() const { return config_scheduled_; }
+    /*!
+     * \return If the completion of onConfig() has been counted by the configuration barrier.
+     */
+    bool configCounted() const { return config_counted_; }
     /*! \brief Execution step.
      *  Iterate over the task pending operations executing them and then
      *  and then executes the TaskContext::onUpdate() function.
      */
     void step() final;
+    /*! \brief Execute the pending operations of the task, used when the activity
+     *  is woken up by an operation call instead of a trigger. Traced and followed
+     *  by the reset of the scratch arena like step().
+     */
+    void stepPending() final;
     /*! Call the component stop function, TaskContext::stop().
+     *  A task started again afterwards is configured again.
      */
     void finalize() final;
     /*!
@@ -271,31 +376,91 @@ public:
     {
         return timer_.timeStatistics();
     }
-    /*! \brief Reset the statistics for the current task
+    /*!
+     *  \return The number of steps measured since the last reset of the statistics
+     */
+    unsigned long iterations() const
+    {
+        return timer_.iterations();
+    }
+    const util::Timer & timer() const { return timer_; }
+    /*!
+     *  \return The hardware counters per step, when they are enabled
      */
-    void resetTimeStatistics()
+    util::PerfStatistics perfStatistics() const
     {
-        timer_.reset();
+        return perf_.statistics();
     }
+    /*!
+     *  \return The memory allocated by the task, from the pools and the scratch arena
+     */
+    util::MemoryStatistics memoryStatistics() const
+    {
+        return memory_->statistics();
+    }
+    /*! \brief Reset the statistics for the current task
+     */
+    void resetTimeStatistics();
+    /*!
+     *  \return The latency of every path ending in this task, when it is a latency target
+     */
+    std::vector<LatencyPathStatistics> latencyStatistics() const;
+    /*! \brief Every step of the task starts a new latency path.
+     */
+    void setLatencySource() { latency_source_ = true; }
+    /*! \brief The task records the latency of all the paths reaching it.
+     */
+    void setLatencyTarget();
+    /*! \brief Fill the trace context of a sample written by the task during the current step.
+     */
+    void outgoingTrace(TraceContext &trace);
+    /*! \brief Merge the trace context of a sample read by the task during the current step.
+     *  \param now Time at which the sample was read.
+     */
+    void incomingTrace(const TraceContext &trace, int long now);
 
 private:
+    friend class ComponentRegistry;
+    static const unsigned MAX_LATENCY_PATHS = 8;
+
+    /*! \brief Statistics of one source reaching a latency target.
+     *  The slot is claimed by the activity thread publishing \ref source,
+     *  readers skip slots whose source is still null.
+     */
+    struct LatencyPath
+    {
+        std::atomic<const TaskContext *> source = {nullptr};
+        util::Histogram latency;
+        util::Histogram queue;
+        util::Histogram compute;
+    };
+    /*! \brief Record the latency of all the origins of the current step.
+     */
+    void recordLatency();
+    /*! \brief Account and release the scratch memory used by the last step.
+     */
+    void resetScratch();
+
     std::shared_ptr<TaskContext> task_;
     //bool stopped_;
+    std::atomic<bool> configured_ = {false};
+    std::atomic<bool> config_completed_ = {false};
+    std::atomic<bool> config_scheduled_ = {false};
+    std::atomic<bool> config_counted_ = {false};  //!< The configuration barrier counts every task once
+    std::vector<std::weak_ptr<ExecutionEngine> > config_after_;
 
     util::Timer timer_;
+    util::PerfAccumulator perf_;
+    /// Charged by the allocations of init() and step(), shared with the vectors still allocated
+    std::shared_ptr<util::MemoryAccount> memory_ = std::make_shared<util::MemoryAccount>();
+    const char *trace_name_ = nullptr;  //!< Name of the task interned at the first step
 
-public:
-    struct LatencyTimer
-    {
-        std::atomic<int long> start_time = {-1};
-        std::atomic<int long> tmp_time = {-1};
-        int long tot_time = 0;
-        unsigned long iterations = 0;
-        bool source = false;
-        bool target = false;
-        bool start = true;
-    };
-    LatencyTimer latency_timer;
+    bool latency_source_ = false;
+    std::unique_ptr<LatencyPath[]> latency_paths_;  //!< Allocated only for latency targets
+    TraceOrigins trace_;           //!< Origins of the data processed in the current step
+    int long trace_read_time_ = 0; //!< Time of the last read of the current step
+    /// Copy of trace_ shared by the samples written until the next read, null if stale
+    std::shared_ptr<const TraceOrigins> trace_published_;
 };
 
 }  // end of namespace coco
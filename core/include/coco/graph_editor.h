@@ -0,0 +1,65 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <string>
+
+#include "coco/execution.h"
+#include "coco/connection.h"
+
+namespace coco
+{
+
+/*! \brief Modifies the graph of a running application.
+ *  Implemented by the loader of the application and made available through
+ *  \ref ComponentRegistry::graphEditor(). Tasks are created with their own activity,
+ *  which is started and stopped separately. Connections are added and removed while
+ *  the tasks keep running, the ConnectionManager lists are swapped without blocking
+ *  the readers. All the functions log the reason of a failure and return false.
+ *  The edits are serialized with each other, the readers iterate the copies returned by
+ *  ComponentRegistry::tasks() and ComponentRegistry::activities().
+ */
+class GraphEditor
+{
+public:
+    virtual ~GraphEditor() {}
+
+    /*! \brief Create and configure a task, with a new activity that is not started.
+     *  \param class_name The name of the component.
+     *  \param instance_name The unique name of the new task.
+     *  \param library_name The library with the component, searched in the resources paths.
+     *         Can be empty if the component is already loaded.
+     *  \param policy The schedule of the activity of the task.
+     */
+    virtual bool addTask(const std::string &class_name, const std::string &instance_name,
+                         const std::string &library_name, const SchedulePolicy &policy) = 0;
+    /*! \brief Disconnect all the ports of a stopped task and destroy it.
+     *  Only tasks that are alone in their activity can be removed.
+     */
+    virtual bool removeTask(const std::string &instance_name) = 0;
+    /*! \brief Connect an output port to an input port.
+     *  The lock policy is ignored when both tasks run in the same activity.
+     */
+    virtual bool connectPorts(const std::string &src_task, const std::string &src_port,
+                              const std::string &dest_task, const std::string &dest_port,
+                              const ConnectionPolicy &policy) = 0;
+    virtual bool disconnectPorts(const std::string &src_task, const std::string &src_port,
+                                 const std::string &dest_task, const std::string &dest_port) = 0;
+    /*! \brief Start the activity executing the task. A stopped activity can be started again,
+     *  its tasks run onConfig() again before their first step.
+     */
+    virtual bool startTask(const std::string &instance_name) = 0;
+    /*! \brief Stop the activity executing the task and wait for its thread to end.
+     *  The other tasks of the same activity are stopped as well.
+     */
+    virtual bool stopTask(const std::string &instance_name) = 0;
+};
+
+}  // end of namespace coco
@@ -0,0 +1,93 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+
+/*! \brief Live values drawn over the graph by \ref GraphSvg::render().
+ *  task_load is the fraction of time spent in the step of every task, keyed by the task name.
+ *  connection_rate is the number of samples written per second, keyed by GraphSvg::connectionKey().
+ */
+struct GraphOverlay
+{
+    std::unordered_map<std::string, double> task_load;
+    std::unordered_map<std::string, double> connection_rate;
+};
+
+/*! \brief Draws the tasks of the ComponentRegistry and their connections as SVG, in process.
+ *  Tasks are boxes listing their input ports on the left, their output ports on the right
+ *  and their peers. The boxes are placed in columns following the direction of the
+ *  connections: cycles are broken, every task goes in the column after its farthest source
+ *  and the order inside the columns is refined with the barycenter heuristic.
+ *  The group of a task has id "task:NAME", the one of a connection "conn:KEY", so that the
+ *  web viewer can update the overlay without downloading the graph again.
+ */
+class COCOEXPORT GraphSvg
+{
+public:
+    /*! \brief Compute the layout of the current graph.
+     *  Safe while the graph is edited: the tasks, the activities and the connections are
+     *  copies taken under their locks. The ports of a task are created by its constructor
+     *  and its peers are attached only while the graph is loaded, the graph editor adds
+     *  tasks without peers.
+     */
+    void layout();
+    /*! \brief Serialize the last layout, with the values of overlay if not null.
+     */
+    std::string render(const GraphOverlay *overlay = nullptr) const;
+    bool empty() const { return nodes_.empty(); }
+
+    /*! \brief Key of a connection, also used by the web server for the connection statistics.
+     */
+    static std::string connectionKey(const std::string &src_task, const std::string &src_port,
+                                     const std::string &dest_task, const std::string &dest_port);
+
+private:
+    struct Port
+    {
+        std::string label;
+        double y = 0;  //!< Relative to the top of the box
+    };
+    struct Node
+    {
+        std::string name;
+        std::string caption;
+        std::vector<Port> inputs;
+        std::vector<Port> outputs;
+        std::vector<std::string> peers;
+        int layer = 0;
+        double order = 0;
+        double x = 0, y = 0, width = 0, height = 0;
+    };
+    struct Edge
+    {
+        std::string key;
+        std::size_t src, dest;        //!< Nodes
+        std::size_t src_port, dest_port;
+        bool event = false;
+    };
+
+    void assignLayers();
+    void orderLayers();
+    void placeNodes();
+
+    std::vector<Node> nodes_;
+    std::vector<Edge> edges_;
+    double width_ = 0, height_ = 0;
+};
+
+}  // end of namespace coco
@@ -0,0 +1,188 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+#include "coco/task.h"
+
+namespace coco
+{
+
+/*! \brief Result of an operation called with Service::callOperation().
+ *  The value is set by the called task when it executes the operation, before its next
+ *  onUpdate(). A continuation registered with then() is executed by the calling task, among
+ *  its pending operations, so request/response exchanges between tasks need neither polling
+ *  nor locks in the user code. For operations returning void the continuation takes no argument.
+ *  The result type must be default constructible.
+ */
+template <class T>
+class OperationFuture
+{
+    typedef typename std::conditional<std::is_void<T>::value, char, T>::type Value;
+
+public:
+    struct State
+    {
+        static const int VALUE = 1;
+        static const int CONTINUATION = 2;
+
+        std::atomic<int> status = {0};
+        Value value;
+        bool has_caller = false;
+        std::weak_ptr<Service> caller;  //!< A removed caller drops the continuation
+        util::InplaceFunction<void(const Value &), 64> continuation;
+
+        template <class F>
+        void run(F &call, const std::shared_ptr<State> &self)
+        {
+            set(call, std::is_void<T>());
+            if (status.fetch_or(VALUE, std::memory_order_acq_rel) & CONTINUATION)
+                dispatch(self);
+        }
+
+        void dispatch(const std::shared_ptr<State> &self)
+        {
+            if (!has_caller)
+            {
+                continuation(value);
+                return;
+            }
+            auto service = caller.lock();
+            if (!service)
+                return;
+            std::shared_ptr<State> state = self;
+            service->pushOperation([state]() { state->continuation(state->value); });
+            service->wakeUp();
+        }
+
+    private:
+        template <class F>
+        void set(F &call, std::false_type) { value = call(); }
+        template <class F>
+        void set(F &call, std::true_type) { call(); }
+    };
+
+    OperationFuture() {}
+    explicit OperationFuture(const std::shared_ptr<State> &state)
+        : state_(state)
+    {}
+
+    /*!
+     * \return False if the operation doesn't exist, in that case the future is never ready.
+     */
+    bool valid() const { return state_ != nullptr; }
+    /*!
+     * \return Whether the called task has executed the operation.
+     */
+    bool ready() const
+    {
+        return state_ && (state_->status.load(std::memory_order_acquire) & State::VALUE);
+    }
+    /*!
+     * \return The value returned by the operation, only meaningful once ready().
+     */
+    const Value & get() const { return state_->value; }
+    /*! \brief Execute fx with the result of the operation in the task caller, or in the
+     *  called task if caller is null. Only one continuation can be set.
+     *  The caller is held weakly, if it is removed before the result the continuation is dropped.
+     */
+    template <class F>
+    void then(Service *caller, F fx)
+    {
+        if (!state_)
+            return;
+        if (caller)
+        {
+            state_->has_caller = true;
+            state_->caller = caller->shared_from_this();
+        }
+        assignContinuation(fx, std::is_void<T>());
+        if (state_->status.fetch_or(State::CONTINUATION, std::memory_order_acq_rel) & State::VALUE)
+            state_->dispatch(state_);
+    }
+
+private:
+    template <class F>
+    void assignContinuation(F &fx, std::false_type)
+    {
+        state_->continuation.assign(fx);
+    }
+    template <class F>
+    void assignContinuation(F &fx, std::true_type)
+    {
+        state_->continuation.assign([fx](const Value &) mutable { fx(); });
+    }
+
+    std::shared_ptr<State> state_;
+};
+
+/*! \brief Calls many operations of a task waking it up once.
+ *  The called task executes the operations when the batch is submitted or destroyed.
+ */
+class OperationBatch
+{
+public:
+    explicit OperationBatch(Service &service)
+        : service_(service)
+    {}
+    ~OperationBatch()
+    {
+        submit();
+    }
+    OperationBatch(const OperationBatch &) = delete;
+    OperationBatch & operator=(const OperationBatch &) = delete;
+
+    /*! \brief Enqueue the operation like Service::callOperation() without waking up the task.
+     */
+    template <class Sig, class ...Args>
+    OperationFuture<typename std::function<Sig>::result_type> call(const std::string &name, Args... args)
+    {
+        auto future = service_.enqueueCall<Sig>(false, name, args...);
+        if (future.valid())
+            ++count_;
+        return future;
+    }
+    /*! \brief Wake up the task if operations were enqueued since the last submit.
+     */
+    void submit()
+    {
+        if (count_ > 0)
+            service_.wakeUp();
+        count_ = 0;
+    }
+
+private:
+    Service &service_;
+    unsigned count_ = 0;
+};
+
+template <class Sig, class ...Args>
+OperationFuture<typename std::function<Sig>::result_type> Service::enqueueCall(bool wake_up,
+                                                                              const std::string &name,
+                                                                              Args... args)
+{
+    typedef typename OperationFuture<typename std::function<Sig>::result_type>::State State;
+
+    std::function<Sig> fx = operation<Sig>(name);
+    if (!fx)
+        return OperationFuture<typename std::function<Sig>::result_type>();
+
+    auto state = std::make_shared<State>();
+    auto call = std::bind(fx, args...);
+    pushOperation([call, state]() mutable { state->run(call, state); });
+    if (wake_up)
+        wakeUp();
+    return OperationFuture<typename std::function<Sig>::result_type>(state);
+}
+
+}  // end of namespace coco
@@ -11,9 +11,13 @@
 
 #pragma once
 #include <vector>
+#include <functional>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #ifndef _WIN32
 #include <execinfo.h>
 #include <signal.h>
@@ -21,6 +25,7 @@
 #include "coco/task.h"
 #include "coco/execution.h"
 #include "coco/connection.h"
+#include "coco/graph_editor.h"
 
 namespace coco
 {
@@ -56,7 +61,9 @@ struct COCOEXPORT TypeSpec
 };
 /**
  * Component Registry that is singleton per each exec or library. Then when the component library is loaded 
- * the singleton is replaced
+ * the singleton is replaced.
+ * Libraries can be loaded and components created from multiple threads at the same time,
+ * e.g. by the parallel startup of the launcher.
  */
 class COCOEXPORT ComponentRegistry
 {
@@ -87,21 +94,46 @@ public:
 
     static bool profilingEnabled();
     static void enableProfiling(bool enable);
+    /// Hardware counters are collected for every step when profiling is enabled too
+    static bool perfCountersEnabled();
+    static void enablePerfCounters(bool enable);
 
     static int numTasks();
+    /// the configuration barrier waits for the onConfig() of the engine, each engine is counted once
+    static void scheduleConfig(const std::shared_ptr<ExecutionEngine> &engine);
+    /// tasks the barrier waits for, numTasks() until scheduleConfig() is called
+    static int numConfigScheduled();
     static int increaseConfigCompleted();
     static int numConfigCompleted();
+    /// blocks until all the scheduled tasks have completed onConfig() or abort is set,
+    /// the tasks still configuring are reported periodically
+    static void waitConfigCompleted(const std::atomic<bool> &abort);
+    /// blocks until ready() is true, checked every time a task completes onConfig(), or abort is set
+    static void waitConfigReady(const std::atomic<bool> &abort, const std::function<bool()> &ready);
+    /// wakes up the threads in waitConfigCompleted() so that they check their abort flag
+    static void notifyConfigWaiters();
 
     static void setResourcesPath(const std::vector<std::string> & resources_path);
     static std::string resourceFinder(const std::string &value);
 
-    static const std::unordered_map<std::string, std::shared_ptr<TaskContext> >& tasks();
+    /// copy of the tasks taken under the lock, can be iterated while the graph is edited
+    static std::unordered_map<std::string, std::shared_ptr<TaskContext> > tasks();
 
     // safe
     static  std::list<std::string> taskNames();
 
     static void setActivities(const std::vector<std::shared_ptr<Activity>> &activities);
-    static const std::vector<std::shared_ptr<Activity>>& activities();
+    /// copy of the activities taken under the lock, like tasks()
+    static std::vector<std::shared_ptr<Activity>> activities();
+    /// removes a task created at runtime, also from the count of the configured tasks
+    static bool removeTask(const std::string &name);
+
+    /// the editor of the running graph, null if the application cannot be modified
+    static void setGraphEditor(GraphEditor *editor);
+    static GraphEditor * graphEditor();
+    /// called after tasks or connections are added or removed, invalidates the drawings of the graph
+    static void increaseGraphVersion();
+    static uint64_t graphVersion();
 
 private:
     static ComponentRegistry & get();
@@ -116,15 +148,25 @@ private:
     TypeSpec *typeImpl(std::string name);
     TypeSpec *typeImpl(const std::type_info & ti);
     std::shared_ptr<TaskContext>  taskImpl(std::string name);
+    std::unordered_map<std::string, std::shared_ptr<TaskContext> > tasksImpl() const;
     void setActivitiesImpl(const std::vector<std::shared_ptr<Activity>> &activities);
+    std::vector<std::shared_ptr<Activity>> activitiesImpl() const;
+    bool removeTaskImpl(const std::string &name);
     std::list<std::string> taskNamesImpl() const;
 
     bool profilingEnabledImpl();
     void enableProfilingImpl(bool enable);
+    bool perfCountersEnabledImpl();
+    void enablePerfCountersImpl(bool enable);
 
     int numTasksImpl() const;
+    void scheduleConfigImpl(const std::shared_ptr<ExecutionEngine> &engine);
+    int numConfigScheduledImpl() const;
     int increaseConfigCompletedImpl();
     int numConfigCompletedImpl() const;
+    void waitConfigCompletedImpl(const std::atomic<bool> &abort);
+    void waitConfigReadyImpl(const std::atomic<bool> &abort, const std::function<bool()> &ready);
+    void notifyConfigWaitersImpl();
 
     void setResourcesPathImpl(const std::vector<std::string> & resources_path);
     std::string resourceFinderImpl(const std::string &value);
@@ -137,13 +179,22 @@ private:
     // Contains all the tasks created and it is accessible by every component
     std::unordered_map<std::string, std::shared_ptr<TaskContext> > tasks_;
     std::vector<std::shared_ptr<Activity>> activities_;
+    GraphEditor *graph_editor_ = nullptr;
+    std::atomic<uint64_t> graph_version_ = {0};
 
     std::vector<std::string> resources_paths_;
 
-    int tasks_config_ended_ = 0;
-    int num_tasks_ = 0;
+    std::atomic<int> tasks_config_ended_ = {0};
+    std::atomic<int> num_tasks_ = {0};
+    std::atomic<int> num_config_scheduled_ = {-1};  //!< -1 falls back to num_tasks_
+    std::atomic<int64_t> config_reported_ = {0};  //!< last report of the pending tasks, ms
+    std::mutex config_mutex_;
+    std::condition_variable config_cond_;  //!< Notified when a task completes onConfig()
+    /// protects specs_, typespecs_, libs_, tasks_ and activities_
+    mutable std::recursive_mutex mutex_;
 
     bool profiling_enabled_ = false;
+    bool perf_counters_enabled_ = false;
 };
 
 }  // end of namespace coco
@@ -157,7 +208,7 @@ private:
     coco::ComponentRegistry::numTasks()
 
 #define COCO_CONFIGURATION_COMPLETED \
-    coco::ComponentRegistry::numTasks() == coco::ComponentRegistry::numConfigCompleted()
+    (coco::ComponentRegistry::numConfigCompleted() >= coco::ComponentRegistry::numConfigScheduled())
 
 #define COCO_TERMINATE \
     raise(SIGINT);
@@ -10,8 +10,10 @@
 
 #pragma once
 #include <memory>
+#include <functional>
 #include <string>
 #include <list>
+#include <vector>
 
 #include "coco/util/threading.h"
 
@@ -21,6 +23,11 @@
 
 #include "coco/util/logging.h"
 #include "coco/util/timing.h"
+#include "coco/util/perf_counters.h"
+#include "coco/util/arena.h"
+#include "coco/util/memory_account.h"
+#include "coco/util/inplace_function.h"
+#include "coco/util/mpsc_queue.h"
 
 namespace coco
 {
@@ -34,6 +41,9 @@ struct CoCoException : public std::exception
 };
 
 class TaskContext;
+struct TraceContext;
+struct LatencyPathStatistics;
+struct ConnectionBufferStatistics;
 
 /*! \brief Used to set the value of components variables at runtime.
  *  Each Attribute is associated with a component class variable and it is identified by a name.
@@ -234,6 +244,11 @@ public:
       * \return The lenght of the queue
       */
     unsigned int queueLength(int connection = -1) const;
+    /*!
+     * \param connection The connection with the given id, if -1 all the connections are summed.
+     * \return The size of the buffers of the connections and their write rate.
+     */
+    ConnectionBufferStatistics bufferStatistics(int connection = -1) const;
     /*!
      *  \return The type info of the port type.
      */
@@ -251,6 +266,10 @@ public:
     {
         return shared_from_this();
     }
+    /*!
+     * \return A copy of the connections of the port, safe to iterate while the graph is edited.
+     */
+    std::vector<std::shared_ptr<ConnectionBase> > connections() const;
 protected:
     friend class ConnectionBase;
     friend class GraphLoader;
@@ -271,6 +290,21 @@ protected:
      * \param connection Add a connection to the port. In particular to the ConnectionManager of the port.
      */
     bool addConnection(std::shared_ptr<ConnectionBase> &connection);
+    /*! \brief Create a connection towards the other port without adding it to the ports.
+     *  \return Null if the ports cannot be connected.
+     */
+    virtual std::shared_ptr<ConnectionBase> newConnection(std::shared_ptr<PortBase> &other,
+                                                          ConnectionPolicy policy) = 0;
+    /*! \brief Substitute a connection of the port, keeping its position in the ConnectionManager.
+     *  Must be called by the thread executing the task owning the port.
+     */
+    bool replaceConnection(const std::shared_ptr<ConnectionBase> &old_connection,
+                           const std::shared_ptr<ConnectionBase> &connection);
+    /*! \brief Remove a connection from the ConnectionManager of the port.
+     *  Can be called by any thread, the task reading the connections is not stopped.
+     *  \return False if the connection doesn't belong to the port.
+     */
+    bool removeConnection(const std::shared_ptr<ConnectionBase> &connection);
     /*!
      *  \return The \ref ConnectionManager responsible for this port.
      */
@@ -289,12 +323,19 @@ protected:
 // Execution
 // -------------------------------------------------------------------
 
+template <class T>
+class OperationFuture;
+class OperationBatch;
+
 /*! \brief Support structure for enqueing operation in a component.
+ *  Node of the queue of the pending operations, taken from the pool of the component.
+ *  The bound operation and its arguments are stored inside the node when they fit in it.
  */
-struct COCOEXPORT OperationInvocation
+struct COCOEXPORT OperationInvocation : public util::MpscNode
 {
-    explicit OperationInvocation(const std::function<void(void)> &p);
-    std::function<void(void)> fx;
+    static const std::size_t INLINE_SIZE = 96;
+
+    util::InplaceFunction<void(), INLINE_SIZE> fx;
 };
 
 
@@ -311,7 +352,7 @@ public:
      */
     explicit Service(const std::string &name = "");
 
-    virtual ~Service() {}
+    virtual ~Service();
     /*!
      *  \return The container of the operations to iterate over it.
      */
@@ -331,9 +372,7 @@ public:
         std::function<Sig> fx = operation<Sig>(name);
         if (!fx)
             return false;
-        asked_ops_.push_back(OperationInvocation(
-                                // [=] () { fx(args...); }
-                                std::bind(fx, args...)));
+        pushOperation(std::bind(fx, args...));
         return true;
     }
 
@@ -357,21 +396,18 @@ public:
             return false;
         auto p = caller;
         auto ffx = std::bind(fx, args...);
-        asked_ops_.push_back(OperationInvocation(
-                                [ffx, p, return_fx] ()
-                                {
-                                    auto R = ffx();
-                                    if(!p)
-                                    {
-                                        return_fx(R);
-                                    }
-                                    else
-                                    {
-                                        std::unique_lock<std::mutex> lock(p->op_mutex_);
-                                        p->asked_ops_.push_back(
-                                            OperationInvocation([R, return_fx] () { returnfx(R); }));
-                                    }
-                                }));
+        pushOperation([ffx, p, return_fx] () mutable
+                      {
+                          auto R = ffx();
+                          if(!p)
+                          {
+                              return_fx(R);
+                          }
+                          else
+                          {
+                              p->pushOperation([R, return_fx] () { return_fx(R); });
+                          }
+                      });
         return true;
     }
 
@@ -392,6 +428,24 @@ public:
     {
         return enqueueOperation(0,return_fx,name,args...);
     }
+    /*! \brief Enqueue a function executed by the task before the next onUpdate(), together with
+     *  the enqueued operations. Can be called from any thread to modify the task while it runs.
+     */
+    void enqueuePending(std::function<void()> fx);
+    /*! \brief Call an operation of the task from any thread without waiting for it.
+     *  The operation is executed by the task before its next onUpdate(); a triggered task is
+     *  woken up to execute it without waiting for data. Use OperationBatch to call many
+     *  operations with a single wake up.
+     *  \param name The name of the operation.
+     *  \param args The arguments of the operation, copied.
+     *  \return The future receiving the value returned by the operation, see OperationFuture::then().
+     *          Not valid if the operation doesn't exist.
+     */
+    template <class Sig, class ...Args>
+    OperationFuture<typename std::function<Sig>::result_type> callOperation(const std::string & name, Args... args)
+    {
+        return enqueueCall<Sig>(true, name, args...);
+    }
     /*! Return the operation if name and signature match.
      *  \param name The name of the operation to be returned.
      *  \return An std::function object containing the operation if it exists, an empty container otherwise.
@@ -477,6 +531,8 @@ public:
 private:
     friend class AttributeBase;
     friend class OperationBase;
+    friend class OperationBatch;
+    template <class T> friend class OperationFuture;
     friend class PortBase;
     friend class ExecutionEngine;
     friend class GraphLoader;
@@ -504,9 +560,32 @@ private:
      * \return Wheter the component has pending enqueued operation to be executed.
      */
     bool hasPending() const;
-    /*! \brief Execute and remove the first pending operation.
+    /*! \brief Execute the operations enqueued before the call, the ones enqueued meanwhile
+     *  are left for the next step, so that the time spent is bounded.
+     *  Must be called only by the thread executing the task.
      */
     void stepPending();
+    /*! \brief Add a callable to the pending operations. Lock free, can be called from any thread.
+     *  Doesn't allocate unless all the nodes of the pool are in use or the callable doesn't fit in a node.
+     */
+    template <class F>
+    void pushOperation(F &&fx)
+    {
+        OperationInvocation *op = ops_pool_.acquire();
+        if (!op)
+            op = new OperationInvocation();
+        op->fx.assign(std::forward<F>(fx));
+        asked_ops_.push(op);
+    }
+    void releaseOperation(OperationInvocation *op);
+    /*! \brief Enqueue an operation call, defined in operation_future.h.
+     */
+    template <class Sig, class ...Args>
+    OperationFuture<typename std::function<Sig>::result_type> enqueueCall(bool wake_up, const std::string & name,
+                                                                          Args... args);
+    /*! \brief Wake up the activity executing the task to run the pending operations.
+     */
+    virtual void wakeUp() {}
     /*! \brief Add a peer to the list of peers, one peer object cannot be associated to more than one task.
      *  \param peer Pointer to the peer.
      */
@@ -537,9 +616,8 @@ private:
     std::unordered_map<std::string, std::shared_ptr<PortBase> > ports_;
     std::unordered_map<std::string, std::shared_ptr<AttributeBase> > attributes_;
     std::unordered_map<std::string, std::shared_ptr<OperationBase> > operations_;
-    std::list<OperationInvocation> asked_ops_;
-
-    std::mutex op_mutex_;
+    util::MpscQueue<OperationInvocation> asked_ops_;
+    util::NodePool<OperationInvocation, 16> ops_pool_;
 
 //    std::unordered_map<std::string, std::unique_ptr<Service> > subservices_;
 };
@@ -613,15 +691,73 @@ public:
      *  \return The aggregate time statics of the task
      */
     util::TimeStatistics timeStatistics();
+    /*!
+     *  \return The number of steps measured since the last reset, a cheap way to know
+     *  whether the statistics changed
+     */
+    unsigned long iterations();
+    /*!
+     *  \return The timer measuring the steps of the task, with the histograms of the
+     *  execution and service time
+     */
+    const util::Timer & timer() const;
+    /*!
+     *  \return The number of triggers received from the event ports
+     */
+    uint64_t triggers() const { return triggers_.load(std::memory_order_relaxed); }
+    /*!
+     *  \return The hardware counters per step of the task, when they are enabled
+     */
+    util::PerfStatistics perfStatistics();
+    /*!
+     *  \return The memory allocated by the task from the pools and the scratch arena
+     */
+    util::MemoryStatistics memoryStatistics();
     /*! \brief Reset the time statistics of this task
      */
     void resetTimeStatistics();
-
+    /*! \brief Memory for temporary data of the current step.
+     *  Inside an activity the arena is reset after every step of a task, so nothing
+     *  allocated from it can be kept across onUpdate() calls. Outside an activity
+     *  it is an arena of the calling thread that is never reset.
+     */
+    util::Arena & scratch();
+    /*! \brief Allocator for containers of temporary data, e.g. util::ScratchVector.
+     */
+    template <class T>
+    util::ArenaAllocator<T> scratchAllocator()
+    {
+        return util::ArenaAllocator<T>(&scratch());
+    }
+    /*!
+     *  \return The end-to-end latency of every path ending in this task,
+     *  available when the task is a latency target
+     */
+    std::vector<LatencyPathStatistics> latencyStatistics();
+    /*! \brief Mark the task as the start of latency paths.
+     *  Every sample produced by the task carries the time of the step that generated it.
+     *  Multiple tasks can be sources at the same time.
+     */
     void setTaskLatencySource();
+    /*! \brief Mark the task as the end of latency paths.
+     *  The task measures the latency from every source whose data reaches it.
+     */
     void setTaskLatencyTarget();
-
-    virtual int long latencyTimestamp();
-    virtual void setLatencyTimestamp(int long timestamp);
+    /*! \brief Declare that the task with the given instantiation name must complete
+     *  onConfig() before this task starts it. To be called in init().
+     */
+    void configureAfter(const std::string &task_name) { config_after_tasks_.push_back(task_name); }
+    /*! \brief Declare that the tasks connected to the given port must complete
+     *  onConfig() before this task starts it. To be called in init().
+     */
+    void configureAfterPort(const std::string &port_name) { config_after_ports_.push_back(port_name); }
+    /*! \brief Fill the trace context of a sample written by this task.
+     */
+    virtual void outgoingTrace(TraceContext &trace);
+    /*! \brief Merge in the task the trace context of a sample it has read.
+     *  \param now Time at which the sample was read.
+     */
+    virtual void incomingTrace(const TraceContext &trace, int long now);
 
 protected:
     friend class ExecutionEngine;
@@ -635,9 +771,11 @@ protected:
      */
     virtual void init() = 0;
     /*! \brief To be override by the user in the derived class.
-     *  Called in the activity thread before entering in the main execution loop.
-     *  There is no synchronization between config function of different tasks. This means that a task can enter in
-     *  the main loop while another task is still in the onConfig function.
+     *  Called once before entering in the main execution loop, on the thread of the activity,
+     *  following the order declared with configureAfter() and configureAfterPort().
+     *  No task enters the main loop before all the tasks have completed onConfig().
+     *  When the launcher is run with --parallel_config, onConfig() runs instead on a startup
+     *  thread, so per thread settings must not be applied here.
      */
     virtual void onConfig() = 0;
     /*! \brief To be override by the user in the derived class.
@@ -652,6 +790,7 @@ protected:
 private:
     friend class GraphLoader;
     friend class PortBase;
+    friend class ComponentRegistry;
     // TODO resolve this abomination!
 //    template <class T>
 //    friend class ConnectionDataL;
@@ -678,6 +817,9 @@ private:
     /*! \brief When the data from a triggered input port is read, it decreases the trigger count from the owing activity.
      */
     void removeTriggerActivity();
+    /*! \brief Wake up the owing activity to execute the called operations, see Activity::wakeUp().
+     */
+    void wakeUp() final;
     /*! \brief Pass to the task the pointer to the engine using managing the task.
      *  \param engine Shared pointer to the engine.
      */
@@ -697,6 +839,10 @@ private:
      * \param name The name of the port
      */
     void addEventPort(const std::string &name) { ++event_port_num_; }
+    /*!
+     * \brief Called when the connection of an event port is removed at runtime.
+     */
+    void removeEventPort() { --event_port_num_; }
 
 private:
     std::shared_ptr<Activity> activity_;  // TaskContext is owned by activity
@@ -707,11 +853,15 @@ private:
     /* Variables used for waiting on all event ports */
     // TODO move this variable in a private structure
     std::unordered_set<std::string> event_ports_;
-    unsigned int event_port_num_ = 0;
+    std::atomic<unsigned int> event_port_num_ = {0};
+    std::atomic<uint64_t> triggers_ = {0};
     std::unique_ptr<AttributeBase> att_wait_all_trigger_;
     bool wait_all_trigger_ = false;
     bool forward_check_ = true;
     std::mutex all_trigger_mutex_;
+
+    std::vector<std::string> config_after_tasks_;  //!< Tasks to be configured before this one
+    std::vector<std::string> config_after_ports_;  //!< Ports whose connected tasks are configured before this one
 };
 
 /*!
@@ -730,8 +880,8 @@ public:
      */
     std::shared_ptr<TaskContext> fatherTask() { return father_; }
 
-    virtual int long latencyTimestamp() final;
-    virtual void setLatencyTimestamp(int long timestamp) final;
+    virtual void outgoingTrace(TraceContext &trace) final;
+    virtual void incomingTrace(const TraceContext &trace, int long now) final;
 
 private:
     friend class GraphLoader;
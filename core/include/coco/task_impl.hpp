@@ -14,6 +14,7 @@
 #include "coco/util/accesses.hpp"
 #include "coco/connection.h"
 #include "coco/task.h"
+#include "coco/operation_future.h"
 
 // cannot use this: CLang says duplicate although this is a
 namespace boost {
@@ -318,6 +319,15 @@ public:
         assert(this->manager_ && "Before reading a port, instantiate the ConnectionManager");
         return std::static_pointer_cast<ConnectionManagerInputT<T> >(this->manager_)->readAll(data);
     }
+    /*! \brief Read the data of all the connections in a vector with a custom allocator,
+     *  e.g. a util::ScratchVector built with TaskContext::scratchAllocator() to avoid heap allocations.
+     */
+    template <class Alloc>
+    FlowStatus readAll(std::vector<T, Alloc> &data)
+    {
+        assert(this->manager_ && "Before reading a port, instantiate the ConnectionManager");
+        return std::static_pointer_cast<ConnectionManagerInputT<T> >(this->manager_)->readAllInto(data);
+    }
     /*!
      * \return True if the port has incoming new data;
      */
@@ -326,6 +336,15 @@ private:
     friend class OutputPort<T>;
     friend class GraphLoader;
 
+    std::shared_ptr<ConnectionBase> newConnection(std::shared_ptr<PortBase> &other,
+                                                  ConnectionPolicy policy) final
+    {
+        auto output = std::dynamic_pointer_cast<OutputPort<T> >(other);
+        if (!output || task_->sharedPtr() == output->task())
+            return nullptr;
+        return makeConnection(std::static_pointer_cast<InputPort<T> >(this->sharedPtr()),
+                              output, policy);
+    }
     /*! \brief Called by \ref connectTo(), does the actual connection once the type have been checked.
      *  \param other The other port to which to connect.
      *  \param policy The connection policy.
@@ -426,6 +445,15 @@ private:
     friend class InputPort<T>;
     friend class GraphLoader;
 
+    std::shared_ptr<ConnectionBase> newConnection(std::shared_ptr<PortBase> &other,
+                                                  ConnectionPolicy policy) final
+    {
+        auto input = std::dynamic_pointer_cast<InputPort<T> >(other);
+        if (!input || task_->sharedPtr() == input->task())
+            return nullptr;
+        return makeConnection(std::static_pointer_cast<OutputPort<T> >(this->sharedPtr()),
+                              input, policy);
+    }
     /*! \brief Called by \ref connectTo(), does the actual connection once the type have been checked.
      *  \param other The other port to which to connect.
      *  \param policy The connection policy.
@@ -0,0 +1,159 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+
+/* Layout of the telemetry shared memory segment: a TelemetryHeader followed by
+ * max_tasks TelemetryTask and max_connections TelemetryConnection records.
+ * The publisher and the readers must be built with the same TELEMETRY_VERSION.
+ */
+static const uint32_t TELEMETRY_VERSION = 1;
+static const std::size_t TELEMETRY_NAME_SIZE = 64;
+
+/*! \brief Statistics of a task in the telemetry segment. Times are in seconds.
+ */
+struct TelemetryTask
+{
+    char name[TELEMETRY_NAME_SIZE];
+    uint32_t state;            //!< TaskState
+    uint32_t reserved;
+    uint64_t steps;            //!< Steps since the last reset of the statistics
+    uint64_t triggers;         //!< Triggers received from the event ports
+    double time_last;
+    double time_mean;
+    double time_stddev;
+    double time_min;
+    double time_max;
+    double service_mean;
+    double service_stddev;
+    uint64_t memory_live_bytes;
+    uint64_t memory_allocations;
+};
+
+/*! \brief Counters of a connection in the telemetry segment.
+ */
+struct TelemetryConnection
+{
+    char src[TELEMETRY_NAME_SIZE];
+    char src_port[TELEMETRY_NAME_SIZE];
+    char dest[TELEMETRY_NAME_SIZE];
+    char dest_port[TELEMETRY_NAME_SIZE];
+    uint32_t queued;           //!< Samples in the queue after the last access
+    uint32_t reserved;
+    uint64_t written;
+    uint64_t dropped;
+};
+
+/*! \brief Beginning of the telemetry segment.
+ *  All the fields after seq and all the records are protected by the seqlock:
+ *  the publisher makes seq odd while it writes, a reader copies the data and
+ *  retries if seq was odd or changed in the meantime.
+ */
+struct TelemetryHeader
+{
+    char magic[8];             //!< "COCOTLM"
+    uint32_t version;          //!< TELEMETRY_VERSION
+    uint32_t max_tasks;
+    uint32_t max_connections;
+    uint32_t pid;              //!< Process publishing the segment
+    uint32_t period_us;        //!< Time between two updates
+    std::atomic<uint32_t> seq;
+    uint32_t graph_version;    //!< Increased when tasks or connections are added or removed
+    uint32_t task_count;
+    uint32_t connection_count;
+    uint64_t updates;          //!< Number of updates since the segment was created
+    int64_t time_us;           //!< Time of the last update, see util::time()
+};
+
+/*! \brief Consistent copy of the telemetry segment.
+ */
+struct TelemetrySnapshot
+{
+    uint32_t pid = 0;
+    uint32_t period_us = 0;
+    uint32_t graph_version = 0;
+    uint64_t updates = 0;
+    int64_t time_us = 0;
+    std::vector<TelemetryTask> tasks;
+    std::vector<TelemetryConnection> connections;
+};
+
+/*! \brief Publishes the statistics of the tasks and of the connections in a POSIX shared
+ *  memory segment, so that other processes, like coco_monitor, can read them at high rate
+ *  without the web server. A thread of its own copies the values from the same relaxed
+ *  atomics and seqlocks used by the web server, so the activities are never blocked.
+ *  The list of tasks and connections is collected by start() and refresh(), the
+ *  publishing thread never iterates the ComponentRegistry.
+ */
+class COCOEXPORT Telemetry
+{
+public:
+    static const unsigned DEFAULT_PERIOD_US = 1000;
+    static const unsigned DEFAULT_MAX_TASKS = 256;
+    static const unsigned DEFAULT_MAX_CONNECTIONS = 1024;
+
+    /*! \brief Create the segment /name, replacing an existing one, and start publishing.
+     */
+    static bool start(const std::string &name, unsigned period_us = DEFAULT_PERIOD_US,
+                      unsigned max_tasks = DEFAULT_MAX_TASKS,
+                      unsigned max_connections = DEFAULT_MAX_CONNECTIONS);
+    /*! \brief Stop publishing and remove the segment.
+     */
+    static void stop();
+    static bool isRunning();
+    /*! \brief Collect again the tasks and the connections, called after the graph changed.
+     *  Must not run concurrently with the changes of the graph.
+     */
+    static void refresh();
+
+    class TelemetryImpl;
+private:
+    Telemetry();
+    static Telemetry & instance();
+
+    std::unique_ptr<TelemetryImpl> impl_ptr_;
+};
+
+/*! \brief Reads the segment published by \ref Telemetry, from any process.
+ */
+class COCOEXPORT TelemetryReader
+{
+public:
+    TelemetryReader() {}
+    ~TelemetryReader();
+    TelemetryReader(const TelemetryReader &) = delete;
+    TelemetryReader & operator=(const TelemetryReader &) = delete;
+
+    /*! \brief Map the segment /name read only.
+     *  \return False if it doesn't exist or it has a different version.
+     */
+    bool open(const std::string &name);
+    void close();
+    /*! \brief Copy the content of the segment, retrying while it is being updated.
+     *  \return False if no consistent copy was obtained after many attempts.
+     */
+    bool read(TelemetrySnapshot &snapshot) const;
+
+private:
+    const TelemetryHeader *header_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+}  // end of namespace coco
@@ -0,0 +1,154 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Monotonic allocator for memory that lives for one step of a task.
+ *  Allocations bump a pointer inside a chunk, deallocation does nothing and
+ *  reset() makes all the memory available again. When an iteration needed
+ *  more than one chunk, reset() replaces them with a single chunk as big as
+ *  all of them, so that in steady state no heap allocation is performed.
+ */
+class COCOEXPORT Arena
+{
+public:
+    explicit Arena(std::size_t chunk_size = 64 << 10);
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena & operator=(const Arena &) = delete;
+
+    void * allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+    {
+        std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(head_) + alignment - 1) &
+                                 ~static_cast<std::uintptr_t>(alignment - 1);
+        char *ptr = reinterpret_cast<char *>(aligned);
+        if (head_ && ptr + bytes <= end_)
+        {
+            head_ = ptr + bytes;
+            return ptr;
+        }
+        return allocateChunk(bytes, alignment);
+    }
+    /*! \brief Release all the memory allocated since the last reset.
+     */
+    void reset();
+    /*! \brief Take the chunks from locked and prefaulted huge pages, see rt_memory::map().
+     *  Frees the current chunks, must be called before allocating.
+     */
+    void setLockedMemory(bool locked);
+    /*! \brief Make sure that at least bytes can be allocated without a new chunk.
+     *  Must be called before allocating, e.g. to prefault the memory before the first step.
+     */
+    void reserve(std::size_t bytes);
+    /*!
+     * \return Bytes allocated since the last reset, including padding.
+     */
+    std::size_t used() const { return used_ + (head_ - begin_); }
+    /*!
+     * \return Maximum value of used() before a reset.
+     */
+    std::size_t highWater() const { return high_water_; }
+    /*!
+     * \return The arena of the activity running on the calling thread, nullptr if none.
+     */
+    static Arena * current();
+    /*! \brief Set the arena of the calling thread, called by the activities.
+     */
+    static void setCurrent(Arena *arena);
+
+private:
+    void * allocateChunk(std::size_t bytes, std::size_t alignment);
+    char * newChunk(std::size_t &size);
+    void freeChunks();
+
+    std::vector<char *> chunks_;
+    std::vector<std::size_t> chunk_sizes_;
+    std::size_t chunk_size_;
+    std::size_t used_ = 0;        //!< Bytes used in the chunks before the current one
+    std::size_t high_water_ = 0;
+    bool locked_ = false;
+    char *begin_ = nullptr;
+    char *head_ = nullptr;
+    char *end_ = nullptr;
+};
+
+/*! \brief Standard allocator taking its memory from an \ref Arena.
+ *  deallocate() does nothing, the memory is released by Arena::reset().
+ *  Containers using it must not outlive the reset of their arena.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    explicit ArenaAllocator(Arena *arena)
+        : arena_(arena)
+    {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other)
+        : arena_(other.arena())
+    {}
+
+    T * allocate(std::size_t n)
+    {
+        return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) {}
+
+    Arena * arena() const { return arena_; }
+
+private:
+    Arena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a1, const ArenaAllocator<U> &a2)
+{
+    return a1.arena() == a2.arena();
+}
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a1, const ArenaAllocator<U> &a2)
+{
+    return a1.arena() != a2.arena();
+}
+
+template <class T>
+using ScratchVector = std::vector<T, ArenaAllocator<T> >;
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,268 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "coco/util/threading.h"
+#include "coco/util/logging.h"
+
+/* Log a message in the binary log: COCO_LOG_BIN(level, "value {} of {}", value, name).
+ * Each {} is replaced by the next argument when the log is decoded, the format and
+ * the types of the arguments are stored only once per file. When no binary log is
+ * open the message is printed as text. The arguments are not evaluated by decltype.
+ */
+#define COCO_LOG_BIN(level, ...) \
+    do { \
+        if ((level) <= COCO_LOG_MAX_LEVEL && \
+            coco::util::LoggerManager::enabled(coco::util::Type::LOG, level)) \
+        { \
+            static coco::util::BinaryCallSite coco_call_site( \
+                __FILE__, __LINE__, level, decltype(coco::util::BinaryLog::argList(__VA_ARGS__))()); \
+            coco::util::BinaryLog::write(coco_call_site, __VA_ARGS__); \
+        } \
+    } while (0)
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Type of an argument stored in the binary log.
+ */
+enum class BinaryArg : uint8_t
+{
+    INT = 0,    //!< Signed integer, zigzag varint
+    UINT,       //!< Unsigned integer, varint
+    DOUBLE,     //!< Floating point, stored as double
+    BOOL,       //!< One byte
+    CHAR,       //!< One byte
+    STRING      //!< Varint length followed by the characters, any type with an operator<<
+};
+
+/*! \brief Type of the argument T as stored in the binary log, T is already decayed.
+ */
+template <class T>
+constexpr BinaryArg binaryArgOf()
+{
+    return std::is_same<T, bool>::value ? BinaryArg::BOOL :
+           std::is_same<T, char>::value ? BinaryArg::CHAR :
+           std::is_integral<T>::value && std::is_signed<T>::value ? BinaryArg::INT :
+           std::is_integral<T>::value ? BinaryArg::UINT :
+           std::is_floating_point<T>::value ? BinaryArg::DOUBLE :
+           BinaryArg::STRING;
+}
+
+/*! \brief Argument types of a COCO_LOG_BIN statement, known at compile time.
+ */
+template <class... Args>
+struct BinaryArgList
+{
+    /* One more element, arrays of size 0 are not allowed */
+    static constexpr BinaryArg types[sizeof...(Args) + 1] = {binaryArgOf<Args>()..., BinaryArg::STRING};
+};
+template <class... Args>
+constexpr BinaryArg BinaryArgList<Args...>::types[sizeof...(Args) + 1];
+
+/*! \brief Static description of one COCO_LOG_BIN statement.
+ *  Constant initialized, id and format are set by \ref BinaryLog the first time
+ *  the statement is executed.
+ */
+struct BinaryCallSite
+{
+    template <class... Args>
+    constexpr BinaryCallSite(const char *file, int line, int level, BinaryArgList<Args...>)
+        : file(file), line(line), level(level),
+          arg_types(BinaryArgList<Args...>::types), arg_count(sizeof...(Args)) {}
+
+    const char *file;
+    int line;
+    int level;
+    const BinaryArg *arg_types;
+    uint8_t arg_count;
+    const char *format = nullptr;
+    std::atomic<uint32_t> id = {0};  //!< 0 until the first message
+    uint32_t generation = 0;         //!< Binary log file in which the definition was last written
+};
+
+/*! \brief Writes log messages in a compact binary format.
+ *  The file starts with \ref MAGIC and \ref VERSION followed by records,
+ *  each one starting with a varint:
+ *  - 0: definition of a call site, uint32 id, int32 level, uint32 line,
+ *       file and format as uint32 length and characters, uint8 number of
+ *       arguments and the \ref BinaryArg of each one.
+ *  - id: message of that call site, zigzag varint time in us from the previous
+ *        message, the value of each argument in the order of the definition.
+ *  Varints use 7 bits per byte, the high bit set means more bytes follow.
+ *  Fixed size values are in the byte order of the machine writing the log.
+ *  Use the coco_log_decoder tool to print the log as text.
+ *
+ *  When the text log is asynchronous (LoggerManager::enableAsync()) the messages
+ *  are stored in the log ring of the calling thread and written to the file by the
+ *  logger thread, otherwise the calling thread writes them under a mutex.
+ */
+class COCOEXPORT BinaryLog
+{
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 2;
+
+    static BinaryLog & instance();
+    ~BinaryLog();
+    /*! \brief Open the binary log file, messages are written there from now on.
+     */
+    bool open(const std::string &file_name);
+    /*! \brief Write the queued messages, flush and close the file,
+     *  messages go back to the text log.
+     */
+    void close();
+
+    bool isOpen() const { return open_.load(std::memory_order_acquire); }
+    /*! \brief Only used in decltype by COCO_LOG_BIN to get the types of the arguments.
+     */
+    template <class... Args>
+    static BinaryArgList<typename std::decay<Args>::type...> argList(const char *format, const Args &... args);
+
+    template <class... Args>
+    static void write(BinaryCallSite &site, const char *format, const Args &... args)
+    {
+        uint32_t id = site.id.load(std::memory_order_acquire);
+        if (id == 0)
+            id = instance().registerSite(site, format);
+        std::vector<char> &buffer = threadBuffer();
+        buffer.clear();
+        encodeArgs(buffer, args...);
+        instance().writeMessage(site, id, buffer);
+    }
+    /*! \brief Called by the logger thread for the messages queued in the log rings.
+     *  \param time Microseconds since epoch.
+     */
+    void writeQueued(uint32_t id, int64_t time, const std::string &args);
+    /*! \brief Convert a binary log to text, one line for each message.
+     *  \return False if the input is not a binary log or is truncated.
+     */
+    static bool decode(std::istream &in, std::ostream &out);
+    /*! \brief Replace the {} of the format with the encoded arguments.
+     *  \param types Type of each argument.
+     *  \return False if the arguments are malformed.
+     */
+    static bool format(const char *format, const BinaryArg *types, unsigned count,
+                       const char *args, std::size_t size, std::ostream &out);
+
+private:
+    BinaryLog() {}
+
+    static std::vector<char> & threadBuffer();
+    uint32_t registerSite(BinaryCallSite &site, const char *format);
+    void writeMessage(const BinaryCallSite &site, uint32_t id, const std::vector<char> &args);
+    /*! \brief Write the definition if needed and the message, mutex_ is held.
+     */
+    void writeLocked(BinaryCallSite &site, int64_t time, const char *args, std::size_t size);
+
+    template <class T>
+    static void put(std::vector<char> &buffer, const T &value)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    static void putVarint(std::vector<char> &buffer, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+    static uint64_t zigzag(int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+    static void putString(std::vector<char> &buffer, const char *str, std::size_t size)
+    {
+        putVarint(buffer, size);
+        buffer.insert(buffer.end(), str, str + size);
+    }
+
+    /* Each encode() must match binaryArgOf() of the decayed type */
+    static void encodeArgs(std::vector<char> &) {}
+    template <class T, class... Args>
+    static void encodeArgs(std::vector<char> &buffer, const T &value, const Args &... args)
+    {
+        encode(buffer, value);
+        encodeArgs(buffer, args...);
+    }
+
+    static void encode(std::vector<char> &buffer, bool value)
+    {
+        buffer.push_back(value ? 1 : 0);
+    }
+    static void encode(std::vector<char> &buffer, char value)
+    {
+        buffer.push_back(value);
+    }
+    static void encode(std::vector<char> &buffer, const char *value)
+    {
+        putString(buffer, value, value ? std::strlen(value) : 0);
+    }
+    static void encode(std::vector<char> &buffer, const std::string &value)
+    {
+        putString(buffer, value.data(), value.size());
+    }
+    template <class T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    encode(std::vector<char> &buffer, T value)
+    {
+        putVarint(buffer, zigzag(static_cast<int64_t>(value)));
+    }
+    template <class T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+    encode(std::vector<char> &buffer, T value)
+    {
+        putVarint(buffer, static_cast<uint64_t>(value));
+    }
+    template <class T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    encode(std::vector<char> &buffer, T value)
+    {
+        put(buffer, static_cast<double>(value));
+    }
+    /*! \brief Any other type with an operator<< is stored as text.
+     */
+    template <class T>
+    static typename std::enable_if<!std::is_arithmetic<T>::value>::type
+    encode(std::vector<char> &buffer, const T &value)
+    {
+        std::ostringstream text;
+        text << value;
+        std::string str = text.str();
+        putString(buffer, str.data(), str.size());
+    }
+
+    mutable std::mutex mutex_;
+    std::atomic<bool> open_ = {false};
+    std::ofstream file_;
+    std::vector<char> file_buffer_;
+    std::vector<char> record_;
+    std::vector<BinaryCallSite *> sites_;  //!< Indexed by id - 1
+    int64_t last_time_ = 0;  //!< Time of the previous message in the file
+    uint32_t generation_ = 0;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -10,6 +10,7 @@
 
 #pragma once
 #include <memory>
+#include <functional>
 #include <vector>
 #include <list>
 #include <type_traits>
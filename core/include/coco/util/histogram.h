@@ -0,0 +1,230 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Percentiles extracted from a \ref Histogram. Times are in seconds.
+ */
+struct HistogramStatistics
+{
+    unsigned long count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+
+    std::string toString() const
+    {
+        std::stringstream ss;
+        ss << "p50: " << p50 << " p99: " << p99
+           << " p99.9: " << p999 << " max: " << max
+           << " (" << count << " samples)";
+        return ss.str();
+    }
+};
+
+/*! \brief Log-linear (HDR style) histogram of durations expressed in microseconds.
+ *  Values below 2^SUB_BITS are stored exactly, above that every power of two
+ *  is split in 2^SUB_BITS buckets, giving a relative error lower than 1/2^SUB_BITS.
+ *  record() must be called by one thread at a time, it only performs relaxed
+ *  loads and stores so it costs a handful of instructions. Any thread can read
+ *  the percentiles concurrently, the result is consistent per bucket.
+ */
+class Histogram
+{
+public:
+    static const unsigned SUB_BITS = 5;
+    static const uint64_t SUB_COUNT = 1ull << SUB_BITS;
+    static const unsigned MAX_BITS = 32;  //!< Values above 2^32 us (~71 min) go in the last bucket
+    static const std::size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    Histogram()
+    {
+        clear();
+    }
+
+    Histogram(const Histogram &) = delete;
+    Histogram & operator=(const Histogram &) = delete;
+
+    /*! \brief Add a sample. Single writer.
+     *  \param value The duration in microseconds.
+     */
+    void record(uint64_t value)
+    {
+        if (reset_requested_.load(std::memory_order_relaxed))
+        {
+            reset_requested_.store(false, std::memory_order_relaxed);
+            clear();
+        }
+        auto &bucket = counts_[index(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed))
+            max_.store(value, std::memory_order_relaxed);
+    }
+    /*! \brief Add a sample expressed in seconds.
+     */
+    void recordSeconds(double seconds)
+    {
+        record(seconds > 0 ? static_cast<uint64_t>(seconds * 1000000.0 + 0.5) : 0);
+    }
+    /*! \brief Request to clear the histogram.
+     *  Can be called from any thread, the writer applies it at the next record().
+     */
+    void reset()
+    {
+        reset_requested_.store(true, std::memory_order_relaxed);
+    }
+    /*!
+     * \return The number of recorded samples.
+     */
+    uint64_t count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+    /*!
+     * \param quantile Value in [0, 1].
+     * \return The highest value, in microseconds, equivalent to the given quantile.
+     */
+    uint64_t valueAtQuantile(double quantile) const
+    {
+        uint64_t counts[BUCKETS];
+        uint64_t total = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        return valueAtQuantile(counts, total, quantile);
+    }
+    /*!
+     * \return The p50, p99, p99.9 and max of the recorded samples, in seconds.
+     */
+    HistogramStatistics statistics() const
+    {
+        uint64_t counts[BUCKETS];
+        uint64_t total = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        HistogramStatistics s;
+        s.count = total;
+        if (total == 0)
+            return s;
+        s.p50 = valueAtQuantile(counts, total, 0.5) / 1000000.0;
+        s.p99 = valueAtQuantile(counts, total, 0.99) / 1000000.0;
+        s.p999 = valueAtQuantile(counts, total, 0.999) / 1000000.0;
+        s.max = max_.load(std::memory_order_relaxed) / 1000000.0;
+        return s;
+    }
+
+    /*! \brief Count the samples below each of the given bounds, as the buckets of a
+     *  Prometheus histogram. A bucket is counted under a bound only if all its values
+     *  are lower or equal, so the counts are exact when the bounds are below 2^SUB_BITS
+     *  and differ at most by the relative error of the histogram above.
+     *  \param bounds Increasing upper bounds in microseconds.
+     *  \param counts Filled with the cumulative count for each bound.
+     *  \return The total number of samples, consistent with counts.
+     */
+    uint64_t cumulativeCounts(const uint64_t *bounds, std::size_t n, uint64_t *counts) const
+    {
+        uint64_t total = 0;
+        std::size_t b = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            while (b < n && highestValue(i) > bounds[b])
+                counts[b++] = total;
+            total += counts_[i].load(std::memory_order_relaxed);
+        }
+        while (b < n)
+            counts[b++] = total;
+        return total;
+    }
+
+    /*! \return The bucket containing value.
+     */
+    static std::size_t index(uint64_t value)
+    {
+        if (value >= (1ull << MAX_BITS))
+            return BUCKETS - 1;
+        unsigned shift = 0;
+        if (value >= SUB_COUNT)
+            shift = msb(value) - SUB_BITS;
+        return static_cast<std::size_t>(shift * SUB_COUNT + (value >> shift));
+    }
+    /*! \return The highest value that falls in the bucket idx.
+     */
+    static uint64_t highestValue(std::size_t idx)
+    {
+        if (idx < 2 * SUB_COUNT)
+            return idx;
+        uint64_t shift = idx / SUB_COUNT - 1;
+        uint64_t top = idx - shift * SUB_COUNT;
+        return ((top + 1) << shift) - 1;
+    }
+
+private:
+    static unsigned msb(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        unsigned r = 0;
+        while (value >>= 1)
+            ++r;
+        return r;
+#endif
+    }
+
+    uint64_t valueAtQuantile(const uint64_t *counts, uint64_t total, double quantile) const
+    {
+        if (total == 0)
+            return 0;
+        uint64_t target = static_cast<uint64_t>(quantile * total + 0.5);
+        target = std::max<uint64_t>(1, std::min(target, total));
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i)
+        {
+            cumulative += counts[i];
+            if (cumulative >= target)
+                return std::min(highestValue(i), max_.load(std::memory_order_relaxed));
+        }
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        for (auto &c : counts_)
+            c.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+    std::atomic<bool> reset_requested_ = {false};
+};
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,103 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace coco
+{
+namespace util
+{
+
+template <class Sig, std::size_t Size>
+class InplaceFunction;
+
+/*! \brief Callable wrapper storing the callable inside the object, like std::function
+ *  with a fixed small buffer. Callables bigger than Size are allocated on the heap.
+ *  It cannot be copied: it is filled in place with assign() and emptied with reset().
+ */
+template <class R, class ...Args, std::size_t Size>
+class InplaceFunction<R(Args...), Size>
+{
+    static_assert(Size >= sizeof(void *), "The buffer must be able to hold a pointer");
+
+public:
+    InplaceFunction() {}
+    ~InplaceFunction()
+    {
+        reset();
+    }
+    InplaceFunction(const InplaceFunction &) = delete;
+    InplaceFunction & operator=(const InplaceFunction &) = delete;
+
+    template <class F>
+    void assign(F &&fx)
+    {
+        typedef typename std::decay<F>::type Fx;
+        reset();
+        store<Fx>(std::forward<F>(fx), std::integral_constant<bool, fitsInline<Fx>()>());
+    }
+    void reset()
+    {
+        if (destroy_)
+            destroy_(&storage_);
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+    explicit operator bool() const { return invoke_ != nullptr; }
+    /*!
+     * \return If a callable of type F is stored in the buffer, otherwise it is allocated.
+     */
+    template <class F>
+    static constexpr bool storedInline() { return fitsInline<typename std::decay<F>::type>(); }
+
+    R operator()(Args... args)
+    {
+        return invoke_(&storage_, std::forward<Args>(args)...);
+    }
+
+private:
+    template <class Fx>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fx) <= Size && alignof(Fx) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fx>::value;
+    }
+
+    template <class Fx, class F>
+    void store(F &&fx, std::true_type)
+    {
+        new (&storage_) Fx(std::forward<F>(fx));
+        invoke_ = [](void *storage, Args&&... args) -> R
+            { return (*static_cast<Fx *>(storage))(std::forward<Args>(args)...); };
+        destroy_ = [](void *storage) { static_cast<Fx *>(storage)->~Fx(); };
+    }
+    template <class Fx, class F>
+    void store(F &&fx, std::false_type)
+    {
+        new (&storage_) Fx*(new Fx(std::forward<F>(fx)));
+        invoke_ = [](void *storage, Args&&... args) -> R
+            { return (**static_cast<Fx **>(storage))(std::forward<Args>(args)...); };
+        destroy_ = [](void *storage) { delete *static_cast<Fx **>(storage); };
+    }
+
+    typedef R (*Invoke)(void *, Args&&...);
+    typedef void (*Destroy)(void *);
+
+    typename std::aligned_storage<Size, alignof(std::max_align_t)>::type storage_;
+    Invoke invoke_ = nullptr;
+    Destroy destroy_ = nullptr;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
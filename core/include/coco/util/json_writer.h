@@ -0,0 +1,124 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Writes compact JSON appending directly to a string.
+ *  Unlike Json::Value no document is built: keys and values are written in order,
+ *  the writer only tracks whether a comma is needed. Nesting is not checked, begin
+ *  and end calls must be balanced by the caller. Non finite doubles are written as null.
+ */
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string &out)
+        : out_(out)
+    {}
+
+    JsonWriter & beginObject() { separate(); out_ += '{'; comma_ = false; return *this; }
+    JsonWriter & endObject() { out_ += '}'; comma_ = true; return *this; }
+    JsonWriter & beginArray() { separate(); out_ += '['; comma_ = false; return *this; }
+    JsonWriter & endArray() { out_ += ']'; comma_ = true; return *this; }
+
+    JsonWriter & key(const std::string &name)
+    {
+        separate();
+        escape(name);
+        out_ += ':';
+        comma_ = false;
+        return *this;
+    }
+
+    JsonWriter & value(const std::string &v) { separate(); escape(v); comma_ = true; return *this; }
+    JsonWriter & value(const char *v) { return value(std::string(v)); }
+    JsonWriter & value(bool v) { separate(); out_ += v ? "true" : "false"; comma_ = true; return *this; }
+    JsonWriter & value(double v)
+    {
+        if (!std::isfinite(v))
+            return null();
+        /* Enough digits to read back the same double, small values keep their precision */
+        char str[64];
+        int n = snprintf(str, sizeof(str), "%.17g", v);
+        if (n < 0)
+            return null();
+        separate();
+        out_.append(str, std::min<std::size_t>(n, sizeof(str) - 1));
+        comma_ = true;
+        return *this;
+    }
+    template <class T>
+    typename std::enable_if<std::is_integral<T>::value, JsonWriter &>::type value(T v)
+    {
+        char str[32];
+        int n = std::is_signed<T>::value ?
+                snprintf(str, sizeof(str), "%lld", static_cast<long long>(v)) :
+                snprintf(str, sizeof(str), "%llu", static_cast<unsigned long long>(v));
+        separate();
+        out_.append(str, n);
+        comma_ = true;
+        return *this;
+    }
+    JsonWriter & null() { separate(); out_ += "null"; comma_ = true; return *this; }
+    /*! \brief Append a value already serialized as JSON.
+     */
+    JsonWriter & raw(const std::string &json) { separate(); out_ += json; comma_ = true; return *this; }
+
+    template <class T>
+    JsonWriter & field(const std::string &name, const T &v) { key(name); return value(v); }
+
+private:
+    void separate()
+    {
+        if (comma_)
+            out_ += ',';
+    }
+    void escape(const std::string &v)
+    {
+        static const char HEX[] = "0123456789abcdef";
+        out_ += '"';
+        for (char c : v)
+        {
+            switch (c)
+            {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out_ += "\\u00";
+                    out_ += HEX[(c >> 4) & 0xf];
+                    out_ += HEX[c & 0xf];
+                }
+                else
+                    out_ += c;
+            }
+        }
+        out_ += '"';
+    }
+
+    std::string &out_;
+    bool comma_ = false;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
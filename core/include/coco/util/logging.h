@@ -15,11 +15,16 @@
 #include <sstream>
 #include <unordered_set>
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <unordered_map>
 #include <chrono>
 #include <ctime>
 #include <cassert>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <climits>
 
 #include "coco/util/threading.h"
 #include "coco/web_server/web_server.h"
@@ -32,25 +37,53 @@ inline std::string instantiationName()
 }
 
 
+/* COCO_LOG statements with a level greater than COCO_LOG_MAX_LEVEL are removed at compile time.
+ * COCO_DEBUG statements are removed when COCO_LOG_DEBUG_ENABLED is 0, by default in NDEBUG builds.
+ */
+#ifndef COCO_LOG_MAX_LEVEL
+#   define COCO_LOG_MAX_LEVEL INT_MAX
+#endif
+#ifndef COCO_LOG_DEBUG_ENABLED
+#   ifndef NDEBUG
+#       define COCO_LOG_DEBUG_ENABLED 1
+#   else
+#       define COCO_LOG_DEBUG_ENABLED 0
+#   endif
+#endif
+
 #ifndef COCO_LOGGING
 #   define COCO_LOGGING
 #   define COCO_LOG_INFO() COCO_LOG(0) << coco::util::LoggerManager::instance()->info();
 #   define COCO_INIT_LOG(x) coco::util::LoggerManager::instance()->init(x);
 
+/* The message, its name and the streamed arguments are evaluated only when the
+ * statement is enabled. The conditional expression keeps the macros usable as
+ * single statements inside if/else.
+ */
+#   define COCO_LOG_IF(condition) !(condition) ? (void)0 : coco::util::LogVoidify() &
+
 #   define GET_MACRO(_1,_2,NAME,...) NAME
 #   define COCO_LOG(...) GET_MACRO(__VA_ARGS__, COCO_LOG2, COCO_LOG1)(__VA_ARGS__)
-#   define COCO_LOG1(x) coco::util::LogMessage(coco::util::Type::LOG, x, instantiationName()).stream()
-#   define COCO_LOG2(x, y) coco::util::LogMessage(coco::util::Type::LOG, x, y).stream()
-
-#   define COCO_ERR() coco::util::LogMessage(coco::util::Type::ERR, -1, instantiationName()).stream()
+#   define COCO_LOG1(x) COCO_LOG_IF((x) <= COCO_LOG_MAX_LEVEL && \
+                                    coco::util::LoggerManager::enabled(coco::util::Type::LOG, x)) \
+        coco::util::LogMessage(coco::util::Type::LOG, x, instantiationName()).stream()
+#   define COCO_LOG2(x, y) COCO_LOG_IF((x) <= COCO_LOG_MAX_LEVEL && \
+                                       coco::util::LoggerManager::enabled(coco::util::Type::LOG, x)) \
+        coco::util::LogMessage(coco::util::Type::LOG, x, y).stream()
+
+#   define COCO_ERR() COCO_LOG_IF(coco::util::LoggerManager::enabled(coco::util::Type::ERR, -1)) \
+        coco::util::LogMessage(coco::util::Type::ERR, -1, instantiationName()).stream()
 //#   define COCO_FATAL() coco::util::LogMessage(coco::util::Type::FATAL, -1, coco::util::task_name(this)).stream()
 #   define COCO_FATAL() coco::util::LogMessage(coco::util::Type::FATAL, -1, instantiationName()).stream()
-#   define COCO_LOG_SAMPLE(x, y) coco::util::LogMessageSampled(x, y).stream()
-#   ifndef NDEBUG
-#       define COCO_DEBUG(x) coco::util::LogMessage(coco::util::Type::DEBUG, 0, x).stream()
-#   else
-#       define COCO_DEBUG(x) coco::util::LogMessage(coco::util::Type::DEBUG, 0, x).stream()
-#   endif
+/* Print one every y executions of the statement. Each call site owns its counter,
+ * x only labels the statement. The lambda gives every expansion its own static.
+ */
+#   define COCO_LOG_SAMPLE(x, y) COCO_LOG_IF(coco::util::LogMessageSampled::sample( \
+        []() { static std::atomic<unsigned long> count = {0}; return &count; }(), y)) \
+        coco::util::LogMessageSampled(y).stream()
+#   define COCO_DEBUG(x) COCO_LOG_IF(COCO_LOG_DEBUG_ENABLED && \
+                                     coco::util::LoggerManager::enabled(coco::util::Type::DEBUG, 0)) \
+        coco::util::LogMessage(coco::util::Type::DEBUG, 0, x).stream()
 #endif
 
 
@@ -66,9 +99,8 @@ inline std::string getDataAndTime()
     return  std::ctime(&time);
 }
 
-inline std::string getTime()
+inline std::string getTime(time_t t = time(0))
 {
-    time_t t = time(0);   // get time now
     struct tm * now = localtime(&t);
     std::stringstream ss;
 
@@ -115,6 +147,88 @@ enum class Type
     NO_PRINT = 4,
 };
 
+/*! \brief Single producer single consumer ring of variable length log records.
+ *  Each thread logging in asynchronous mode owns one ring, drained by the
+ *  LoggerManager writer thread. The producer never blocks nor allocates:
+ *  when the ring is full the record is dropped.
+ */
+class LogRing
+{
+public:
+    enum Flags
+    {
+        TO_WEB = 1,  //!< Forward the message to the web server
+        RAW = 2,     //!< Do not add the prefix with type, level, name and time
+        BINARY = 4   //!< BinaryLog message: level is the call site id, text the encoded arguments
+    };
+
+    struct Header
+    {
+        int64_t time;  //!< Microseconds since epoch
+        int32_t level;
+        uint32_t name_size;
+        uint32_t text_size;
+        Type type;
+        uint8_t flags;
+    };
+
+    explicit LogRing(std::size_t capacity)
+        : buffer_(capacity)
+    {}
+    /*! \brief Called by the owner thread.
+     *  \return False if the record did not fit in the free space.
+     */
+    bool push(const Header &header, const char *name, const char *text)
+    {
+        const uint64_t size = sizeof(Header) + header.name_size + header.text_size;
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (size > buffer_.size() - (head - tail_.load(std::memory_order_acquire)))
+            return false;
+        copyIn(head, reinterpret_cast<const char *>(&header), sizeof(Header));
+        copyIn(head + sizeof(Header), name, header.name_size);
+        copyIn(head + sizeof(Header) + header.name_size, text, header.text_size);
+        head_.store(head + size, std::memory_order_release);
+        return true;
+    }
+    /*! \brief Called by the writer thread.
+     *  \return False if the ring is empty.
+     */
+    bool pop(Header &header, std::string &name, std::string &text)
+    {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+        copyOut(tail, reinterpret_cast<char *>(&header), sizeof(Header));
+        name.resize(header.name_size);
+        text.resize(header.text_size);
+        copyOut(tail + sizeof(Header), &name[0], header.name_size);
+        copyOut(tail + sizeof(Header) + header.name_size, &text[0], header.text_size);
+        tail_.store(tail + sizeof(Header) + header.name_size + header.text_size,
+                    std::memory_order_release);
+        return true;
+    }
+
+private:
+    void copyIn(uint64_t position, const char *data, std::size_t size)
+    {
+        std::size_t offset = position % buffer_.size();
+        std::size_t first = std::min(size, buffer_.size() - offset);
+        std::memcpy(&buffer_[offset], data, first);
+        std::memcpy(&buffer_[0], data + first, size - first);
+    }
+    void copyOut(uint64_t position, char *data, std::size_t size) const
+    {
+        std::size_t offset = position % buffer_.size();
+        std::size_t first = std::min(size, buffer_.size() - offset);
+        std::memcpy(data, &buffer_[offset], first);
+        std::memcpy(data + first, &buffer_[0], size - first);
+    }
+
+    std::vector<char> buffer_;
+    std::atomic<uint64_t> head_ = {0};  //!< Bytes ever written
+    std::atomic<uint64_t> tail_ = {0};  //!< Bytes ever read
+};
+
 class COCOEXPORT LoggerManager
 {
 public:
@@ -130,9 +244,9 @@ public:
 
     std::string info() const;
 
-    void setLevels(const std::unordered_set<int> &levels) { levels_ = levels; }
+    void setLevels(const std::unordered_set<int> &levels) { levels_ = levels; updateMasks(); }
 
-    void setTypes(const std::unordered_set<Type, enum_hash> &types) {types_ = types; }
+    void setTypes(const std::unordered_set<Type, enum_hash> &types) {types_ = types; updateMasks(); }
 
     void setOutLogFile(const std::string &file)
     {
@@ -147,13 +261,23 @@ public:
         use_stdout_ = use;
     }
 
-    void addLevel(int level) { levels_.insert(level); }
+    void addLevel(int level) { levels_.insert(level); updateMasks(); }
 
-    bool removeLevel(int level) { return levels_.erase(level) > 0; }
+    bool removeLevel(int level)
+    {
+        bool removed = levels_.erase(level) > 0;
+        updateMasks();
+        return removed;
+    }
 
-    void addType(Type type) { types_.insert(type); }
+    void addType(Type type) { types_.insert(type); updateMasks(); }
 
-    bool removeType(Type type) { return types_.erase(type) > 0; }
+    bool removeType(Type type)
+    {
+        bool removed = types_.erase(type) > 0;
+        updateMasks();
+        return removed;
+    }
 
     inline bool isInit() const { return initialized_; }
 
@@ -161,36 +285,82 @@ public:
 
     inline bool findLevel(int level) const
     {
+        if (level >= 0 && level < 64)
+            return (level_mask_.load(std::memory_order_relaxed) >> level) & 1;
         return levels_.find(level) != levels_.end();
     }
 
     inline bool findType(Type type) const
     {
-        return types_.find(type) != types_.end();
+        return (type_mask_.load(std::memory_order_relaxed) >> static_cast<unsigned>(type)) & 1;
+    }
+    /*! \brief Check if a message would be printed, without building it.
+     *  When the web server is running every message is forwarded to it.
+     */
+    inline bool isEnabled(Type type, int level) const
+    {
+        if (web_output_.load(std::memory_order_relaxed))
+            return true;
+        if (type == Type::LOG)
+            return findLevel(level);
+        return type != Type::NO_PRINT && findType(type);
+    }
+    /*! \brief Runtime filter used by the logging macros before creating a \ref LogMessage.
+     */
+    static inline bool enabled(Type type, int level)
+    {
+        return instance()->isEnabled(type, level);
     }
+    /*! \brief Called by the web server, when set all the messages are sent to it.
+     */
+    void setWebOutput(bool web) { web_output_.store(web, std::memory_order_relaxed); }
 
     void printToFile(const std::string &buffer);
 
     void printToStdout(Type type, std::ostream & ons, const std::string & s);
 
-    // TODO protect with guard
-    int sampledMessageCount(std::string id) const
+    /*! \brief Move the formatting and the output of the messages to a background thread.
+     *  Messages are stored in a ring for each logging thread, when a ring is full
+     *  new messages are dropped and counted.
+     *  \param ring_size Size in bytes of the ring of each thread.
+     */
+    void enableAsync(std::size_t ring_size = 1 << 16);
+    /*! \brief Write all the pending messages and go back to synchronous logging.
+     */
+    void disableAsync();
+
+    inline bool isAsync() const { return async_.load(std::memory_order_relaxed); }
+    /*!
+     * \return The number of messages dropped because the ring of their thread was full.
+     */
+    uint64_t droppedMessages() const { return dropped_.load(std::memory_order_relaxed); }
+    /*! \brief Store a message in the ring of the calling thread, never blocks.
+     *  \return False if asynchronous logging has been disabled meanwhile,
+     *  the caller has to write the message itself.
+     */
+    bool enqueue(Type type, int level, uint8_t flags,
+                 const char *name, std::size_t name_size, const char *text, std::size_t text_size);
+
+    bool enqueue(Type type, int level, uint8_t flags,
+                 const std::string &name, const std::string &text)
     {
-        auto count = sampled_messages_.find(id);
-        if (count != sampled_messages_.end())
-            return count->second;
-        else
-            return -1;
-    }
-
-    // TODO protect with guard
-    void setSampledMessageCount(std::string id, int count)
-    {
-        sampled_messages_[id] = count;
+        return enqueue(type, level, flags, name.data(), name.size(), text.data(), text.size());
     }
+    /*! \brief Write the messages queued so far, does nothing in synchronous mode.
+     */
+    void flushAsync();
 
 private:
     LoggerManager() {}
+    /*! \brief Mirror levels_ and types_ in bit masks, read without locks by the logging threads.
+     */
+    void updateMasks();
+
+    void asyncWriter();
+    /*! \brief Write the messages of all the rings ordered by time.
+     *  \return The number of messages written.
+     */
+    std::size_t drainAsync();
     
     std::stringstream shell_stream_;
     std::ofstream file_stream_;
@@ -200,7 +370,29 @@ private:
     bool initialized_ = false;
     bool use_stdout_ = true;
 
-    std::unordered_map<std::string, int> sampled_messages_;
+    std::atomic<uint64_t> level_mask_ = {0};  //!< Bit i set if level i (0-63) is enabled
+    std::atomic<uint32_t> type_mask_ = {0};   //!< Bit i set if Type i is enabled
+    std::atomic<bool> web_output_ = {false};
+
+    std::atomic<bool> async_ = {false};
+    std::atomic<bool> stop_writer_ = {false};
+    std::atomic<int> producers_ = {0};  //!< Threads inside enqueue()
+    std::mutex async_mutex_;            //!< Serializes enableAsync() and disableAsync()
+    std::thread writer_;
+    std::mutex rings_mutex_;
+    std::mutex drain_mutex_;  //!< Keeps the output ordered when flushAsync() runs with the writer
+    std::vector<std::unique_ptr<LogRing> > rings_;
+    std::size_t ring_size_ = 1 << 16;
+    std::atomic<uint64_t> dropped_ = {0};
+    uint64_t reported_dropped_ = 0;
+};
+
+/*! \brief Turns a log stream into void, so that both branches of COCO_LOG_IF have the same type.
+ *  operator& binds less tightly than operator<< and more than ?:.
+ */
+struct LogVoidify
+{
+    void operator&(std::ostream &) {}
 };
 
 class COCOEXPORT LogMessage
@@ -222,22 +414,28 @@ public:
         return stream_;
     }
 
+    /*! \brief Write the prefix of a message: type, level, name and time.
+     */
+    static void writePrefix(std::ostream &out, Type type, int level,
+                            const std::string &name, time_t time);
+
 private:
     void init()
     {
         stream_.rdbuf(buffer_.rdbuf());
-        addPrefix();
+        /* In asynchronous mode the prefix is written by the logger thread */
+        if (type_ == Type::FATAL || !LoggerManager::instance()->isAsync())
+            addPrefix();
     }
     void flush()
     {
         auto lm = LoggerManager::instance();
-        if (WebServer::isRunning())
-        {
-            buffer_ << std::endl;
-            stream_.flush();
-            WebServer::addLogString(buffer_.str());
-        }
-        else
+        /* Make sure the pending messages are written before exiting */
+        if (type_ == Type::FATAL)
+            lm->disableAsync();
+
+        bool web = WebServer::isRunning();
+        if (!web)
         {
             if (type_ == Type::NO_PRINT)
                 return;
@@ -251,13 +449,33 @@ private:
             {
                 return;
             }
-            stream_.flush();
+        }
+        stream_.flush();
+
+        if (lm->isAsync() && !prefixed_ &&
+            lm->enqueue(type_, level_, web ? LogRing::TO_WEB : 0, name_, buffer_.str()))
+        {
+            return;
+        }
 
+        std::string text = buffer_.str();
+        if (!prefixed_)
+        {
+            std::ostringstream prefix;
+            writePrefix(prefix, type_, level_, name_, time(0));
+            text = prefix.str() + text;
+        }
+        if (web)
+        {
+            WebServer::addLogString(text + "\n");
+        }
+        else
+        {
             if(lm->useStdout())
             {
-                lm->printToStdout(type_,(type_ == Type::LOG || type_ == Type::DEBUG) ? std::cout : std::cerr,buffer_.str());
+                lm->printToStdout(type_,(type_ == Type::LOG || type_ == Type::DEBUG) ? std::cout : std::cerr, text);
             }
-            lm->printToFile(buffer_.str());
+            lm->printToFile(text);
         }
 
 
@@ -272,6 +490,7 @@ private:
 private:
     int level_ = 0;
     Type type_;
+    bool prefixed_ = false;
     std::ostringstream buffer_;
     std::ostream stream_;
     std::string name_;
@@ -284,8 +503,8 @@ private:
 class COCOEXPORT LogMessageSampled
 {
 public:
-    LogMessageSampled(std::string id, int sample_rate)
-        : id_(id), sample_rate_(sample_rate), stream_(NULL)
+    explicit LogMessageSampled(int sample_rate)
+        : sample_rate_(sample_rate), stream_(NULL)
     {
         init();
     }
@@ -299,29 +518,34 @@ public:
     {
         return stream_;
     }
+    /*! \brief Count one execution of a sampled statement, thread safe.
+     *  \param counter The counter of the call site.
+     *  \return If this execution has to be printed: the first one and then one every sample_rate.
+     */
+    static inline bool sample(std::atomic<unsigned long> *counter, int sample_rate)
+    {
+        unsigned long count = counter->fetch_add(1, std::memory_order_relaxed);
+        return sample_rate <= 1 || count % static_cast<unsigned long>(sample_rate) == 0;
+    }
 
 private:
     void init()
     {
-        count_ = LoggerManager::instance()->sampledMessageCount(id_);
-        if (count_ == -1)
-            LoggerManager::instance()->setSampledMessageCount(id_, 0);
-        else
-            LoggerManager::instance()->setSampledMessageCount(id_, ++count_);
-
         stream_.rdbuf(buffer_.rdbuf());
 
         buffer_ << "[LOG SAMPLED " << sample_rate_ << "] ";
     }
     void flush()
     {
-        if (count_ < sample_rate_)
-            return;
-
-        LoggerManager::instance()->setSampledMessageCount(id_, 0);
-
         stream_.flush();
 
+        auto lm = LoggerManager::instance();
+        if (lm->isAsync())
+        {
+            uint8_t flags = LogRing::RAW | (WebServer::isRunning() ? LogRing::TO_WEB : 0);
+            if (lm->enqueue(Type::LOG, 0, flags, "", buffer_.str()))
+                return;
+        }
         if (WebServer::isRunning())
         {
             buffer_ << std::endl;
@@ -339,9 +563,7 @@ private:
     }
 
 private:
-    std::string id_;
     int sample_rate_;
-    int count_;
     std::ostringstream buffer_;
     std::ostream stream_;
 };
@@ -10,13 +10,14 @@
 
 #pragma once
 
-#include <map>
-#include <list>
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <boost/lockfree/stack.hpp>
 #include "coco/util/threading.h"
 #include "coco/util/logging.h"
+#include "coco/util/memory_account.h"
  
 
 namespace coco
@@ -24,73 +25,227 @@ namespace coco
 namespace util
 {
 
+/*! \brief Usage of a \ref VectorPool.
+ */
+struct VectorPoolStatistics
+{
+    std::size_t cached_bytes = 0;  //!< Bytes held by the shared depot and the thread magazines
+    std::size_t memory_cap = 0;    //!< Maximum value of cached_bytes
+};
+
 /**
  * This class provides a pool of memory of objects of vector<T>
-
+ *
+ * Vectors of at least MIN_SIZE elements are grouped in power of two size classes,
+ * the capacity of a pooled vector is always the size of its class.
+ * Released vectors go first in a small magazine of the releasing thread and then
+ * in a lock free depot shared by all the threads. Only the classes up to
+ * MAGAZINE_MAX_CLASS use the magazines. The depot and the magazines together keep
+ * at most memoryCap() bytes, the vectors exceeding it are freed.
+ * The capacity of every vector is charged to the MemoryAccount::current() of the
+ * thread calling get() until the vector is released.
  */
 template <class T>
 class VectorPool
 {
 public:
+    static const unsigned MIN_CLASS = 14;       //!< Smaller vectors are not pooled
+    static const unsigned MAX_CLASS = 30;       //!< Bigger vectors are not pooled
+    static const unsigned long MIN_SIZE = 1ul << MIN_CLASS;
+    static const unsigned MAGAZINE_SIZE = 2;    //!< Vectors cached by each thread for each class
+    static const unsigned MAGAZINE_MAX_CLASS = 20;  //!< Bigger vectors go directly to the depot
+    static const unsigned DEPOT_SIZE = 64;      //!< Vectors cached by the depot for each class
+    static const std::size_t DEFAULT_MEMORY_CAP = 256ul << 20;
+
+    /*! \brief Get a vector of k elements.
+     *  \param power2 If true the size is rounded up to the size class, a power of two.
+     */
     static std::shared_ptr<std::vector<T> > get(unsigned long k, bool power2 = false);
-    static VectorPool<T> singleton;
+    /*! \brief Set the maximum number of bytes kept by the pool, trimming it if needed.
+     *  The magazine of the calling thread is emptied, the ones of the other threads
+     *  only stop growing.
+     */
+    static void setMemoryCap(std::size_t bytes);
+    /*! \brief Free all the vectors in the depot and in the magazine of the calling thread.
+     */
+    static void trim();
+
+    static VectorPoolStatistics statistics();
+
+    /*! \brief Kept for source compatibility, it refers to the same pool used by get().
+     *  \deprecated All the operations are static, call them on the class. The reference
+     *  is bound during static initialization, do not use it from other static initializers.
+     */
+    static VectorPool<T> &singleton;
 
 private:
+    static const unsigned CLASSES = MAX_CLASS - MIN_CLASS + 1;
+
+    /*! \brief Vectors cached by a thread, given back to the depot when the thread exits.
+     */
+    struct ThreadCache
+    {
+        std::vector<T> *slots[CLASSES][MAGAZINE_SIZE];
+        unsigned count[CLASSES] = {};
+
+        ~ThreadCache()
+        {
+            flush();
+        }
+
+        void flush()
+        {
+            for (unsigned c = 0; c < CLASSES; ++c)
+            {
+                for (unsigned i = 0; i < count[c]; ++i)
+                {
+                    instance().cached_bytes_.fetch_sub(bytes(slots[c][i]), std::memory_order_relaxed);
+                    instance().releaseToDepot(c, slots[c][i]);
+                }
+                count[c] = 0;
+            }
+        }
+    };
+
     VectorPool()
     {}
 
     ~VectorPool()
     {
-        std::lock_guard<std::mutex> mlock(this->mutex_);
-        for (auto & p : free_pool_)
-            for (auto & l : p.second)
-                delete l;
+        trimImpl(0);
     }
 
     /// returns the singleton
     static VectorPool<T> &instance();
 
-    /// implementation of acquisistion: GLOBAL lock
+    static ThreadCache &threadCache()
+    {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    /*! \return The size class of k elements, the smallest c with 2^c >= k.
+     */
+    static unsigned sizeClass(unsigned long k)
+    {
+        unsigned c = MIN_CLASS;
+        while (c <= MAX_CLASS && (1ul << c) < k)
+            ++c;
+        return c;
+    }
+
+    /// implementation of acquisition: thread magazine, then shared depot, then new
     std::shared_ptr<std::vector<T> > getImpl(unsigned long k, bool power2)
     {
-        if(k < 16384)
+        /* The vector can outlive the task that allocated it, e.g. in a connection buffer */
+        MemoryAccount *current = MemoryAccount::current();
+        std::shared_ptr<MemoryAccount> account = current ? current->shared_from_this() : nullptr;
+        unsigned c = sizeClass(k);
+        if (k < MIN_SIZE || c > MAX_CLASS)
         {
-            return std::make_shared<std::vector<T> >(k);
+            if (!account)
+                return std::make_shared<std::vector<T> >(k);
+            std::vector<T> *vec = new std::vector<T>(k);
+            std::size_t size = bytes(vec);
+            account->allocate(size);
+            return std::shared_ptr<std::vector<T> >(vec, [account, size] (std::vector<T> *v)
+                {
+                    account->deallocate(size);
+                    delete v;
+                });
         }
-        std::lock_guard<std::mutex> mlock(this->mutex_);
+        unsigned index = c - MIN_CLASS;
 
-        std::vector<T> * v_ptr = nullptr;
-
-        auto pi = free_pool_.lower_bound(k);
-        if (pi != free_pool_.end())
+        std::vector<T> *v_ptr = nullptr;
+        ThreadCache &cache = threadCache();
+        if (cache.count[index] > 0)
+        {
+            v_ptr = cache.slots[index][--cache.count[index]];
+            cached_bytes_.fetch_sub(bytes(v_ptr), std::memory_order_relaxed);
+        }
+        else if (depot_[index].pop(v_ptr))
+        {
+            cached_bytes_.fetch_sub(bytes(v_ptr), std::memory_order_relaxed);
+        }
+        else
         {
-            v_ptr = pi->second.front();
-            v_ptr->resize(k);
+            v_ptr = new std::vector<T>();
+            v_ptr->reserve(1ul << c);
+        }
+        v_ptr->resize(power2 ? 1ul << c : k);
 
-            pi->second.pop_front();
-            if (pi->second.size() == 0)
+        std::size_t size = bytes(v_ptr);
+        if (account)
+            account->allocate(size);
+        /// create a destructor that releases the pointer
+        return std::shared_ptr<std::vector<T> >(v_ptr, [account, size] (std::vector<T> *vec)
             {
-                // remove from list
-                free_pool_.erase(pi);
+                if (account)
+                    account->deallocate(size);
+                instance().release(vec);
+            });
+    }
+
+    void release(std::vector<T> *vec)
+    {
+        /* Vectors that were grown outside of their class are not pooled */
+        unsigned c = sizeClass(vec->capacity());
+        if (c > MAX_CLASS || (1ul << c) != vec->capacity())
+        {
+            delete vec;
+            return;
+        }
+        unsigned index = c - MIN_CLASS;
+        ThreadCache &cache = threadCache();
+        if (c <= MAGAZINE_MAX_CLASS && cache.count[index] < MAGAZINE_SIZE)
+        {
+            /* The magazines are charged to the cap as the depot */
+            std::size_t size = bytes(vec);
+            std::size_t cached = cached_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+            if (cached <= memory_cap_.load(std::memory_order_relaxed))
+            {
+                cache.slots[index][cache.count[index]++] = vec;
+                return;
             }
+            cached_bytes_.fetch_sub(size, std::memory_order_relaxed);
         }
-        if (!v_ptr)
+        releaseToDepot(index, vec);
+    }
+
+    void releaseToDepot(unsigned index, std::vector<T> *vec)
+    {
+        std::size_t size = bytes(vec);
+        std::size_t cached = cached_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+        if (cached > memory_cap_.load(std::memory_order_relaxed) || !depot_[index].bounded_push(vec))
         {
-            v_ptr = new std::vector<T>(k);
+            cached_bytes_.fetch_sub(size, std::memory_order_relaxed);
+            delete vec;
         }
+    }
 
-        /// create a descrutor that releases the pointer
-        return std::shared_ptr<std::vector<T> >(v_ptr, [this] (std::vector<T>* vec)
+    /// free the vectors of the depot, starting from the biggest, until at most cap bytes are cached
+    void trimImpl(std::size_t cap)
+    {
+        for (unsigned index = CLASSES; index-- > 0;)
+        {
+            std::vector<T> *vec;
+            while (cached_bytes_.load(std::memory_order_relaxed) > cap && depot_[index].pop(vec))
             {
-                std::lock_guard<std::mutex> mlock(this->mutex_);
-                this->free_pool_[vec->capacity()].push_back(vec);
-            });
+                cached_bytes_.fetch_sub(bytes(vec), std::memory_order_relaxed);
+                delete vec;
+            }
+        }
     }
 
-    /// free pool for given size
-    std::map<unsigned long, std::list<std::vector<T> *> > free_pool_;
+    static std::size_t bytes(const std::vector<T> *vec)
+    {
+        return vec->capacity() * sizeof(T);
+    }
 
-    std::mutex mutex_;
+    /// shared free vectors, one stack for each size class
+    boost::lockfree::stack<std::vector<T> *, boost::lockfree::capacity<DEPOT_SIZE> > depot_[CLASSES];
+    std::atomic<std::size_t> cached_bytes_ = {0};
+    std::atomic<std::size_t> memory_cap_ = {DEFAULT_MEMORY_CAP};
 };
 
 template<class T>
@@ -99,57 +254,189 @@ std::shared_ptr<std::vector<T> > VectorPool<T>::get(unsigned long k, bool power2
     return instance().getImpl(k,power2);
 }
 
-template <class T>
-VectorPool<T> VectorPool<T>::singleton;
+template<class T>
+void VectorPool<T>::setMemoryCap(std::size_t bytes)
+{
+    instance().memory_cap_.store(bytes, std::memory_order_relaxed);
+    threadCache().flush();
+    instance().trimImpl(bytes);
+}
+
+template<class T>
+void VectorPool<T>::trim()
+{
+    threadCache().flush();
+    instance().trimImpl(0);
+}
+
+template<class T>
+VectorPoolStatistics VectorPool<T>::statistics()
+{
+    VectorPoolStatistics stats;
+    stats.cached_bytes = instance().cached_bytes_.load(std::memory_order_relaxed);
+    stats.memory_cap = instance().memory_cap_.load(std::memory_order_relaxed);
+    return stats;
+}
 
 template<class T>
 VectorPool<T> & VectorPool<T>::instance()
 {
+    static VectorPool<T> singleton;
     return singleton;
 }
 
+template<class T>
+VectorPool<T> & VectorPool<T>::singleton = VectorPool<T>::instance();
+
+/*! \brief Usage of a \ref MemoryPool.
+ */
+struct MemoryPoolStatistics
+{
+    std::size_t allocations = 0;    //!< Number of allocate() calls
+    std::size_t hits = 0;           //!< Allocations served by a cached block
+    std::size_t bytes_in_use = 0;   //!< Bytes allocated and not yet deallocated
+    std::size_t cached_bytes = 0;   //!< Bytes of the free blocks kept by the pool
+    std::size_t memory_cap = 0;     //!< Maximum value of cached_bytes
+};
+
+/**
+ * Pool of raw memory blocks used by PoolAllocator
+ *
+ * Requests are rounded up to power of two size classes, from 2^MIN_CLASS to
+ * 2^MAX_CLASS bytes, bigger requests go directly to operator new.
+ * Deallocated blocks are kept in a lock free stack for each class and reused
+ * by the following allocations of the same class, up to memoryCap() bytes.
+ * A pool can be shared by any number of threads and allocators.
+ */
+class COCOEXPORT MemoryPool
+{
+public:
+    static const unsigned MIN_CLASS = 6;
+    static const unsigned MAX_CLASS = 26;
+    static const unsigned DEPOT_SIZE = 32;  //!< Free blocks kept for each class
+    static const std::size_t DEFAULT_MEMORY_CAP = 64ul << 20;
+
+    explicit MemoryPool(std::size_t memory_cap = DEFAULT_MEMORY_CAP)
+        : memory_cap_(memory_cap) {}
+    ~MemoryPool();
+    MemoryPool(const MemoryPool &) = delete;
+    MemoryPool & operator=(const MemoryPool &) = delete;
+
+    void * allocate(std::size_t bytes);
+    /*! \param bytes Must be the same value passed to allocate().
+     */
+    void deallocate(void *ptr, std::size_t bytes);
+    /*! \brief Free all the cached blocks.
+     */
+    void trim();
+
+    MemoryPoolStatistics statistics() const;
+    /*! \return The pool used by default constructed allocators.
+     */
+    static const std::shared_ptr<MemoryPool> & defaultPool();
+
+private:
+    static const unsigned CLASSES = MAX_CLASS - MIN_CLASS + 1;
+
+    /*! \return The smallest c with 2^c >= bytes.
+     */
+    static unsigned sizeClass(std::size_t bytes)
+    {
+        unsigned c = MIN_CLASS;
+        while (c <= MAX_CLASS && (std::size_t(1) << c) < bytes)
+            ++c;
+        return c;
+    }
+
+    boost::lockfree::stack<void *, boost::lockfree::capacity<DEPOT_SIZE> > free_[CLASSES];
+    const std::size_t memory_cap_;
+    std::atomic<std::size_t> allocations_ = {0};
+    std::atomic<std::size_t> hits_ = {0};
+    std::atomic<std::size_t> bytes_in_use_ = {0};
+    std::atomic<std::size_t> cached_bytes_ = {0};
+};
+
 /**
- * Allocator based on the VectorPool that can be used for allocating std::vector
+ * Allocator taking its memory from a MemoryPool
  *
- * In practice this provides the memory for the std::vector on request. Everytime
- * it is resizes the pool gets called
+ * The allocator is stateful, copies and rebound copies share the same pool and
+ * compare equal only if they use the same pool. The pool follows the container
+ * on copy, move and swap. Default constructed allocators use MemoryPool::defaultPool().
  */
 template <class T>
 class PoolAllocator
 {
 public:
     typedef T value_type;
-    PoolAllocator(/*ctor args*/)
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind
+    {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator()
+        : pool_(MemoryPool::defaultPool())
+    {}
+    explicit PoolAllocator(std::shared_ptr<MemoryPool> pool)
+        : pool_(std::move(pool))
     {}
     template <class U>
     PoolAllocator(const PoolAllocator<U>& other)
+        : pool_(other.pool())
+    {}
+    /* Moving copies the pool as well, a moved from container can still allocate */
+    PoolAllocator(const PoolAllocator& other)
+        : pool_(other.pool_)
+    {}
+    PoolAllocator(PoolAllocator&& other)
+        : pool_(other.pool_)
     {}
+    PoolAllocator & operator=(const PoolAllocator& other)
+    {
+        pool_ = other.pool_;
+        return *this;
+    }
+    PoolAllocator & operator=(PoolAllocator&& other)
+    {
+        pool_ = other.pool_;
+        return *this;
+    }
 
     T* allocate(std::size_t n)
     {
-        ptr_ = VectorPool<T>::get(n);
-        return ptr_->data();
+        return static_cast<T *>(pool_->allocate(n * sizeof(T)));
     }
 
     void deallocate(T* p, std::size_t n)
     {
-        ptr_.reset();
+        pool_->deallocate(p, n * sizeof(T));
     }
+
+    const std::shared_ptr<MemoryPool> & pool() const { return pool_; }
+
 private:
-    std::shared_ptr<std::vector<T> > ptr_;
+    std::shared_ptr<MemoryPool> pool_;
 };
 
 template <class T, class U>
 bool operator==(const PoolAllocator<T>& p1, const PoolAllocator<U>& p2)
 {
-    return typeid(T) == typeid(U);
-    //return p1.ptr() == p2.ptr();
+    return p1.pool() == p2.pool();
 }
 template <class T, class U>
 bool operator!=(const PoolAllocator<T>& p1, const PoolAllocator<U>& p2)
 {
-    return typeid(T) != typeid(U);
-    //return p1.ptr() != p2.ptr();
+    return p1.pool() != p2.pool();
 }
 
 template<class T>
@@ -0,0 +1,130 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Memory used by a task or a connection.
+ */
+struct MemoryStatistics
+{
+    std::size_t live_bytes = 0;       //!< Bytes currently allocated
+    std::size_t peak_bytes = 0;       //!< Maximum of live_bytes plus the scratch memory of a step
+    uint64_t allocations = 0;         //!< Allocations since the last reset
+    uint64_t allocated_bytes = 0;     //!< Bytes allocated since the last reset
+    double allocation_rate = 0;       //!< Bytes allocated per second since the last reset
+
+    std::string toString() const;
+};
+
+/*! \brief Counters of the memory charged to an owner, a task or a connection.
+ *  Memory can be released by a different thread than the one that allocated it,
+ *  so all the counters are relaxed atomics and can be read from any thread.
+ *  An account made current must be owned by a shared_ptr: the allocations charged to it
+ *  keep it alive, as they can be released after its owner is destroyed.
+ */
+class COCOEXPORT MemoryAccount : public std::enable_shared_from_this<MemoryAccount>
+{
+public:
+    MemoryAccount();
+
+    /*! \brief Charge an allocation that stays alive until deallocate().
+     */
+    void allocate(std::size_t bytes)
+    {
+        count(bytes);
+        updatePeak(live_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+    void deallocate(std::size_t bytes)
+    {
+        live_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    /*! \brief Charge memory used and released inside one step, e.g. the scratch arena.
+     */
+    void transient(std::size_t bytes)
+    {
+        count(bytes);
+        updatePeak(live_.load(std::memory_order_relaxed) + bytes);
+    }
+    /*! \brief Memory already charged that is filled again, e.g. a slot of a connection
+     *  buffer. Only counted in the allocation rate.
+     */
+    void reuse(std::size_t bytes)
+    {
+        count(bytes);
+    }
+    /*! \brief Restart the allocation counters and set the peak to the live bytes.
+     */
+    void reset();
+
+    MemoryStatistics statistics() const;
+    /*!
+     * \return The account of the task executing on the calling thread, nullptr if none.
+     */
+    static MemoryAccount * current();
+    /*! \brief Set the account charged by the allocations of the calling thread.
+     *  \return The previous account.
+     */
+    static MemoryAccount * setCurrent(MemoryAccount *account);
+
+private:
+    void count(std::size_t bytes)
+    {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void updatePeak(std::size_t bytes)
+    {
+        std::size_t peak = peak_.load(std::memory_order_relaxed);
+        while (bytes > peak &&
+               !peak_.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {}
+    }
+
+    std::atomic<std::size_t> live_ = {0};
+    std::atomic<std::size_t> peak_ = {0};
+    std::atomic<uint64_t> allocations_ = {0};
+    std::atomic<uint64_t> allocated_bytes_ = {0};
+    std::atomic<int long> start_time_;  //!< Time of the last reset in us
+};
+
+/*! \brief Charge the allocations of the calling thread to an account for the lifetime
+ *  of the object, restoring the previous one on destruction.
+ */
+class MemoryAccountScope
+{
+public:
+    explicit MemoryAccountScope(MemoryAccount *account)
+        : previous_(MemoryAccount::setCurrent(account))
+    {}
+    ~MemoryAccountScope()
+    {
+        MemoryAccount::setCurrent(previous_);
+    }
+    MemoryAccountScope(const MemoryAccountScope &) = delete;
+    MemoryAccountScope & operator=(const MemoryAccountScope &) = delete;
+
+private:
+    MemoryAccount *previous_;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
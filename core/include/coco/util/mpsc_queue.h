@@ -0,0 +1,164 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Link of the elements of MpscQueue and NodePool, to be inherited by the element type.
+ */
+struct MpscNode
+{
+    std::atomic<MpscNode *> mpsc_next = {nullptr};
+    std::atomic<uint32_t> pool_next = {0};  //!< Next free node while in a NodePool
+};
+
+/*! \brief Intrusive unbounded queue with many producers and one consumer, see
+ *  http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ *  A push is one atomic exchange and never waits. pop() and size() can only be
+ *  called by the consumer thread. The queue doesn't own the nodes.
+ */
+template <class Node>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : head_(&stub_), tail_(&stub_)
+    {}
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue & operator=(const MpscQueue &) = delete;
+
+    void push(Node *node)
+    {
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        link(node);
+    }
+    /*!
+     * \return The oldest node, null if the queue is empty or the producer of the next
+     *         node has not completed the push yet.
+     */
+    Node * pop()
+    {
+        MpscNode *tail = tail_;
+        MpscNode *next = tail->mpsc_next.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (!next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->mpsc_next.load(std::memory_order_acquire);
+        }
+        if (!next)
+        {
+            if (tail != head_.load(std::memory_order_acquire))
+                return nullptr;
+            link(&stub_);
+            next = tail->mpsc_next.load(std::memory_order_acquire);
+            if (!next)
+                return nullptr;
+        }
+        tail_ = next;
+        ++popped_;
+        return static_cast<Node *>(tail);
+    }
+    /*!
+     * \return The number of nodes pushed and not popped yet, some may still be in the middle of the push.
+     */
+    uint64_t size() const
+    {
+        return pushed_.load(std::memory_order_acquire) - popped_;
+    }
+
+private:
+    void link(MpscNode *node)
+    {
+        node->mpsc_next.store(nullptr, std::memory_order_relaxed);
+        MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpsc_next.store(node, std::memory_order_release);
+    }
+
+    MpscNode stub_;
+    std::atomic<MpscNode *> head_;  //!< Last pushed node, written by the producers
+    MpscNode *tail_;                //!< Next node to pop, owned by the consumer
+    std::atomic<uint64_t> pushed_ = {0};
+    uint64_t popped_ = 0;
+};
+
+/*! \brief Fixed set of N preallocated nodes, acquired and released from any thread without locks.
+ *  The free list is a stack whose head packs the index of the first node with a counter
+ *  incremented at every change, so that a node released and acquired again between the
+ *  load and the exchange of another thread is not mistaken for the same head.
+ */
+template <class Node, uint32_t N>
+class NodePool
+{
+public:
+    NodePool()
+    {
+        for (uint32_t i = 0; i < N; ++i)
+            nodes_[i].pool_next.store(i + 1 < N ? i + 1 : NONE, std::memory_order_relaxed);
+        free_.store(0, std::memory_order_release);
+    }
+    NodePool(const NodePool &) = delete;
+    NodePool & operator=(const NodePool &) = delete;
+
+    /*!
+     * \return A free node, null if all of them are in use.
+     */
+    Node * acquire()
+    {
+        uint64_t head = free_.load(std::memory_order_acquire);
+        while (true)
+        {
+            uint32_t index = static_cast<uint32_t>(head);
+            if (index == NONE)
+                return nullptr;
+            uint32_t next = nodes_[index].pool_next.load(std::memory_order_relaxed);
+            if (free_.compare_exchange_weak(head, tagged(head, next),
+                                            std::memory_order_acq_rel, std::memory_order_acquire))
+                return &nodes_[index];
+        }
+    }
+    void release(Node *node)
+    {
+        uint32_t index = static_cast<uint32_t>(node - nodes_);
+        uint64_t head = free_.load(std::memory_order_relaxed);
+        do
+        {
+            node->pool_next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        }
+        while (!free_.compare_exchange_weak(head, tagged(head, index),
+                                            std::memory_order_release, std::memory_order_relaxed));
+    }
+    bool owns(const Node *node) const
+    {
+        return node >= nodes_ && node < nodes_ + N;
+    }
+
+private:
+    static const uint32_t NONE = 0xffffffff;
+
+    static uint64_t tagged(uint64_t head, uint32_t index)
+    {
+        return (((head >> 32) + 1) << 32) | index;
+    }
+
+    Node nodes_[N];
+    std::atomic<uint64_t> free_;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,164 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <cstdint>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Hardware and software counters averaged over the steps of a task.
+ *  Counters that could not be opened are reported as not available.
+ */
+struct PerfStatistics
+{
+    unsigned long steps = 0;
+    double cycles = 0;
+    double instructions = 0;
+    double llc_misses = 0;
+    double context_switches = 0;
+    unsigned available = 0;  //!< Bit mask of the available PerfCounters::Counter
+
+    bool has(unsigned counter) const { return (available & (1u << counter)) != 0; }
+    /*!
+     * \return Instructions per cycle, 0 if not available.
+     */
+    double ipc() const { return cycles > 0 ? instructions / cycles : 0; }
+
+    std::string toString() const;
+};
+
+/*! \brief Group of perf_event counters measuring the calling thread.
+ *  Opened by each activity on its own thread, so that ExecutionEngine::step()
+ *  can attribute the deltas to the task being executed.
+ *  Only available on Linux, elsewhere open() always fails.
+ */
+class COCOEXPORT PerfCounters
+{
+public:
+    enum Counter
+    {
+        CYCLES = 0,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        CONTEXT_SWITCHES,
+        COUNT
+    };
+
+    struct Sample
+    {
+        uint64_t value[COUNT] = {};
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters & operator=(const PerfCounters &) = delete;
+
+    /*! \brief Open the counters for the calling thread and make them the current ones.
+     *  \return If at least one counter could be opened.
+     */
+    bool open();
+    /*! \brief Close the counters, if they are the current ones of the calling thread they are removed.
+     */
+    void close();
+    /*!
+     * \return Bit mask of the opened counters.
+     */
+    unsigned available() const { return available_; }
+    /*! \brief Read all the counters with a single system call.
+     */
+    bool read(Sample &sample) const;
+    /*!
+     * \return The counters opened by the calling thread, nullptr if none.
+     */
+    static PerfCounters * current();
+
+private:
+    int leader_ = -1;
+    int fds_[COUNT];
+    int slot_[COUNT];  //!< Position of the counter in the group read, -1 if not opened
+    unsigned opened_ = 0;
+    unsigned available_ = 0;
+};
+
+/*! \brief Accumulates the counter deltas of the steps of a task.
+ *  add() must be called by one thread at a time, statistics() can be called from any thread.
+ */
+class PerfAccumulator
+{
+public:
+    PerfAccumulator()
+    {
+        clear();
+    }
+
+    void add(const PerfCounters::Sample &before, const PerfCounters::Sample &after,
+             unsigned available)
+    {
+        if (reset_requested_.load(std::memory_order_relaxed))
+        {
+            reset_requested_.store(false, std::memory_order_relaxed);
+            clear();
+        }
+        for (unsigned i = 0; i < PerfCounters::COUNT; ++i)
+        {
+            uint64_t delta = after.value[i] - before.value[i];
+            totals_[i].store(totals_[i].load(std::memory_order_relaxed) + delta,
+                             std::memory_order_relaxed);
+        }
+        available_.store(available, std::memory_order_relaxed);
+        steps_.store(steps_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    /*! \brief Request to clear the totals, applied by the writer at the next add().
+     */
+    void reset()
+    {
+        reset_requested_.store(true, std::memory_order_relaxed);
+    }
+
+    PerfStatistics statistics() const
+    {
+        PerfStatistics stats;
+        stats.steps = steps_.load(std::memory_order_relaxed);
+        stats.available = available_.load(std::memory_order_relaxed);
+        if (stats.steps == 0)
+            return stats;
+        double steps = static_cast<double>(stats.steps);
+        stats.cycles = totals_[PerfCounters::CYCLES].load(std::memory_order_relaxed) / steps;
+        stats.instructions = totals_[PerfCounters::INSTRUCTIONS].load(std::memory_order_relaxed) / steps;
+        stats.llc_misses = totals_[PerfCounters::LLC_MISSES].load(std::memory_order_relaxed) / steps;
+        stats.context_switches = totals_[PerfCounters::CONTEXT_SWITCHES].load(std::memory_order_relaxed) / steps;
+        return stats;
+    }
+
+private:
+    void clear()
+    {
+        for (auto &t : totals_)
+            t.store(0, std::memory_order_relaxed);
+        steps_.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> totals_[PerfCounters::COUNT];
+    std::atomic<uint64_t> steps_;
+    std::atomic<unsigned> available_ = {0};
+    std::atomic<bool> reset_requested_ = {false};
+};
+
+}  // end of namespace util
+}  // end of namespace coco
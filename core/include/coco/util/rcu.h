@@ -0,0 +1,118 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <memory>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Value read without locks and replaced by copy, read-copy-update style.
+ *  Readers hold a ReadGuard while they use the value: it costs two atomic increments
+ *  and never waits. A writer copies the value, modifies the copy, publishes it and then
+ *  waits until no reader can still see the old value before deleting it. Readers are
+ *  counted in two slots chosen by the parity of an epoch, the writer flips the epoch
+ *  and waits only for the slot of the readers that started before.
+ *  Writers are serialized and must not hold a ReadGuard of the same value.
+ */
+template <class T>
+class Rcu
+{
+public:
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const Rcu &rcu)
+            : rcu_(&rcu)
+        {
+            while (true)
+            {
+                unsigned epoch = rcu_->epoch_.load();
+                slot_ = epoch & 1;
+                rcu_->readers_[slot_].fetch_add(1);
+                if (rcu_->epoch_.load() == epoch)
+                    break;
+                rcu_->readers_[slot_].fetch_sub(1);
+            }
+            value_ = rcu_->value_.load();
+        }
+        ReadGuard(ReadGuard &&other)
+            : rcu_(other.rcu_), value_(other.value_), slot_(other.slot_)
+        {
+            other.rcu_ = nullptr;
+        }
+        ~ReadGuard()
+        {
+            if (rcu_)
+                rcu_->readers_[slot_].fetch_sub(1);
+        }
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard & operator=(const ReadGuard &) = delete;
+
+        const T & operator*() const { return *value_; }
+        const T * operator->() const { return value_; }
+
+    private:
+        const Rcu *rcu_;
+        const T *value_;
+        unsigned slot_;
+    };
+
+    Rcu()
+        : value_(new T())
+    {}
+    ~Rcu()
+    {
+        delete value_.load();
+    }
+    Rcu(const Rcu &) = delete;
+    Rcu & operator=(const Rcu &) = delete;
+
+    ReadGuard read() const
+    {
+        return ReadGuard(*this);
+    }
+    /*! \brief Apply fx to a copy of the value and publish it. Returns once the old value
+     *  has been released by all the readers.
+     */
+    template <class F>
+    void update(F fx)
+    {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        std::unique_ptr<T> next(new T(*value_.load()));
+        fx(*next);
+        T *old = value_.exchange(next.release());
+        synchronize();
+        delete old;
+    }
+
+private:
+    /*! \brief Wait for the readers that may have loaded the previous value.
+     */
+    void synchronize()
+    {
+        unsigned epoch = epoch_.fetch_add(1);
+        while (readers_[epoch & 1].load() != 0)
+            std::this_thread::yield();
+    }
+
+    std::atomic<T *> value_;
+    std::atomic<unsigned> epoch_ = {0};
+    mutable std::atomic<int> readers_[2] = {{0}, {0}};
+    std::mutex writer_mutex_;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,51 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <cstddef>
+
+#include "coco/util/threading.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Helpers to avoid page faults in real time activities.
+ *  Only available on Linux, elsewhere memory is allocated normally and never locked.
+ */
+namespace rt_memory
+{
+
+const std::size_t HUGE_PAGE_SIZE = 2 << 20;
+
+/*! \brief Lock the memory of the process and keep the heap memory once allocated.
+ *  Future mappings are locked too only when the memlock limit allows it, i.e. with
+ *  CAP_IPC_LOCK or an unlimited RLIMIT_MEMLOCK, otherwise a later allocation could fail.
+ *  Executed only once, the following calls return the first result.
+ *  \return If the current memory has been locked.
+ */
+COCOEXPORT bool lockProcessMemory();
+/*! \brief Map memory backed by huge pages when bytes is a multiple of HUGE_PAGE_SIZE,
+ *  falling back to transparent huge pages and then to normal pages.
+ *  The memory is locked when possible and always prefaulted.
+ *  \return The memory, nullptr if it could not be mapped.
+ */
+COCOEXPORT void * map(std::size_t bytes);
+/*! \brief Release memory obtained with map().
+ */
+COCOEXPORT void unmap(void *ptr, std::size_t bytes);
+/*! \brief Touch the stack of the calling thread, so that its pages are present.
+ */
+COCOEXPORT void prefaultStack(std::size_t bytes = 256 << 10);
+
+}  // end of namespace rt_memory
+}  // end of namespace util
+}  // end of namespace coco
@@ -22,6 +22,7 @@
 #include <atomic>
 
 #include "coco/util/threading.h"
+#include "coco/util/histogram.h"
 
 #include "coco/util/logging.h"
 
@@ -56,6 +57,8 @@ struct TimeStatistics
     double service_variance;
     double min;
     double max;
+    HistogramStatistics time_percentiles;
+    HistogramStatistics service_percentiles;
 
     std::string toString() const
     {
@@ -68,14 +71,62 @@ struct TimeStatistics
         ss << "\tService time variance: " << service_variance << std::endl;
         ss << "\tMin: " << min << std::endl; 
         ss << "\tMax: " << max << std::endl;
+        ss << "\tTime percentiles        : " << time_percentiles.toString() << std::endl;
+        ss << "\tService time percentiles: " << service_percentiles.toString() << std::endl;
         return ss.str();
     }
 };
 
+/*! \brief Single writer statistics accumulator for the Timer.
+ *  Mean and variance are updated with Welford's online algorithm,
+ *  which does not suffer of the cancellation of the sum-of-squares formula.
+ */
+struct TimerAccumulator
+{
+    unsigned long iterations = 0;
+    double last = 0;
+    double elapsed = 0;
+    double mean = 0;
+    double m2 = 0;
+    double service_mean = 0;
+    double service_m2 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = 0;
+
+    void addExecution(double time)
+    {
+        last = time;
+        elapsed += time;
+        /* iterations is increased by start(), so it already counts this sample */
+        double delta = time - mean;
+        mean += delta / iterations;
+        m2 += delta * (time - mean);
+        min = std::min(time, min);
+        max = std::max(time, max);
+    }
+
+    void addService(double time)
+    {
+        /* The service time is defined between two consecutive starts */
+        unsigned long n = iterations - 1;
+        double delta = time - service_mean;
+        service_mean += delta / n;
+        service_m2 += delta * (time - service_mean);
+    }
+};
+
+/*! \brief Measure execution and service time of a code section.
+ *  start() and stop() must be called by one thread at a time (the owner activity),
+ *  they only touch the private accumulator and publish it with a seqlock,
+ *  so no read-modify-write atomic is executed on the hot path.
+ *  timeStatistics(), time() and meanTime() can be called from any thread,
+ *  they copy the last published snapshot retrying if a write was in progress.
+ */
 class Timer
 {
 public:
-    using time_point = std::chrono::system_clock::time_point;
+    using clock = std::chrono::steady_clock;
+    using time_point = clock::time_point;
 
     explicit Timer() noexcept
     {}
@@ -88,110 +139,156 @@ public:
         : name_(other.name_)
     {}
 
-    void start()
+    /*! \brief Mark the beginning of the measured section.
+     *  \return The service time since the previous start in seconds, or -1 at the first iteration.
+     */
+    double start()
     {
-        while (lock_.exchange(true));
-
-        auto now = std::chrono::system_clock::now();
-        if (iterations_ != 0)
+        if (reset_requested_.load(std::memory_order_acquire))
         {
-            auto time = std::chrono::duration_cast<std::chrono::microseconds>(
-                        now - start_time_).count() / 1000000.0;
-            service_time_ += time;
-            service_time_square_ += time * time;
+            reset_requested_.store(false, std::memory_order_relaxed);
+            acc_ = TimerAccumulator();
+            publish();
         }
 
+        auto now = clock::now();
+        double service = -1;
+        ++acc_.iterations;
+        if (acc_.iterations > 1)
+        {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          now - start_time_).count();
+            service = us / 1000000.0;
+            acc_.addService(service);
+            service_histogram_.record(us);
+        }
         start_time_ = now;
-        ++iterations_;
-
-        lock_ = false;
+        return service;
     }
-
-    void stop()
+    /*! \brief Mark the end of the measured section.
+     *  \return The execution time in seconds.
+     */
+    double stop()
     {
-        while (lock_.exchange(true));
-        
-
-        time_ = std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::system_clock::now() - start_time_).count() / 1000000.0;
-        elapsed_time_ += time_;
-        elapsed_time_square_ += time_ * time_;
-
-        min_time_ = std::min(time_, min_time_);
-        max_time_ = std::max(time_, max_time_);
-
-        lock_ = false;
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      clock::now() - start_time_).count();
+        double time = us / 1000000.0;
+        acc_.addExecution(time);
+        time_histogram_.record(us);
+        publish();
+        return time;
     }
 
+    /*! \brief Request to clear the statistics.
+     *  Can be called from any thread, the writer applies it at the next start().
+     */
     void reset()
     {
-        while (lock_.exchange(true));
-
-        iterations_ = 0;
-        time_ = 0;
-        elapsed_time_ = 0;
-        elapsed_time_square_ = 0;
-        service_time_ = 0;
-        service_time_square_ = 0;
-        max_time_ = 0;
-        min_time_ = {std::numeric_limits<double>::infinity()};
-
-        lock_ = false;
+        reset_requested_.store(true, std::memory_order_release);
+        time_histogram_.reset();
+        service_histogram_.reset();
     }
 
-    TimeStatistics timeStatistics()
+    /*!
+     * \param percentiles When false the percentiles are left empty, saving the scan of the histograms.
+     */
+    TimeStatistics timeStatistics(bool percentiles = true) const
     {
-        TimeStatistics t;
-        
-        while (lock_.exchange(true));
-        
-        t.last = time_;
-        t.iterations = iterations_;
-        t.elapsed = elapsed_time_;
-        t.mean = elapsed_time_ / iterations_;
-        t.variance = (elapsed_time_square_ / iterations_) -
-                        std::pow(elapsed_time_ / iterations_, 2);
-        t.service_mean = service_time_ / (iterations_ - 1);
-        t.service_variance = (service_time_square_ / (iterations_ - 1)) -
-                                std::pow(service_time_ / (iterations_ - 1), 2);
-        t.min = min_time_;
-        t.max = max_time_;
-
-        lock_ = false;
+        TimerAccumulator a = snapshot();
 
+        TimeStatistics t;
+        t.last = a.last;
+        t.iterations = a.iterations;
+        t.elapsed = a.elapsed;
+        t.mean = a.mean;
+        t.variance = a.iterations > 0 ? a.m2 / a.iterations : 0;
+        t.service_mean = a.service_mean;
+        t.service_variance = a.iterations > 1 ? a.service_m2 / (a.iterations - 1) : 0;
+        t.min = a.min;
+        t.max = a.max;
+        if (percentiles)
+        {
+            t.time_percentiles = time_histogram_.statistics();
+            t.service_percentiles = service_histogram_.statistics();
+        }
         return t;
     }
 
-    double time()
+    /*! \brief Number of started iterations, cheaper than timeStatistics() to detect changes.
+     */
+    unsigned long iterations() const
     {
-        while (lock_.exchange(true));
-        auto t = time_;
-        lock_ = false;
-        return t;
+        return snapshot().iterations;
+    }
+    /*!
+     * \return The seconds spent in the measured section since the last reset.
+     */
+    double elapsed() const
+    {
+        return snapshot().elapsed;
+    }
+    /*!
+     * \return The sum of the service times since the last reset, in seconds.
+     */
+    double serviceElapsed() const
+    {
+        TimerAccumulator a = snapshot();
+        return a.iterations > 1 ? a.service_mean * (a.iterations - 1) : 0;
+    }
+    /*!
+     * \return Histogram of the execution times in microseconds.
+     */
+    const Histogram & timeHistogram() const { return time_histogram_; }
+    /*!
+     * \return Histogram of the service times, between consecutive starts, in microseconds.
+     */
+    const Histogram & serviceHistogram() const { return service_histogram_; }
+
+    double time() const
+    {
+        return snapshot().last;
     }
 
-    double meanTime()
+    double meanTime() const
     {
-        while (lock_.exchange(true));
-        auto t = elapsed_time_ / iterations_;
-        lock_ = false;
-        return t;
+        return snapshot().mean;
     }
 
 private:
+    /* Writer side of the seqlock: odd sequence means a write is in progress */
+    void publish()
+    {
+        unsigned seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        published_ = acc_;
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /* Reader side of the seqlock */
+    TimerAccumulator snapshot() const
+    {
+        TimerAccumulator a;
+        unsigned before, after;
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+            a = published_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+        return a;
+    }
+
     const std::string name_;
     time_point start_time_;
-    unsigned long iterations_ = 0;
-    double time_ = 0;
-    double elapsed_time_ = 0;
-    double elapsed_time_square_ = 0;
-
-    double service_time_ = 0;
-    double service_time_square_ = 0;
-    double max_time_ = 0;
-    double min_time_ = {std::numeric_limits<double>::infinity()};
+    TimerAccumulator acc_;  // Owned by the writer thread
 
-    std::atomic<bool> lock_ = {false};
+    TimerAccumulator published_;
+    std::atomic<unsigned> seq_ = {0};
+    Histogram time_histogram_;
+    Histogram service_histogram_;
+    std::atomic<bool> reset_requested_ = {false};
 };
 
 
@@ -278,7 +375,7 @@ public:
         {
             auto &name = t.first;
             COCO_LOG(1) << "Name: " << name;
-            COCO_LOG(1) << timeStatistics(name).toString();
+            COCO_LOG(1) << t.second->timeStatistics().toString();
         }
         lock_ = false;
     }
@@ -0,0 +1,146 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+#include "coco/util/threading.h"
+#include "coco/util/timing.h"
+
+namespace coco
+{
+namespace util
+{
+
+/*! \brief Kind of event stored by the \ref Tracer.
+ */
+enum class TraceEventType : uint8_t
+{
+    BEGIN,     //!< Start of a slice on the recording thread
+    END,       //!< End of the last slice opened on the recording thread
+    INSTANT,   //!< Point event, e.g. an activity trigger
+    FLOW_OUT,  //!< A message leaves the thread, e.g. data added to a connection
+    FLOW_IN    //!< A message arrives in the thread, e.g. data read from a connection
+};
+
+/*! \brief One entry of the per thread trace buffers.
+ *  Names and categories are not copied: they are string literals or
+ *  names returned by Tracer::intern(), which are never freed.
+ */
+struct TraceEvent
+{
+    int long time;
+    const char *category;
+    const char *name;
+    uint64_t id;  //!< Flow identifier for FLOW_OUT and FLOW_IN events
+    TraceEventType type;
+};
+
+/*! \brief Records execution events in per thread ring buffers and exports
+ *  them in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+ *  Each thread writes only in its own buffer without locks, when the buffer
+ *  is full the oldest events are overwritten. When tracing is disabled every
+ *  hook costs a single relaxed load.
+ */
+class COCOEXPORT Tracer
+{
+public:
+    static Tracer & instance();
+    /*! \brief Start recording events.
+     *  \param capacity Number of events kept for each thread.
+     */
+    void enable(std::size_t capacity = 1 << 16);
+    /*! \brief Stop recording events, the recorded ones are kept.
+     */
+    void disable();
+    /*!
+     * \return If tracing is active.
+     */
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    /*! \brief Give a name to the calling thread in the exported trace.
+     */
+    static void setThreadName(const std::string &name);
+    /*! \brief Stable copy of a dynamic name, e.g. of a task or a connection, to be passed
+     *  to the recording functions. The copy is kept until the end of the process, so the
+     *  events stay valid after the owner of the name is destroyed. Equal names share the copy.
+     */
+    static const char * intern(const std::string &name);
+
+    static void begin(const char *category, const char *name)
+    {
+        if (enabled())
+            instance().record(TraceEventType::BEGIN, category, name, 0);
+    }
+    static void end(const char *category, const char *name)
+    {
+        if (enabled())
+            instance().record(TraceEventType::END, category, name, 0);
+    }
+    static void instant(const char *category, const char *name)
+    {
+        if (enabled())
+            instance().record(TraceEventType::INSTANT, category, name, 0);
+    }
+    /*! \brief Record a message sent by the calling thread.
+     *  \return The identifier of the flow to be passed to flowIn(), 0 if tracing is disabled.
+     */
+    static uint64_t flowOut(const char *category, const char *name)
+    {
+        if (!enabled())
+            return 0;
+        return instance().record(TraceEventType::FLOW_OUT, category, name, 0);
+    }
+    /*! \brief Record a message received by the calling thread.
+     *  \param id The value returned by flowOut() when the message was sent.
+     */
+    static void flowIn(const char *category, const char *name, uint64_t id)
+    {
+        if (enabled() && id != 0)
+            instance().record(TraceEventType::FLOW_IN, category, name, id);
+    }
+    /*! \brief Export the content of the buffers. Can be called while recording.
+     *  \return The trace in Chrome JSON format.
+     */
+    std::string chromeJson() const;
+    /*! \brief Write chromeJson() to a file.
+     */
+    bool dump(const std::string &file_name) const;
+
+private:
+    struct ThreadBuffer
+    {
+        std::vector<TraceEvent> events;
+        std::atomic<uint64_t> head = {0};  //!< Number of events ever written
+        uint64_t next_flow = 0;
+        uint32_t tid = 0;
+        std::string name;
+    };
+
+    Tracer() {}
+    uint64_t record(TraceEventType type, const char *category, const char *name, uint64_t id);
+    ThreadBuffer * threadBuffer();
+
+    static std::atomic<bool> enabled_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer> > buffers_;
+    std::mutex names_mutex_;
+    std::unordered_set<std::string> names_;  //!< Interned names, the nodes never move
+    std::size_t capacity_ = 1 << 16;
+};
+
+}  // end of namespace util
+}  // end of namespace coco
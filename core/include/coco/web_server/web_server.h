@@ -18,8 +18,18 @@ namespace coco
 class COCOEXPORT WebServer
 {
 public:
+	static const unsigned DEFAULT_UPDATE_PERIOD = 200;
+
+	/*! \brief Start serving the web UI on its own thread.
+	 *  \param graph_svg The drawing served as /graph.svg. If empty the graph is drawn by
+	 *         \ref GraphSvg and drawn again when it changes, /graph.svg?overlay=1 adds the
+	 *         load of the tasks and the rate of the connections of the last state update.
+	 *  \param update_period Milliseconds between the state updates pushed to the web pages
+	 *         connected with a websocket. Only what changed since the previous update is sent.
+	 */
 	static bool start(unsigned port, const std::string& appname,
-			const std::string& graph_svg, const std::string& web_server_root);
+			const std::string& graph_svg, const std::string& web_server_root,
+			unsigned update_period = DEFAULT_UPDATE_PERIOD);
 	static void stop();
 	static bool isRunning();
 	static void addLogString(const std::string &msg);
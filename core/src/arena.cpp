@@ -0,0 +1,131 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <algorithm>
+#include <new>
+
+#include "coco/util/arena.h"
+#include "coco/util/rt_memory.h"
+
+namespace coco
+{
+namespace util
+{
+
+namespace
+{
+thread_local Arena *current_arena = nullptr;
+}  // end of anonymous namespace
+
+Arena::Arena(std::size_t chunk_size)
+    : chunk_size_(chunk_size)
+{}
+
+Arena::~Arena()
+{
+    freeChunks();
+}
+
+char * Arena::newChunk(std::size_t &size)
+{
+    if (!locked_)
+        return new char[size];
+    size = (size + rt_memory::HUGE_PAGE_SIZE - 1) / rt_memory::HUGE_PAGE_SIZE * rt_memory::HUGE_PAGE_SIZE;
+    char *chunk = static_cast<char *>(rt_memory::map(size));
+    if (!chunk)
+        throw std::bad_alloc();
+    return chunk;
+}
+
+void Arena::freeChunks()
+{
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+    {
+        if (locked_)
+            rt_memory::unmap(chunks_[i], chunk_sizes_[i]);
+        else
+            delete[] chunks_[i];
+    }
+    chunks_.clear();
+    chunk_sizes_.clear();
+    used_ = 0;
+    begin_ = head_ = end_ = nullptr;
+}
+
+void Arena::setLockedMemory(bool locked)
+{
+    freeChunks();
+    locked_ = locked;
+}
+
+void Arena::reserve(std::size_t bytes)
+{
+    if (!chunks_.empty() && chunk_sizes_.front() >= bytes)
+        return;
+    freeChunks();
+    std::size_t size = std::max(chunk_size_, bytes);
+    begin_ = head_ = newChunk(size);
+    end_ = begin_ + size;
+    chunks_.push_back(begin_);
+    chunk_sizes_.push_back(size);
+}
+
+void * Arena::allocateChunk(std::size_t bytes, std::size_t alignment)
+{
+    if (head_)
+        used_ += head_ - begin_;
+    std::size_t size = std::max(chunk_size_, bytes + alignment);
+    begin_ = newChunk(size);
+    end_ = begin_ + size;
+    chunks_.push_back(begin_);
+    chunk_sizes_.push_back(size);
+
+    std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(begin_) + alignment - 1) &
+                             ~static_cast<std::uintptr_t>(alignment - 1);
+    char *ptr = reinterpret_cast<char *>(aligned);
+    head_ = ptr + bytes;
+    return ptr;
+}
+
+void Arena::reset()
+{
+    high_water_ = std::max(high_water_, used());
+    if (chunks_.size() > 1)
+    {
+        /* Merge the chunks so that the next iteration fits in one */
+        std::size_t total = 0;
+        for (std::size_t size : chunk_sizes_)
+            total += size;
+        freeChunks();
+        chunks_.push_back(newChunk(total));
+        chunk_sizes_.push_back(total);
+    }
+    used_ = 0;
+    if (chunks_.empty())
+    {
+        begin_ = head_ = end_ = nullptr;
+        return;
+    }
+    begin_ = head_ = chunks_.front();
+    end_ = begin_ + chunk_sizes_.front();
+}
+
+Arena * Arena::current()
+{
+    return current_arena;
+}
+
+void Arena::setCurrent(Arena *arena)
+{
+    current_arena = arena;
+}
+
+}  // end of namespace util
+}  // end of namespace coco
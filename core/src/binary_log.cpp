@@ -0,0 +1,418 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <unordered_map>
+#include <iomanip>
+
+#include "coco/util/binary_log.h"
+#include "coco/util/timing.h"
+
+namespace coco
+{
+namespace util
+{
+
+const char BinaryLog::MAGIC[8] = {'C', 'O', 'C', 'O', 'B', 'L', 'O', 'G'};
+const uint32_t BinaryLog::VERSION;
+
+namespace
+{
+template <class T>
+void writeValue(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void writeString(std::ostream &out, const char *str)
+{
+    uint32_t size = str ? static_cast<uint32_t>(std::strlen(str)) : 0;
+    writeValue(out, size);
+    out.write(str, size);
+}
+
+template <class T>
+bool readValue(std::istream &in, T &value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+bool readString(std::istream &in, std::string &str)
+{
+    uint32_t size;
+    if (!readValue(in, size))
+        return false;
+    str.resize(size);
+    return size == 0 || static_cast<bool>(in.read(&str[0], size));
+}
+
+/*! \brief Decode a varint from a buffer.
+ *  \return The number of bytes used, 0 if malformed.
+ */
+std::size_t getVarint(const char *data, std::size_t size, uint64_t &value)
+{
+    value = 0;
+    for (std::size_t i = 0; i < size && i < 10; ++i)
+    {
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+        if (!(byte & 0x80))
+            return i + 1;
+    }
+    return 0;
+}
+
+bool readVarint(std::istream &in, uint64_t &value)
+{
+    value = 0;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        char byte;
+        if (!in.get(byte))
+            return false;
+        value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/*! \brief Size of the encoded argument of the given type starting at data, 0 if malformed.
+ */
+std::size_t argSize(BinaryArg type, const char *data, std::size_t size)
+{
+    std::size_t needed;
+    uint64_t value;
+    switch (type)
+    {
+        case BinaryArg::INT:
+        case BinaryArg::UINT:
+            needed = getVarint(data, size, value);
+            if (needed == 0)
+                return 0;
+            break;
+        case BinaryArg::DOUBLE:
+            needed = sizeof(double);
+            break;
+        case BinaryArg::BOOL:
+        case BinaryArg::CHAR:
+            needed = 1;
+            break;
+        case BinaryArg::STRING:
+        {
+            std::size_t length_size = getVarint(data, size, value);
+            if (length_size == 0)
+                return 0;
+            needed = length_size + value;
+            break;
+        }
+        default:
+            return 0;
+    }
+    return needed <= size ? needed : 0;
+}
+
+/*! \brief Print an argument already validated by argSize().
+ */
+void printArg(BinaryArg type, const char *data, std::size_t size, std::ostream &out)
+{
+    uint64_t varint;
+    switch (type)
+    {
+        case BinaryArg::INT:
+            getVarint(data, size, varint);
+            out << unzigzag(varint);
+            break;
+        case BinaryArg::UINT:
+            getVarint(data, size, varint);
+            out << varint;
+            break;
+        case BinaryArg::DOUBLE:
+        {
+            double value;
+            std::memcpy(&value, data, sizeof(value));
+            out << value;
+            break;
+        }
+        case BinaryArg::BOOL:
+            out << (data[0] ? "true" : "false");
+            break;
+        case BinaryArg::CHAR:
+            out << data[0];
+            break;
+        case BinaryArg::STRING:
+        {
+            std::size_t length_size = getVarint(data, size, varint);
+            out.write(data + length_size, varint);
+            break;
+        }
+    }
+}
+
+void printTime(int long time, std::ostream &out)
+{
+    time_t seconds = time / 1000000;
+    struct tm *local = localtime(&seconds);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%H:%M:%S", local);
+    out << buffer << "." << std::setw(6) << std::setfill('0') << time % 1000000
+        << std::setfill(' ');
+}
+}  // end of anonymous namespace
+
+BinaryLog & BinaryLog::instance()
+{
+    static BinaryLog log;
+    return log;
+}
+
+BinaryLog::~BinaryLog()
+{
+    close();
+}
+
+bool BinaryLog::open(const std::string &file_name)
+{
+    close();
+    std::unique_lock<std::mutex> mlock(mutex_);
+    file_buffer_.resize(1 << 20);
+    file_.rdbuf()->pubsetbuf(file_buffer_.data(), file_buffer_.size());
+    file_.open(file_name, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open())
+        return false;
+    /* Definitions have to be written again in the new file */
+    ++generation_;
+    last_time_ = 0;
+    file_.write(MAGIC, sizeof(MAGIC));
+    writeValue(file_, VERSION);
+    open_.store(true, std::memory_order_release);
+    return file_.good();
+}
+
+void BinaryLog::close()
+{
+    if (!open_.load(std::memory_order_acquire))
+        return;
+    /* The messages still in the log rings belong to this file */
+    LoggerManager::instance()->flushAsync();
+    std::unique_lock<std::mutex> mlock(mutex_);
+    open_.store(false, std::memory_order_release);
+    file_.close();
+}
+
+std::vector<char> & BinaryLog::threadBuffer()
+{
+    static thread_local std::vector<char> buffer;
+    return buffer;
+}
+
+uint32_t BinaryLog::registerSite(BinaryCallSite &site, const char *format)
+{
+    std::unique_lock<std::mutex> mlock(mutex_);
+    uint32_t id = site.id.load(std::memory_order_relaxed);
+    if (id == 0)
+    {
+        site.format = format;
+        sites_.push_back(&site);
+        id = static_cast<uint32_t>(sites_.size());
+        site.id.store(id, std::memory_order_release);
+    }
+    return id;
+}
+
+void BinaryLog::writeMessage(const BinaryCallSite &site, uint32_t id, const std::vector<char> &args)
+{
+    if (open_.load(std::memory_order_acquire))
+    {
+        /* The id fits the level of the ring header, the logger thread calls writeQueued() */
+        auto lm = LoggerManager::instance();
+        if (lm->isAsync() &&
+            lm->enqueue(Type::LOG, static_cast<int>(id), LogRing::BINARY,
+                        "", 0, args.data(), args.size()))
+            return;
+
+        std::unique_lock<std::mutex> mlock(mutex_);
+        if (file_.is_open())
+        {
+            writeLocked(*sites_[id - 1], util::time(), args.data(), args.size());
+            return;
+        }
+    }
+    /* No binary log, fall back to the text one */
+    std::ostringstream text;
+    format(site.format, site.arg_types, site.arg_count, args.data(), args.size(), text);
+    LogMessage(Type::LOG, site.level).stream() << text.str();
+}
+
+void BinaryLog::writeQueued(uint32_t id, int64_t time, const std::string &args)
+{
+    std::unique_lock<std::mutex> mlock(mutex_);
+    if (!file_.is_open() || id == 0 || id > sites_.size())
+        return;
+    writeLocked(*sites_[id - 1], time, args.data(), args.size());
+}
+
+void BinaryLog::writeLocked(BinaryCallSite &site, int64_t time, const char *args, std::size_t size)
+{
+    if (site.generation != generation_)
+    {
+        site.generation = generation_;
+        file_.put(0);
+        writeValue(file_, site.id.load(std::memory_order_relaxed));
+        writeValue(file_, static_cast<int32_t>(site.level));
+        writeValue(file_, static_cast<uint32_t>(site.line));
+        writeString(file_, site.file);
+        writeString(file_, site.format);
+        writeValue(file_, site.arg_count);
+        file_.write(reinterpret_cast<const char *>(site.arg_types), site.arg_count);
+    }
+    record_.clear();
+    putVarint(record_, site.id.load(std::memory_order_relaxed));
+    putVarint(record_, zigzag(time - last_time_));
+    last_time_ = time;
+    file_.write(record_.data(), record_.size());
+    file_.write(args, size);
+}
+
+bool BinaryLog::format(const char *format, const BinaryArg *types, unsigned count,
+                       const char *args, std::size_t size, std::ostream &out)
+{
+    unsigned arg = 0;
+    std::size_t pos = 0;
+    for (; format && *format; ++format)
+    {
+        if (format[0] == '{' && format[1] == '}' && arg < count)
+        {
+            std::size_t arg_size = argSize(types[arg], args + pos, size - pos);
+            if (arg_size == 0)
+                return false;
+            printArg(types[arg], args + pos, arg_size, out);
+            pos += arg_size;
+            ++arg;
+            ++format;
+        }
+        else
+        {
+            out << *format;
+        }
+    }
+    /* Arguments without a placeholder */
+    for (; arg < count; ++arg)
+    {
+        std::size_t arg_size = argSize(types[arg], args + pos, size - pos);
+        if (arg_size == 0)
+            return false;
+        out << " ";
+        printArg(types[arg], args + pos, arg_size, out);
+        pos += arg_size;
+    }
+    return true;
+}
+
+bool BinaryLog::decode(std::istream &in, std::ostream &out)
+{
+    char magic[sizeof(MAGIC)];
+    uint32_t version;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !readValue(in, version) || version != VERSION)
+        return false;
+
+    struct Definition
+    {
+        int32_t level;
+        uint32_t line;
+        std::string file;
+        std::string format;
+        std::vector<BinaryArg> types;
+    };
+    std::unordered_map<uint32_t, Definition> definitions;
+    std::vector<char> args;
+    int64_t time = 0;
+    uint64_t id;
+    while (in.peek() != std::char_traits<char>::eof())
+    {
+        if (!readVarint(in, id))
+            return false;
+        if (id == 0)
+        {
+            uint32_t site_id;
+            uint8_t count;
+            if (!readValue(in, site_id))
+                return false;
+            Definition &def = definitions[site_id];
+            if (!readValue(in, def.level) || !readValue(in, def.line) ||
+                !readString(in, def.file) || !readString(in, def.format) ||
+                !readValue(in, count))
+                return false;
+            def.types.resize(count);
+            if (count > 0 && !in.read(reinterpret_cast<char *>(def.types.data()), count))
+                return false;
+            continue;
+        }
+        uint64_t delta;
+        if (!readVarint(in, delta))
+            return false;
+        time += unzigzag(delta);
+        /* Without its definition the size of the message is unknown */
+        auto def = definitions.find(id);
+        if (def == definitions.end())
+            return false;
+        /* Read the arguments one by one, their size depends on the type */
+        args.clear();
+        for (BinaryArg type : def->second.types)
+        {
+            uint64_t varint;
+            std::size_t payload = 0;
+            switch (type)
+            {
+                case BinaryArg::INT:
+                case BinaryArg::UINT:
+                case BinaryArg::STRING:
+                {
+                    if (!readVarint(in, varint))
+                        return false;
+                    putVarint(args, varint);
+                    if (type == BinaryArg::STRING)
+                        payload = varint;
+                    break;
+                }
+                case BinaryArg::DOUBLE:
+                    payload = sizeof(double);
+                    break;
+                case BinaryArg::BOOL:
+                case BinaryArg::CHAR:
+                    payload = 1;
+                    break;
+                default:
+                    return false;
+            }
+            std::size_t start = args.size();
+            args.resize(start + payload);
+            if (payload > 0 && !in.read(&args[start], payload))
+                return false;
+        }
+
+        out << "[LOG " << def->second.level << "] ";
+        printTime(time, out);
+        out << " " << def->second.file << ":" << def->second.line << ": ";
+        if (!format(def->second.format.c_str(), def->second.types.data(),
+                    static_cast<unsigned>(def->second.types.size()), args.data(), args.size(), out))
+            return false;
+        out << "\n";
+    }
+    return true;
+}
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -9,9 +9,13 @@
  */
 
 #include <string>
+#include <sstream>
+#include <algorithm>
 
 #include "coco/task.h"
 #include "coco/connection.h"
+#include "coco/util/tracing.h"
+#include "coco/util/timing.h"
 
 namespace coco
 {
@@ -55,12 +59,64 @@ ConnectionPolicy::ConnectionPolicy(const std::string & policy,
                      << transport_type;
 }
 
+void TraceOrigins::addOrigin(const TaskContext *source, int long time)
+{
+    for (unsigned i = 0; i < origins_count; ++i)
+    {
+        if (origins[i].source == source)
+        {
+            origins[i] = TraceOrigin();
+            origins[i].source = source;
+            origins[i].time = time;
+            return;
+        }
+    }
+    if (origins_count == MAX_ORIGINS)
+        return;
+    origins[origins_count] = TraceOrigin();
+    origins[origins_count].source = source;
+    origins[origins_count].time = time;
+    ++origins_count;
+}
+
+void TraceOrigins::merge(const TraceOrigins &other)
+{
+    for (unsigned i = 0; i < other.origins_count; ++i)
+    {
+        const TraceOrigin &origin = other.origins[i];
+        unsigned j = 0;
+        while (j < origins_count && origins[j].source != origin.source)
+            ++j;
+        if (j < origins_count)
+        {
+            if (origin.time > origins[j].time)
+                origins[j] = origin;
+        }
+        else if (origins_count < MAX_ORIGINS)
+        {
+            origins[origins_count++] = origin;
+        }
+    }
+}
+
+std::string ConnectionBufferStatistics::toString() const
+{
+    std::stringstream ss;
+    ss << "buffer: " << buffer_bytes / 1024.0 << " KiB "
+       << "writes: " << writes << " "
+       << "rate: " << write_rate / 1024.0 << " KiB/s";
+    return ss.str();
+}
+
 ConnectionBase::ConnectionBase(std::shared_ptr<PortBase> in,
                                std::shared_ptr<PortBase> out,
                                ConnectionPolicy policy)
     : input_(in), output_(out),
-      data_status_(NO_DATA), policy_(policy)
-{}
+      data_status_(NO_DATA), policy_(policy), reset_time_(util::time())
+{
+    trace_name_ = util::Tracer::intern(out->task_->instantiationName() + "." + out->name() +
+                                       " -> " + in->task_->instantiationName() + "." + in->name());
+}
 
 bool ConnectionBase::hasNewData() const
 {
@@ -86,36 +142,130 @@ void ConnectionBase::removeTrigger()
     input_->removeTriggerComponent();
 }
 
+ConnectionBufferStatistics ConnectionBase::bufferStatistics() const
+{
+    ConnectionBufferStatistics stats;
+    stats.buffer_bytes = buffer_bytes_;
+    stats.writes = written_.load(std::memory_order_relaxed) -
+                   reset_written_.load(std::memory_order_relaxed);
+    stats.written_bytes = stats.writes * sample_size_;
+    int long elapsed = util::time() - reset_time_.load(std::memory_order_relaxed);
+    if (elapsed > 0)
+        stats.write_rate = stats.written_bytes * 1000000.0 / elapsed;
+    return stats;
+}
+
+void ConnectionBase::resetBufferStatistics()
+{
+    reset_written_.store(written_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    reset_time_.store(util::time(), std::memory_order_relaxed);
+}
+
+void ConnectionBase::sendTrace(TraceContext &trace)
+{
+    output_->task_->outgoingTrace(trace);
+    trace.flow_id = util::Tracer::flowOut("connection", trace_name_);
+}
+
+void ConnectionBase::receiveTrace(const TraceContext &trace)
+{
+    util::Tracer::flowIn("connection", trace_name_, trace.flow_id);
+    if (trace.enqueue_time <= 0)
+        return;
+    int long now = util::time();
+    int long queue = now - trace.enqueue_time;
+    queue_histogram_.record(queue > 0 ? queue : 0);
+    input_->task_->incomingTrace(trace, now);
+}
+
 bool ConnectionManager::addConnection(
         std::shared_ptr<ConnectionBase> connection)
 {
-    connections_.push_back(connection);
+    connections_.update([&connection](ConnectionList &connections)
+        {
+            connections.push_back(connection);
+        });
     return true;
 }
 
+bool ConnectionManager::replaceConnection(const std::shared_ptr<ConnectionBase> &old_connection,
+                                          const std::shared_ptr<ConnectionBase> &connection)
+{
+    bool found = false;
+    connections_.update([&](ConnectionList &connections)
+        {
+            for (auto & conn : connections)
+            {
+                if (conn == old_connection)
+                {
+                    conn = connection;
+                    found = true;
+                    break;
+                }
+            }
+        });
+    return found;
+}
+
+bool ConnectionManager::removeConnection(const std::shared_ptr<ConnectionBase> &connection)
+{
+    bool found = false;
+    connections_.update([&](ConnectionList &connections)
+        {
+            auto it = std::find(connections.begin(), connections.end(), connection);
+            if (it != connections.end())
+            {
+                connections.erase(it);
+                found = true;
+            }
+        });
+    return found;
+}
+
 bool ConnectionManager::hasConnections() const
 {
-    return connections_.size() != 0;
+    return !connections_.read()->empty();
 }
 
 int ConnectionManager::queueLenght(int connection) const
 {
-    if (connection > static_cast<int>(connections_.size()))
+    auto connections = connections_.read();
+    if (connection >= static_cast<int>(connections->size()))
         return 0;
     if (connection >= 0)
-        return connections_[connection]->queueLength();
+        return (*connections)[connection]->queueLength();
 
     unsigned int lenght = 0;
-    for (auto & conn : connections_)
+    for (auto & conn : *connections)
     {
         lenght += conn->queueLength();
     }
     return lenght;
 }
 
+ConnectionBufferStatistics ConnectionManager::bufferStatistics(int connection) const
+{
+    auto connections = connections_.read();
+    if (connection >= static_cast<int>(connections->size()))
+        return ConnectionBufferStatistics();
+    if (connection >= 0)
+        return (*connections)[connection]->bufferStatistics();
+
+    ConnectionBufferStatistics total;
+    for (auto & conn : *connections)
+    {
+        ConnectionBufferStatistics stats = conn->bufferStatistics();
+        total.buffer_bytes += stats.buffer_bytes;
+        total.writes += stats.writes;
+        total.written_bytes += stats.written_bytes;
+        total.write_rate += stats.write_rate;
+    }
+    return total;
+}
+
 int ConnectionManager::connectionsCount() const
 {
-    return connections_.size();
+    return connections_.read()->size();
 }
 
 
@@ -10,9 +10,12 @@
 
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
 
 #include "coco/util/timing.h"
+#include "coco/util/tracing.h"
 #include "coco/util/linux_sched.h"
+#include "coco/util/rt_memory.h"
 
 #include "coco/task.h"
 #include "coco/register.h"
@@ -32,12 +35,81 @@ bool Activity::isPeriodic() const
     return policy_.scheduling_policy != SchedulePolicy::TRIGGERED;
 }
 
+void Activity::openPerfCounters()
+{
+    if (!ComponentRegistry::perfCountersEnabled())
+        return;
+    perf_counters_.reset(new util::PerfCounters());
+    if (!perf_counters_->open())
+        perf_counters_.reset();
+}
+
+void Activity::prepareMemory()
+{
+    if (!policy_.lock_memory)
+        return;
+    util::rt_memory::lockProcessMemory();
+    util::rt_memory::prefaultStack();
+    scratch_.setLockedMemory(true);
+    scratch_.reserve(policy_.prefault_bytes);
+}
+
+void Activity::configureRunnables()
+{
+    std::list<RunnableInterface *> pending;
+    for (auto &runnable : runnable_list_)
+        pending.push_back(runnable.get());
+    while (!pending.empty() && !stopping_)
+    {
+        bool configured = false;
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (!(*it)->readyToConfigure())
+            {
+                ++it;
+                continue;
+            }
+            (*it)->init();
+            it = pending.erase(it);
+            configured = true;
+        }
+        if (configured)
+            continue;
+        /* The tasks left wait for tasks of other activities */
+        ComponentRegistry::waitConfigReady(stopping_, [&pending]()
+            {
+                for (auto runnable : pending)
+                    if (runnable->readyToConfigure())
+                        return true;
+                return false;
+            });
+    }
+}
+
+std::string Activity::traceThreadName() const
+{
+    std::string name = "activity " + std::to_string(guid_);
+    const char *separator = ": ";
+    for (auto &runnable : runnable_list_)
+    {
+        auto engine = std::dynamic_pointer_cast<ExecutionEngine>(runnable);
+        if (!engine)
+            continue;
+        name += separator + engine->task()->instantiationName();
+        separator = ", ";
+    }
+    return name;
+}
+
 SequentialActivity::SequentialActivity(SchedulePolicy policy)
     : Activity(policy)
 {}
 
 void SequentialActivity::start()
 {
+    /* Set before running, stop() ignores an activity that is not active */
+    stopping_ = false;
+    active_ = true;
     this->entry();
 }
 
@@ -46,12 +118,9 @@ void SequentialActivity::stop()
     if (active_)
     {
         stopping_ = true;
-        if (!isPeriodic())
-            trigger();
-        else
-        {
-            // LIMIT: std::thread sleep cannot be interrupted
-        }
+        ComponentRegistry::notifyConfigWaiters();
+        std::unique_lock<std::mutex> mlock(mutex_);
+        cond_.notify_all();
     }
 }
 
@@ -61,6 +130,20 @@ void SequentialActivity::trigger()
 void SequentialActivity::removeTrigger()
 {}
 
+void SequentialActivity::wakeUp()
+{
+    if (!isPeriodic())
+        return;
+
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        if (wake_up_)
+            return;
+        wake_up_ = true;
+    }
+    cond_.notify_all();
+}
+
 void SequentialActivity::join()
 {
     return;
@@ -74,8 +157,14 @@ std::thread::id SequentialActivity::threadId() const
 
 void SequentialActivity::entry()
 {
-    for (auto &runnable : runnable_list_)
-        runnable->init();
+    if (util::Tracer::enabled())
+        util::Tracer::setThreadName(traceThreadName());
+    openPerfCounters();
+    prepareMemory();
+    util::Arena::setCurrent(&scratch_);
+    configureRunnables();
+    /* No task starts before all of them are configured */
+    ComponentRegistry::waitConfigCompleted(stopping_);
     /* PERIODIC */
     if (isPeriodic())
     {
@@ -86,7 +175,22 @@ void SequentialActivity::entry()
                               std::chrono::milliseconds(policy_.period_ms);
             for (auto &runnable : runnable_list_)
                 runnable->step();
-            std::this_thread::sleep_until(next_start_time);
+            /* Operations called during the wait run before the next period */
+            std::unique_lock<std::mutex> mlock(mutex_);
+            while (!stopping_)
+            {
+                if (wake_up_)
+                {
+                    wake_up_ = false;
+                    mlock.unlock();
+                    for (auto &runnable : runnable_list_)
+                        runnable->stepPending();
+                    mlock.lock();
+                    continue;
+                }
+                if (cond_.wait_until(mlock, next_start_time) == std::cv_status::timeout)
+                    break;
+            }
         }
     }
     /* TRIGGERED */
@@ -110,15 +214,18 @@ void SequentialActivity::entry()
 
     for (auto &runnable : runnable_list_)
         runnable->finalize();
+    perf_counters_.reset();
+    util::Arena::setCurrent(nullptr);
 }
 
 ParallelActivity::ParallelActivity(SchedulePolicy policy)
-    : Activity(policy)
+    : Activity(policy), trace_name_(util::Tracer::intern("activity " + std::to_string(guid_)))
 {}
 
 void ParallelActivity::start()
 {
-    if (thread_)
+    /* A stopped activity can be started again once its thread has been joined */
+    if (thread_ && thread_->joinable())
         return;
     stopping_ = false;
     active_ = true;
@@ -158,6 +265,7 @@ void ParallelActivity::stop()
     if (thread_)
     {
         stopping_ = true;
+        ComponentRegistry::notifyConfigWaiters();
         cond_.notify_all();
     }
 }
@@ -167,6 +275,7 @@ void ParallelActivity::trigger()
     if (isPeriodic())
         return;
     
+    util::Tracer::instant("trigger", trace_name_);
     ++pending_trigger_;
     cond_.notify_all();
 }
@@ -179,6 +288,20 @@ void ParallelActivity::removeTrigger()
     }
 }
 
+void ParallelActivity::wakeUp()
+{
+    if (isPeriodic())
+        return;
+
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        if (wake_up_)
+            return;
+        wake_up_ = true;
+    }
+    cond_.notify_all();
+}
+
 void ParallelActivity::join()
 {
     if (thread_)
@@ -266,9 +389,15 @@ void ParallelActivity::setSchedule()
 void ParallelActivity::entry()
 {
     setSchedule();
+    if (util::Tracer::enabled())
+        util::Tracer::setThreadName(traceThreadName());
+    openPerfCounters();
+    prepareMemory();
+    util::Arena::setCurrent(&scratch_);
 
-    for (auto &runnable : runnable_list_)
-        runnable->init();
+    configureRunnables();
+    /* No task starts before all of them are configured */
+    ComponentRegistry::waitConfigCompleted(stopping_);
 
     /* PERIODIC */
     if (isPeriodic())
@@ -285,8 +414,15 @@ void ParallelActivity::entry()
                     (new_now - now);
             if (sleep_time > std::chrono::microseconds(0))
             {
+                util::Tracer::begin("activity", "wait");
                 std::unique_lock<std::mutex> mlock(mutex_);
                 cond_.wait_for(mlock, sleep_time);
+                util::Tracer::end("activity", "wait");
+            }
+            else
+            {
+                overruns_.store(overruns_.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
             }
         }
     }
@@ -295,13 +431,27 @@ void ParallelActivity::entry()
     {
         while (!stopping_)
         {
-            /* wait on condition variable or timer */
-            if (pending_trigger_ == 0)
+            bool wake_up;
             {
+                /* wait on condition variable or timer */
                 std::unique_lock<std::mutex> mlock(mutex_);
-                cond_.wait(mlock);
+                if (pending_trigger_ == 0 && !wake_up_)
+                {
+                    util::Tracer::begin("activity", "wait");
+                    cond_.wait(mlock);
+                    util::Tracer::end("activity", "wait");
+                }
+                wake_up = wake_up_;
+                wake_up_ = false;
             }
 
+            /* Woken up only to run operations, no new data for onUpdate() */
+            if (wake_up && pending_trigger_ == 0)
+            {
+                for (auto &runnable : runnable_list_)
+                    runnable->stepPending();
+                continue;
+            }
             for (auto &runnable : runnable_list_)
                 runnable->step();
         }
@@ -314,6 +464,8 @@ void ParallelActivity::entry()
     active_ = false;
     for (auto &runnable : runnable_list_)
         runnable->finalize();
+    perf_counters_.reset();
+    util::Arena::setCurrent(nullptr);
 }
 
 // -------------------------------------------------------------------
@@ -325,19 +477,50 @@ ExecutionEngine::ExecutionEngine(std::shared_ptr<TaskContext> task)
 
 void ExecutionEngine::init()
 {
+    if (configured_.exchange(true))
+        return;
+    util::MemoryAccountScope account(memory_.get());
     task_->setState(TaskState::INIT);
     task_->onConfig();
     COCO_DEBUG("Execution") << "[" << task_->instantiationName() << "] onConfig completed.";
     //COCO_DEBUG("Execution") << "Task " << task_->instantiationName() << " is on thread: " << pthread_self() << ", " <<  getpid();
-    coco::ComponentRegistry::increaseConfigCompleted();
+    config_after_.clear();
+    config_completed_.store(true, std::memory_order_release);
+    /* Both wake up the activities waiting for this task to be configured */
+    if (!config_counted_.exchange(true))
+        coco::ComponentRegistry::increaseConfigCompleted();
+    else
+        coco::ComponentRegistry::notifyConfigWaiters();
     task_->setState(TaskState::IDLE);
 }
 
+bool ExecutionEngine::readyToConfigure() const
+{
+    for (auto &dependency : config_after_)
+    {
+        auto engine = dependency.lock();
+        if (engine && !engine->configCompleted())
+            return false;
+    }
+    return true;
+}
+
+void ExecutionEngine::configureAfter(const std::vector<std::shared_ptr<ExecutionEngine> > &engines)
+{
+    config_after_.assign(engines.begin(), engines.end());
+}
+
 void ExecutionEngine::step()
 {
     assert(task_ && "Trying executing an ExecutionEngine without a task");
 
-    while (task_->hasPending())
+    if (!trace_name_)
+        trace_name_ = util::Tracer::intern(task_->instantiationName());
+    const char *trace_name = trace_name_;
+    util::Tracer::begin("task", trace_name);
+    util::MemoryAccountScope account(memory_.get());
+
+    if (task_->hasPending())
     {
         task_->setState(TaskState::PRE_OPERATIONAL);
         task_->stepPending();
@@ -346,42 +529,187 @@ void ExecutionEngine::step()
 
     if (ComponentRegistry::profilingEnabled())
     {
-        if (latency_timer.source)
-        {
-            latency_timer.start_time = util::time();
-        }
+        trace_read_time_ = util::time();
+        trace_.clear();
+        trace_published_.reset();
+        if (latency_source_)
+            trace_.addOrigin(task_.get(), trace_read_time_);
+
+        util::PerfCounters *counters = util::PerfCounters::current();
+        util::PerfCounters::Sample perf_before, perf_after;
+        if (counters)
+            counters->read(perf_before);
 
         timer_.start();
         task_->onUpdate();
         timer_.stop();
 
-        if (latency_timer.tmp_time > 0)
-        {
-            latency_timer.start_time.exchange(latency_timer.tmp_time);
-            latency_timer.tmp_time = -1;
-        }
-        if (latency_timer.target && latency_timer.start_time > 0)
-        {
-            latency_timer.tot_time += util::time() - latency_timer.start_time;
+        if (counters && counters->read(perf_after))
+            perf_.add(perf_before, perf_after, counters->available());
 
-            ++ latency_timer.iterations;
-            latency_timer.start_time = -1;
-            {
-                COCO_LOG_SAMPLE("Execution", 10) << "Latency is : " << double(latency_timer.tot_time / latency_timer.iterations) / 1000000.0;
-            }
-        }
+        if (latency_paths_ && trace_.origins_count > 0)
+            recordLatency();
     }
     else
     {
         task_->onUpdate();
     }
     task_->setState(TaskState::IDLE);
+    resetScratch();
+    util::Tracer::end("task", trace_name);
+}
+
+void ExecutionEngine::stepPending()
+{
+    if (!task_->hasPending())
+        return;
+
+    if (!trace_name_)
+        trace_name_ = util::Tracer::intern(task_->instantiationName());
+    const char *trace_name = trace_name_;
+    util::Tracer::begin("operations", trace_name);
+    util::MemoryAccountScope account(memory_.get());
+    task_->setState(TaskState::PRE_OPERATIONAL);
+    task_->stepPending();
+    task_->setState(TaskState::IDLE);
+    resetScratch();
+    util::Tracer::end("operations", trace_name);
+}
+
+void ExecutionEngine::resetScratch()
+{
+    /* Scratch memory lives only for one step */
+    if (util::Arena *arena = util::Arena::current())
+    {
+        if (std::size_t used = arena->used())
+            memory_->transient(used);
+        arena->reset();
+    }
 }
 
 void ExecutionEngine::finalize()
 {
     if (task_->state() != TaskState::STOPPED)
         task_->stop();
+    config_completed_ = false;
+    configured_ = false;
+}
+
+void ExecutionEngine::resetTimeStatistics()
+{
+    timer_.reset();
+    perf_.reset();
+    memory_->reset();
+    if (!latency_paths_)
+        return;
+    for (unsigned i = 0; i < MAX_LATENCY_PATHS; ++i)
+    {
+        latency_paths_[i].latency.reset();
+        latency_paths_[i].queue.reset();
+        latency_paths_[i].compute.reset();
+    }
+}
+
+void ExecutionEngine::setLatencyTarget()
+{
+    if (!latency_paths_)
+        latency_paths_.reset(new LatencyPath[MAX_LATENCY_PATHS]);
+}
+
+void ExecutionEngine::outgoingTrace(TraceContext &trace)
+{
+    if (!ComponentRegistry::profilingEnabled())
+    {
+        trace.clear();
+        return;
+    }
+    /* One copy of the origins per read, the compute time up to the write is added by the reader */
+    if (!trace_published_ && trace_.origins_count > 0)
+    {
+        auto origins = std::make_shared<TraceOrigins>(trace_);
+        origins->read_time = trace_read_time_;
+        trace_published_ = origins;
+    }
+    trace.origins = trace_published_;
+    trace.enqueue_time = util::time();
+}
+
+void ExecutionEngine::incomingTrace(const TraceContext &trace, int long now)
+{
+    /* Time spent before this read is accounted as compute time of the task */
+    for (unsigned i = 0; i < trace_.origins_count; ++i)
+        trace_.origins[i].compute_time += now - trace_read_time_;
+    if (trace.origins)
+    {
+        TraceOrigins hop = *trace.origins;
+        for (unsigned i = 0; i < hop.origins_count; ++i)
+        {
+            hop.origins[i].compute_time += trace.enqueue_time - hop.read_time;
+            hop.origins[i].queue_time += now - trace.enqueue_time;
+        }
+        trace_.merge(hop);
+    }
+    trace_read_time_ = now;
+    trace_published_.reset();
+}
+
+void ExecutionEngine::recordLatency()
+{
+    int long now = util::time();
+    for (unsigned i = 0; i < trace_.origins_count; ++i)
+    {
+        const TraceOrigin &origin = trace_.origins[i];
+        if (origin.source == task_.get())
+            continue;
+
+        LatencyPath *path = nullptr;
+        for (unsigned j = 0; j < MAX_LATENCY_PATHS; ++j)
+        {
+            const TaskContext *source = latency_paths_[j].source.load(std::memory_order_relaxed);
+            if (source == origin.source)
+            {
+                path = &latency_paths_[j];
+                break;
+            }
+            if (!source)
+            {
+                path = &latency_paths_[j];
+                path->source.store(origin.source, std::memory_order_release);
+                break;
+            }
+        }
+        if (!path)
+        {
+            COCO_LOG_SAMPLE("Execution", 1000) << "[" << task_->instantiationName()
+                << "] more than " << MAX_LATENCY_PATHS << " latency sources, ignoring "
+                << origin.source->instantiationName();
+            continue;
+        }
+        int long compute = origin.compute_time + now - trace_read_time_;
+        path->latency.record(std::max(0l, now - origin.time));
+        path->queue.record(std::max(0l, origin.queue_time));
+        path->compute.record(std::max(0l, compute));
+    }
+}
+
+std::vector<LatencyPathStatistics> ExecutionEngine::latencyStatistics() const
+{
+    std::vector<LatencyPathStatistics> stats;
+    if (!latency_paths_)
+        return stats;
+    for (unsigned i = 0; i < MAX_LATENCY_PATHS; ++i)
+    {
+        const TaskContext *source = latency_paths_[i].source.load(std::memory_order_acquire);
+        if (!source)
+            break;
+        LatencyPathStatistics path;
+        path.source = source->instantiationName();
+        path.latency = latency_paths_[i].latency.statistics();
+        path.queue = latency_paths_[i].queue.statistics();
+        path.compute = latency_paths_[i].compute.statistics();
+        stats.push_back(path);
+    }
+    return stats;
 }
 
 }  // end of namespace coco
@@ -0,0 +1,462 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+#include "coco/graph_svg.h"
+#include "coco/register.h"
+
+namespace coco
+{
+
+namespace
+{
+const double MARGIN = 20;
+const double GLYPH_WIDTH = 7;  // Average width of a character of the 12px font
+const double TITLE_HEIGHT = 38;
+const double ROW_HEIGHT = 18;
+const double PADDING = 10;
+const double MIN_WIDTH = 120;
+const double LAYER_GAP = 90;
+const double NODE_GAP = 30;
+const int ORDER_SWEEPS = 4;
+
+std::string escape(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string format(const char *fmt, double v)
+{
+    char str[32];
+    snprintf(str, sizeof(str), fmt, v);
+    return str;
+}
+
+std::string loadText(double load)
+{
+    return format("%.0f%%", load * 100);
+}
+
+std::string rateText(double rate)
+{
+    return format(rate < 10 ? "%.1f/s" : "%.0f/s", rate);
+}
+
+/* From white to red while the task approaches a full core */
+std::string loadColor(double load)
+{
+    load = std::max(0.0, std::min(1.0, load));
+    char str[16];
+    snprintf(str, sizeof(str), "#ff%02x%02x", static_cast<int>(255 - 120 * load),
+             static_cast<int>(255 - 255 * load));
+    return str;
+}
+
+double textWidth(const std::string &text)
+{
+    return text.size() * GLYPH_WIDTH;
+}
+
+std::string portLabel(const std::string &prefix, const PortBase &port)
+{
+    return prefix + port.name() + (port.isEvent() ? " (event)" : "");
+}
+}  // end of anonymous namespace
+
+std::string GraphSvg::connectionKey(const std::string &src_task, const std::string &src_port,
+                                    const std::string &dest_task, const std::string &dest_port)
+{
+    return src_task + "/" + src_port + "->" + dest_task + "/" + dest_port;
+}
+
+void GraphSvg::layout()
+{
+    nodes_.clear();
+    edges_.clear();
+
+    /* Tasks in the order of their activities, the ports of the peers belong to the box of the task */
+    std::vector<std::pair<std::shared_ptr<TaskContext>, std::string> > tasks;
+    int activity_id = 0;
+    for (auto &activity : ComponentRegistry::activities())
+    {
+        std::string caption = "activity " + std::to_string(activity_id++) + ": ";
+        if (activity->isPeriodic())
+            caption += "periodic " + std::to_string(activity->period()) + " ms";
+        else
+            caption += "triggered";
+        for (auto &runnable : activity->runnables())
+        {
+            if (auto engine = std::dynamic_pointer_cast<ExecutionEngine>(runnable))
+                tasks.emplace_back(engine->task(), caption);
+        }
+    }
+    std::map<std::string, std::shared_ptr<TaskContext> > others;
+    for (auto &task : ComponentRegistry::tasks())
+    {
+        if (!isPeer(task.second))
+            others.insert(task);
+    }
+    for (auto &task : tasks)
+        others.erase(task.first->instantiationName());
+    for (auto &task : others)
+        tasks.emplace_back(task.second, "no activity");
+
+    std::unordered_map<const PortBase *, std::pair<std::size_t, std::size_t> > port_of;
+    std::vector<std::pair<std::shared_ptr<TaskContext>, std::size_t> > owners;
+    std::unordered_set<const TaskContext *> added;
+    for (auto &task : tasks)
+    {
+        if (!task.first || !added.insert(task.first.get()).second)
+            continue;
+        Node node;
+        node.name = task.first->instantiationName();
+        node.caption = task.first->name() + ", " + task.second;
+        std::size_t id = nodes_.size();
+
+        std::function<void(const std::shared_ptr<TaskContext> &, const std::string &)> addPorts =
+            [&](const std::shared_ptr<TaskContext> &owner, const std::string &prefix)
+        {
+            std::map<std::string, std::shared_ptr<PortBase> > ports(owner->ports().begin(),
+                                                                   owner->ports().end());
+            for (auto &port : ports)
+            {
+                auto &list = port.second->isOutput() ? node.outputs : node.inputs;
+                port_of[port.second.get()] = std::make_pair(id, list.size());
+                list.push_back(Port());
+                list.back().label = portLabel(prefix, *port.second);
+            }
+            owners.emplace_back(owner, id);
+            for (auto &peer : owner->peers())
+            {
+                node.peers.push_back(prefix + peer->instantiationName() + " (" + peer->name() + ")");
+                addPorts(peer, prefix + peer->instantiationName() + ".");
+            }
+        };
+        addPorts(task.first, "");
+        nodes_.push_back(std::move(node));
+    }
+
+    for (auto &owner : owners)
+    {
+        for (auto &port : owner.first->ports())
+        {
+            if (port.second->isOutput())
+                continue;
+            auto dest = port_of.find(port.second.get());
+            for (auto &conn : port.second->connections())
+            {
+                auto src = port_of.find(conn->output().get());
+                if (src == port_of.end() || dest == port_of.end())
+                    continue;
+                Edge edge;
+                edge.key = connectionKey(conn->output()->task()->instantiationName(),
+                                         conn->output()->name(),
+                                         owner.first->instantiationName(), port.second->name());
+                edge.src = src->second.first;
+                edge.src_port = src->second.second;
+                edge.dest = dest->second.first;
+                edge.dest_port = dest->second.second;
+                edge.event = port.second->isEvent();
+                edges_.push_back(edge);
+            }
+        }
+    }
+
+    for (auto &node : nodes_)
+    {
+        double inputs_width = 0, outputs_width = 0;
+        for (std::size_t i = 0; i < node.inputs.size(); ++i)
+        {
+            node.inputs[i].y = TITLE_HEIGHT + (i + 0.5) * ROW_HEIGHT;
+            inputs_width = std::max(inputs_width, textWidth(node.inputs[i].label));
+        }
+        for (std::size_t i = 0; i < node.outputs.size(); ++i)
+        {
+            node.outputs[i].y = TITLE_HEIGHT + (i + 0.5) * ROW_HEIGHT;
+            outputs_width = std::max(outputs_width, textWidth(node.outputs[i].label));
+        }
+        std::size_t rows = std::max(node.inputs.size(), node.outputs.size()) + node.peers.size();
+        node.height = TITLE_HEIGHT + rows * ROW_HEIGHT + PADDING / 2;
+        node.width = std::max(MIN_WIDTH, inputs_width + outputs_width + 3 * PADDING);
+        node.width = std::max(node.width, textWidth(node.name) + textWidth("100%") + 3 * PADDING);
+        node.width = std::max(node.width, textWidth(node.caption) * 0.85 + 2 * PADDING);
+        for (auto &peer : node.peers)
+            node.width = std::max(node.width, textWidth(peer) + 2 * PADDING);
+    }
+
+    assignLayers();
+    orderLayers();
+    placeNodes();
+}
+
+/* Longest path layering of the graph without the connections closing a cycle */
+void GraphSvg::assignLayers()
+{
+    std::size_t n = nodes_.size();
+    std::vector<std::vector<std::size_t> > next(n);
+    for (auto &edge : edges_)
+    {
+        auto &list = next[edge.src];
+        if (edge.src != edge.dest && std::find(list.begin(), list.end(), edge.dest) == list.end())
+            list.push_back(edge.dest);
+    }
+
+    enum { NEW, OPEN, CLOSED };
+    std::vector<int> state(n, NEW);
+    std::vector<std::vector<std::size_t> > dag(n);
+    std::function<void(std::size_t)> visit = [&](std::size_t u)
+    {
+        state[u] = OPEN;
+        for (std::size_t v : next[u])
+        {
+            if (state[v] == OPEN)
+                continue;  // back to a task on the current path
+            dag[u].push_back(v);
+            if (state[v] == NEW)
+                visit(v);
+        }
+        state[u] = CLOSED;
+    };
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (state[i] == NEW)
+            visit(i);
+    }
+
+    std::vector<int> indegree(n, 0);
+    for (auto &list : dag)
+    {
+        for (std::size_t v : list)
+            ++indegree[v];
+    }
+    std::deque<std::size_t> ready;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        nodes_[i].layer = 0;
+        if (indegree[i] == 0)
+            ready.push_back(i);
+    }
+    while (!ready.empty())
+    {
+        std::size_t u = ready.front();
+        ready.pop_front();
+        for (std::size_t v : dag[u])
+        {
+            nodes_[v].layer = std::max(nodes_[v].layer, nodes_[u].layer + 1);
+            if (--indegree[v] == 0)
+                ready.push_back(v);
+        }
+    }
+}
+
+/* Barycenter heuristic: sweeping down and up, the tasks of a column are sorted by the mean
+ * position of the tasks they are connected to in the previous column */
+void GraphSvg::orderLayers()
+{
+    int layers = 0;
+    for (auto &node : nodes_)
+        layers = std::max(layers, node.layer + 1);
+    std::vector<std::vector<std::size_t> > columns(layers);
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+    {
+        auto &column = columns[nodes_[i].layer];
+        nodes_[i].order = column.size();
+        column.push_back(i);
+    }
+
+    for (int sweep = 0; sweep < ORDER_SWEEPS; ++sweep)
+    {
+        bool down = sweep % 2 == 0;
+        for (int i = 1; i < layers; ++i)
+        {
+            int layer = down ? i : layers - 1 - i;
+            int previous = down ? layer - 1 : layer + 1;
+            std::unordered_map<std::size_t, std::pair<double, int> > sums;
+            for (auto &edge : edges_)
+            {
+                std::size_t here = down ? edge.dest : edge.src;
+                std::size_t there = down ? edge.src : edge.dest;
+                if (nodes_[here].layer == layer && nodes_[there].layer == previous)
+                {
+                    sums[here].first += nodes_[there].order;
+                    ++sums[here].second;
+                }
+            }
+            auto &column = columns[layer];
+            std::vector<double> keys(nodes_.size());
+            for (std::size_t id : column)
+            {
+                auto sum = sums.find(id);
+                keys[id] = sum != sums.end() ? sum->second.first / sum->second.second
+                                             : nodes_[id].order;
+            }
+            std::stable_sort(column.begin(), column.end(),
+                             [&](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+            for (std::size_t j = 0; j < column.size(); ++j)
+                nodes_[column[j]].order = j;
+        }
+    }
+}
+
+void GraphSvg::placeNodes()
+{
+    int layers = 0;
+    for (auto &node : nodes_)
+        layers = std::max(layers, node.layer + 1);
+    std::vector<std::vector<std::size_t> > columns(layers);
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+        columns[nodes_[i].layer].push_back(i);
+
+    std::vector<double> column_width(layers, 0), column_height(layers, 0);
+    double max_height = 0;
+    for (int l = 0; l < layers; ++l)
+    {
+        auto &column = columns[l];
+        std::sort(column.begin(), column.end(),
+                  [&](std::size_t a, std::size_t b) { return nodes_[a].order < nodes_[b].order; });
+        for (std::size_t id : column)
+        {
+            column_width[l] = std::max(column_width[l], nodes_[id].width);
+            column_height[l] += nodes_[id].height + NODE_GAP;
+        }
+        column_height[l] -= NODE_GAP;
+        max_height = std::max(max_height, column_height[l]);
+    }
+
+    double x = MARGIN;
+    for (int l = 0; l < layers; ++l)
+    {
+        double y = MARGIN + (max_height - column_height[l]) / 2;
+        for (std::size_t id : columns[l])
+        {
+            nodes_[id].x = x;
+            nodes_[id].y = y;
+            y += nodes_[id].height + NODE_GAP;
+        }
+        x += column_width[l] + LAYER_GAP;
+    }
+    width_ = layers > 0 ? x - LAYER_GAP + MARGIN : 2 * MARGIN;
+    height_ = max_height + 2 * MARGIN;
+}
+
+std::string GraphSvg::render(const GraphOverlay *overlay) const
+{
+    std::stringstream out;
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width_ << "\" height=\""
+        << height_ << "\" viewBox=\"0 0 " << width_ << " " << height_
+        << "\" font-family=\"sans-serif\" font-size=\"12\">\n"
+        << "<defs><marker id=\"arrow\" markerWidth=\"10\" markerHeight=\"8\" refX=\"9\" refY=\"4\""
+        << " orient=\"auto\"><path d=\"M0,0 L10,4 L0,8 z\" fill=\"#555\"/></marker></defs>\n"
+        << "<g id=\"graph0\" class=\"graph\">\n";
+
+    for (auto &edge : edges_)
+    {
+        auto &src = nodes_[edge.src];
+        auto &dest = nodes_[edge.dest];
+        double sx = src.x + src.width, sy = src.y + src.outputs[edge.src_port].y;
+        double dx = dest.x, dy = dest.y + dest.inputs[edge.dest_port].y;
+        /* Connections going back to a previous column loop around the boxes */
+        double d = dx > sx ? (dx - sx) / 2 : LAYER_GAP;
+        double mx = (sx + 3 * (sx + d) + 3 * (dx - d) + dx) / 8;
+        double my = (sy + dy) / 2;
+
+        std::string rate;
+        double stroke = 1.2;
+        if (overlay)
+        {
+            auto value = overlay->connection_rate.find(edge.key);
+            if (value != overlay->connection_rate.end())
+            {
+                rate = rateText(value->second);
+                stroke += std::min(4.0, std::log10(1 + value->second));
+            }
+        }
+        out << "<g class=\"connection\" id=\"conn:" << escape(edge.key) << "\">"
+            << "<path d=\"M" << sx << "," << sy << " C" << sx + d << "," << sy << " "
+            << dx - d << "," << dy << " " << dx << "," << dy
+            << "\" fill=\"none\" stroke=\"#555\" stroke-width=\"" << stroke << "\""
+            << (edge.event ? " stroke-dasharray=\"5,3\"" : "") << " marker-end=\"url(#arrow)\"/>"
+            << "<text class=\"overlay\" x=\"" << mx << "\" y=\"" << my - 4
+            << "\" text-anchor=\"middle\" font-size=\"10\" fill=\"#333\">" << rate << "</text></g>\n";
+    }
+
+    for (auto &node : nodes_)
+    {
+        std::string load;
+        std::string fill = "#ffffff";
+        if (overlay)
+        {
+            auto value = overlay->task_load.find(node.name);
+            if (value != overlay->task_load.end())
+            {
+                load = loadText(value->second);
+                fill = loadColor(value->second);
+            }
+        }
+        out << "<g class=\"task\" id=\"task:" << escape(node.name) << "\" transform=\"translate("
+            << node.x << "," << node.y << ")\">"
+            << "<rect width=\"" << node.width << "\" height=\"" << node.height
+            << "\" rx=\"6\" fill=\"" << fill << "\" stroke=\"#b22\"/>"
+            << "<text x=\"" << PADDING << "\" y=\"16\" font-weight=\"bold\">"
+            << escape(node.name) << "</text>"
+            << "<text class=\"overlay\" x=\"" << node.width - PADDING
+            << "\" y=\"16\" text-anchor=\"end\">" << load << "</text>"
+            << "<text x=\"" << PADDING << "\" y=\"30\" font-size=\"10\" fill=\"#555\">"
+            << escape(node.caption) << "</text>"
+            << "<line x1=\"0\" y1=\"" << TITLE_HEIGHT - 2 << "\" x2=\"" << node.width << "\" y2=\""
+            << TITLE_HEIGHT - 2 << "\" stroke=\"#ddd\"/>";
+        for (auto &port : node.inputs)
+        {
+            out << "<circle cx=\"0\" cy=\"" << port.y << "\" r=\"4\" fill=\"darkorchid\"/>"
+                << "<text x=\"" << PADDING << "\" y=\"" << port.y + 4 << "\">"
+                << escape(port.label) << "</text>";
+        }
+        for (auto &port : node.outputs)
+        {
+            out << "<circle cx=\"" << node.width << "\" cy=\"" << port.y
+                << "\" r=\"4\" fill=\"darkgreen\"/>"
+                << "<text x=\"" << node.width - PADDING << "\" y=\"" << port.y + 4
+                << "\" text-anchor=\"end\">" << escape(port.label) << "</text>";
+        }
+        double y = TITLE_HEIGHT + std::max(node.inputs.size(), node.outputs.size()) * ROW_HEIGHT;
+        for (auto &peer : node.peers)
+        {
+            out << "<text x=\"" << PADDING << "\" y=\"" << y + ROW_HEIGHT / 2 + 4
+                << "\" fill=\"#c60\">" << escape(peer) << "</text>";
+            y += ROW_HEIGHT;
+        }
+        out << "</g>\n";
+    }
+    out << "</g>\n</svg>\n";
+    return out.str();
+}
+
+}  // end of namespace coco
@@ -1,4 +1,5 @@
 #include "coco/util/logging.h"
+#include "coco/util/binary_log.h"
 #include <termcolor/termcolor.hpp>
 
 /*
@@ -23,52 +24,204 @@ namespace coco
 {
 	namespace util
 	{
-		static LoggerManager *xlog;
 		static std::mutex singletonmutex_;
 		        
     void LogMessage::addPrefix()
     {
-        switch (type_)
+        writePrefix(buffer_, type_, level_, name_, time(0));
+        prefixed_ = true;
+    }
+
+    void LogMessage::writePrefix(std::ostream &out, Type type, int level,
+                                 const std::string &name, time_t time)
+    {
+        switch (type)
         {
             case Type::LOG:
-                if (name_.empty())
-                    buffer_ <<   "[LOG " << level_ << "] "  ;
+                if (name.empty())
+                    out <<   "[LOG " << level << "] "  ;
                 else
-                    buffer_ <<  "[LOG " << level_ << ", " << name_ << "] "  ;
+                    out <<  "[LOG " << level << ", " << name << "] "  ;
                 break;
             case Type::DEBUG:
-                if (name_.empty())
-                    buffer_ <<  "[DEBUG] " ;
+                if (name.empty())
+                    out <<  "[DEBUG] " ;
                 else
-                    buffer_ <<  "[DEBUG " << name_ << "] " ;
+                    out <<  "[DEBUG " << name << "] " ;
                 break;
             case Type::ERR:
-                if (name_.empty())
-                    buffer_ <<  "[ERR]   " ;
+                if (name.empty())
+                    out <<  "[ERR]   " ;
                 else
-                    buffer_ <<  "[ERR " << name_ << "] " ;
+                    out <<  "[ERR " << name << "] " ;
                 break;
             case Type::FATAL:
-                if (name_.empty())
-                    buffer_ <<  "[FATAL] " ;
+                if (name.empty())
+                    out <<  "[FATAL] " ;
                 else
-                    buffer_ <<  "[FATAL " << name_ << "] " ;
+                    out <<  "[FATAL " << name << "] " ;
                 break;
             case Type::NO_PRINT:
                 return;
         }
-        buffer_ << getTime() << ": ";
-    }		        
+        out << getTime(time) << ": ";
+    }
+
 		LoggerManager* LoggerManager::instance()
 		{
-	        std::lock_guard<std::mutex> g(singletonmutex_);
-			if(!xlog)
-			{
-				xlog = new LoggerManager();
-			}
+			/* Never destroyed, messages can be logged until the very end of the process */
+			static LoggerManager *xlog = new LoggerManager();
 		    return xlog;
 		}
 
+	    void LoggerManager::enableAsync(std::size_t ring_size)
+	    {
+	        std::lock_guard<std::mutex> guard(async_mutex_);
+	        if (async_)
+	            return;
+	        /* Rings already created keep their size, only new threads get the new one */
+	        ring_size_ = ring_size;
+	        stop_writer_ = false;
+	        writer_ = std::thread(&LoggerManager::asyncWriter, this);
+	        async_ = true;
+	        static bool at_exit_registered = false;
+	        if (!at_exit_registered)
+	        {
+	            at_exit_registered = true;
+	            std::atexit([]() { LoggerManager::instance()->disableAsync(); });
+	        }
+	    }
+
+	    void LoggerManager::disableAsync()
+	    {
+	        std::lock_guard<std::mutex> guard(async_mutex_);
+	        if (!async_.exchange(false))
+	            return;
+	        /* From now on enqueue() refuses new messages, wait for the ones being pushed */
+	        while (producers_.load() != 0)
+	            std::this_thread::yield();
+	        stop_writer_ = true;
+	        if (writer_.joinable())
+	        {
+	            if (writer_.get_id() != std::this_thread::get_id())
+	                writer_.join();
+	            else
+	                writer_.detach();
+	        }
+	        /* The writer may have stopped before the last messages were pushed */
+	        drainAsync();
+	    }
+
+	    bool LoggerManager::enqueue(Type type, int level, uint8_t flags,
+	                                const char *name, std::size_t name_size,
+	                                const char *text, std::size_t text_size)
+	    {
+	        /* Pairs with the exchange in disableAsync(): either disableAsync() sees this
+	         * producer and waits for it, or this producer sees async_ false */
+	        producers_.fetch_add(1);
+	        if (!async_.load())
+	        {
+	            producers_.fetch_sub(1);
+	            return false;
+	        }
+	        static thread_local LogRing *ring = nullptr;
+	        if (!ring)
+	        {
+	            std::lock_guard<std::mutex> g(rings_mutex_);
+	            rings_.emplace_back(new LogRing(ring_size_));
+	            ring = rings_.back().get();
+	        }
+	        LogRing::Header header;
+	        header.time = std::chrono::duration_cast<std::chrono::microseconds>(
+	                std::chrono::system_clock::now().time_since_epoch()).count();
+	        header.level = level;
+	        header.name_size = static_cast<uint32_t>(name_size);
+	        header.text_size = static_cast<uint32_t>(text_size);
+	        header.type = type;
+	        header.flags = flags;
+	        if (!ring->push(header, name, text))
+	            dropped_.fetch_add(1, std::memory_order_relaxed);
+	        producers_.fetch_sub(1, std::memory_order_release);
+	        return true;
+	    }
+
+	    void LoggerManager::asyncWriter()
+	    {
+	        while (!stop_writer_)
+	        {
+	            if (drainAsync() == 0)
+	                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	        }
+	        drainAsync();
+	    }
+
+	    void LoggerManager::flushAsync()
+	    {
+	        if (isAsync())
+	            drainAsync();
+	    }
+
+	    std::size_t LoggerManager::drainAsync()
+	    {
+	        std::lock_guard<std::mutex> drain_guard(drain_mutex_);
+	        struct Record
+	        {
+	            LogRing::Header header;
+	            std::string name;
+	            std::string text;
+	        };
+	        std::vector<Record> records;
+	        {
+	            std::lock_guard<std::mutex> g(rings_mutex_);
+	            Record record;
+	            for (auto &ring : rings_)
+	            {
+	                while (ring->pop(record.header, record.name, record.text))
+	                    records.push_back(record);
+	            }
+	        }
+	        /* Each ring is ordered, merge the threads by time */
+	        std::stable_sort(records.begin(), records.end(),
+	                         [](const Record &a, const Record &b) { return a.header.time < b.header.time; });
+
+	        for (auto &record : records)
+	        {
+	            if (record.header.flags & LogRing::BINARY)
+	            {
+	                BinaryLog::instance().writeQueued(static_cast<uint32_t>(record.header.level),
+	                                                  record.header.time, record.text);
+	                continue;
+	            }
+	            std::ostringstream line;
+	            if (!(record.header.flags & LogRing::RAW))
+	                LogMessage::writePrefix(line, record.header.type, record.header.level, record.name,
+	                                        static_cast<time_t>(record.header.time / 1000000));
+	            line << record.text;
+	            if (record.header.flags & LogRing::TO_WEB)
+	            {
+	                WebServer::addLogString(line.str() + "\n");
+	                continue;
+	            }
+	            if (use_stdout_)
+	                printToStdout(record.header.type,
+	                              (record.header.type == Type::LOG || record.header.type == Type::DEBUG) ? std::cout : std::cerr,
+	                              line.str());
+	            printToFile(line.str());
+	        }
+
+	        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+	        if (dropped != reported_dropped_)
+	        {
+	            std::ostringstream line;
+	            LogMessage::writePrefix(line, Type::ERR, 0, "Logger", time(0));
+	            line << dropped - reported_dropped_ << " messages dropped, the log ring of a thread was full";
+	            reported_dropped_ = dropped;
+	            printToStdout(Type::ERR, std::cerr, line.str());
+	            printToFile(line.str());
+	        }
+	        return records.size();
+	    }
+
 	    void LoggerManager::printToFile(const std::string &buffer)
 	    {
 	        if (file_stream_.is_open())
@@ -214,6 +367,7 @@ namespace coco
 	                }
 	            }
 	        }
+	        updateMasks();
 	    }
 
 	    void LoggerManager::init()
@@ -221,10 +375,24 @@ namespace coco
 	        levels_.insert(0);
 	        // types_.insert(ERR);
 	        types_.insert(Type::LOG);
+	        updateMasks();
 	        use_stdout_ = true;
 	        initialized_ = true;
 	        return;
-	    }	    
+	    }
+
+	    void LoggerManager::updateMasks()
+	    {
+	        uint64_t level_mask = 0;
+	        for (auto l : levels_)
+	            if (l >= 0 && l < 64)
+	                level_mask |= uint64_t(1) << l;
+	        uint32_t type_mask = 0;
+	        for (auto t : types_)
+	            type_mask |= 1u << static_cast<unsigned>(t);
+	        level_mask_.store(level_mask, std::memory_order_relaxed);
+	        type_mask_.store(type_mask, std::memory_order_relaxed);
+	    }
 
 	}
 }
\ No newline at end of file
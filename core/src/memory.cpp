@@ -0,0 +1,98 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include "coco/util/memory.hpp"
+
+namespace coco
+{
+namespace util
+{
+
+MemoryPool::~MemoryPool()
+{
+    trim();
+}
+
+void * MemoryPool::allocate(std::size_t bytes)
+{
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    unsigned c = sizeClass(bytes);
+    if (c > MAX_CLASS)
+    {
+        bytes_in_use_.fetch_add(bytes, std::memory_order_relaxed);
+        return ::operator new(bytes);
+    }
+    std::size_t size = std::size_t(1) << c;
+    bytes_in_use_.fetch_add(size, std::memory_order_relaxed);
+
+    void *ptr;
+    if (free_[c - MIN_CLASS].pop(ptr))
+    {
+        cached_bytes_.fetch_sub(size, std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+    return ::operator new(size);
+}
+
+void MemoryPool::deallocate(void *ptr, std::size_t bytes)
+{
+    if (!ptr)
+        return;
+    unsigned c = sizeClass(bytes);
+    if (c > MAX_CLASS)
+    {
+        bytes_in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+        ::operator delete(ptr);
+        return;
+    }
+    std::size_t size = std::size_t(1) << c;
+    bytes_in_use_.fetch_sub(size, std::memory_order_relaxed);
+
+    std::size_t cached = cached_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+    if (cached > memory_cap_ || !free_[c - MIN_CLASS].bounded_push(ptr))
+    {
+        cached_bytes_.fetch_sub(size, std::memory_order_relaxed);
+        ::operator delete(ptr);
+    }
+}
+
+void MemoryPool::trim()
+{
+    for (unsigned index = 0; index < CLASSES; ++index)
+    {
+        void *ptr;
+        while (free_[index].pop(ptr))
+        {
+            cached_bytes_.fetch_sub(std::size_t(1) << (index + MIN_CLASS), std::memory_order_relaxed);
+            ::operator delete(ptr);
+        }
+    }
+}
+
+MemoryPoolStatistics MemoryPool::statistics() const
+{
+    MemoryPoolStatistics stats;
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+    stats.cached_bytes = cached_bytes_.load(std::memory_order_relaxed);
+    stats.memory_cap = memory_cap_;
+    return stats;
+}
+
+const std::shared_ptr<MemoryPool> & MemoryPool::defaultPool()
+{
+    static std::shared_ptr<MemoryPool> pool = std::make_shared<MemoryPool>();
+    return pool;
+}
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,74 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <sstream>
+
+#include "coco/util/memory_account.h"
+#include "coco/util/timing.h"
+
+namespace coco
+{
+namespace util
+{
+
+namespace
+{
+thread_local MemoryAccount *current_account = nullptr;
+}  // end of anonymous namespace
+
+std::string MemoryStatistics::toString() const
+{
+    std::stringstream ss;
+    ss << "live: " << live_bytes / 1024.0 << " KiB "
+       << "peak: " << peak_bytes / 1024.0 << " KiB "
+       << "allocations: " << allocations << " "
+       << "rate: " << allocation_rate / 1024.0 << " KiB/s";
+    return ss.str();
+}
+
+MemoryAccount::MemoryAccount()
+    : start_time_(util::time())
+{}
+
+void MemoryAccount::reset()
+{
+    allocations_.store(0, std::memory_order_relaxed);
+    allocated_bytes_.store(0, std::memory_order_relaxed);
+    peak_.store(live_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    start_time_.store(util::time(), std::memory_order_relaxed);
+}
+
+MemoryStatistics MemoryAccount::statistics() const
+{
+    MemoryStatistics stats;
+    stats.live_bytes = live_.load(std::memory_order_relaxed);
+    stats.peak_bytes = peak_.load(std::memory_order_relaxed);
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.allocated_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+    int long elapsed = util::time() - start_time_.load(std::memory_order_relaxed);
+    if (elapsed > 0)
+        stats.allocation_rate = stats.allocated_bytes * 1e6 / elapsed;
+    return stats;
+}
+
+MemoryAccount * MemoryAccount::current()
+{
+    return current_account;
+}
+
+MemoryAccount * MemoryAccount::setCurrent(MemoryAccount *account)
+{
+    MemoryAccount *previous = current_account;
+    current_account = account;
+    return previous;
+}
+
+}  // end of namespace util
+}  // end of namespace coco
@@ -0,0 +1,161 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "coco/util/perf_counters.h"
+#include "coco/util/logging.h"
+
+namespace coco
+{
+namespace util
+{
+
+namespace
+{
+thread_local PerfCounters *current_counters = nullptr;
+
+#ifdef __linux__
+int openCounter(uint32_t type, uint64_t config, int group_fd)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1 ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM))
+    {
+        /* Restricted perf_event_paranoid, count only user space */
+        attr.exclude_kernel = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+    return fd;
+}
+#endif
+}  // end of anonymous namespace
+
+std::string PerfStatistics::toString() const
+{
+    std::stringstream ss;
+    if (has(PerfCounters::CYCLES))
+        ss << "cycles: " << cycles << " ";
+    if (has(PerfCounters::INSTRUCTIONS))
+        ss << "instructions: " << instructions << " ";
+    if (has(PerfCounters::CYCLES) && has(PerfCounters::INSTRUCTIONS))
+        ss << "ipc: " << ipc() << " ";
+    if (has(PerfCounters::LLC_MISSES))
+        ss << "llc misses: " << llc_misses << " ";
+    if (has(PerfCounters::CONTEXT_SWITCHES))
+        ss << "context switches: " << context_switches << " ";
+    ss << "(per step over " << steps << " steps)";
+    return ss.str();
+}
+
+PerfCounters::PerfCounters()
+{
+    for (unsigned i = 0; i < COUNT; ++i)
+    {
+        fds_[i] = -1;
+        slot_[i] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open()
+{
+#ifdef __linux__
+    static const uint32_t types[COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                          PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+    static const uint64_t configs[COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+    close();
+    for (unsigned i = 0; i < COUNT; ++i)
+    {
+        fds_[i] = openCounter(types[i], configs[i], leader_);
+        if (fds_[i] < 0)
+            continue;
+        if (leader_ < 0)
+            leader_ = fds_[i];
+        slot_[i] = opened_++;
+        available_ |= 1u << i;
+    }
+    if (leader_ < 0)
+    {
+        COCO_ERR() << "Failed to open perf counters: " << std::strerror(errno);
+        return false;
+    }
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    current_counters = this;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfCounters::close()
+{
+#ifdef __linux__
+    for (unsigned i = 0; i < COUNT; ++i)
+    {
+        if (fds_[i] >= 0)
+            ::close(fds_[i]);
+        fds_[i] = -1;
+        slot_[i] = -1;
+    }
+#endif
+    leader_ = -1;
+    opened_ = 0;
+    available_ = 0;
+    if (current_counters == this)
+        current_counters = nullptr;
+}
+
+bool PerfCounters::read(Sample &sample) const
+{
+#ifdef __linux__
+    if (leader_ < 0)
+        return false;
+    uint64_t buffer[1 + COUNT];
+    ssize_t size = ::read(leader_, buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>(sizeof(uint64_t) * (1 + opened_)))
+        return false;
+    for (unsigned i = 0; i < COUNT; ++i)
+        sample.value[i] = slot_[i] >= 0 ? buffer[1 + slot_[i]] : 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+PerfCounters * PerfCounters::current()
+{
+    return current_counters;
+}
+
+}  // end of namespace util
+}  // end of namespace coco
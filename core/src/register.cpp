@@ -8,6 +8,8 @@
  * file 'LICENSE.txt', which is part of this source code package.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <vector>
 #include "coco/register.h"
@@ -65,10 +67,16 @@ TypeSpec::TypeSpec(const char * name, const std::type_info & type,
 
 ComponentRegistry & ComponentRegistry::get()
 {
-    if (!singleton)
-    {
-        singleton = new ComponentRegistry();
-    }
+    /* Libraries can be opened by several startup threads, whose static registrations
+     * reach this at the same time. The pointer may already have been set by the
+     * registry of the executable through getComponentRegistry().
+     */
+    static std::once_flag created;
+    std::call_once(created, []()
+        {
+            if (!singleton)
+                singleton = new ComponentRegistry();
+        });
     return *singleton;
 }
 
@@ -81,19 +89,27 @@ std::shared_ptr<TaskContext> ComponentRegistry::create(const std::string &name,
 std::shared_ptr<TaskContext> ComponentRegistry::createImpl(const std::string &name,
                                                            const std::string &instantiation_name)
 {
-    auto it = specs_.find(name);
-    if (it == specs_.end())
+    ComponentSpec *spec;
     {
-        COCO_DEBUG("ComponentRegistry::createImpl") << "not found " << name << " as " << instantiation_name ;
-        return 0;
+        std::unique_lock<std::recursive_mutex> mlock(mutex_);
+        auto it = specs_.find(name);
+        if (it == specs_.end())
+        {
+            COCO_DEBUG("ComponentRegistry::createImpl") << "not found " << name << " as " << instantiation_name ;
+            return 0;
+        }
+        spec = it->second;
     }
-    tasks_[instantiation_name] = it->second->fx_();
+    /* The component constructor runs unlocked, it may use the registry */
+    std::shared_ptr<TaskContext> task = spec->fx_();
 
-    if (!std::dynamic_pointer_cast<PeerTask>(tasks_[instantiation_name]))
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
+    tasks_[instantiation_name] = task;
+    if (!std::dynamic_pointer_cast<PeerTask>(task))
     {
         num_tasks_ += 1;
     }
-    return tasks_[instantiation_name];
+    return task;
 }
 
 // static
@@ -104,6 +120,7 @@ void ComponentRegistry::addSpec(ComponentSpec * s)
 void ComponentRegistry::addSpecImpl(ComponentSpec * s)
 {
     COCO_DEBUG("Registry") << this << " adding spec " << s->name_ << " " << s;
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     specs_[s->name_] = s;
 }
 
@@ -116,6 +133,7 @@ void ComponentRegistry::alias(const std::string &new_name,
 void ComponentRegistry::aliasImpl(const std::string &new_name,
                                   const std::string &old_name)
 {
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     auto it = specs_.find(old_name);
     if (it != specs_.end())
         specs_[new_name] = it->second;
@@ -150,6 +168,8 @@ bool ComponentRegistry::addLibraryImpl(const std::string &library_name)
         COCO_DEBUG("Registry") << "got registry " << library_name ;        
     }
 
+    /* dlopen() runs unlocked, the static registrations of the library lock the registry */
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     ComponentRegistry ** other_registry = get_registry_fx();
     if (!*other_registry)
     {
@@ -206,8 +226,11 @@ bool ComponentRegistry::addLibraryImpl(const std::string &lib, const std::string
     {
         library_name = lib;
     }
-    if (libs_.find(library_name) != libs_.end())
-        return true;  // already loaded
+    {
+        std::unique_lock<std::recursive_mutex> mlock(mutex_);
+        if (libs_.find(library_name) != libs_.end())
+            return true;  // already loaded
+    }
 
     return addLibraryImpl(library_name);
 }
@@ -230,6 +253,7 @@ void ComponentRegistry::addType(TypeSpec * s)
 void ComponentRegistry::addTypeImpl(TypeSpec * s)
 {
     COCO_DEBUG("Registry") << this << " adding type spec " << s->name_ << " " << s;
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     typespecs_[s->type_.name()] = s;
 }
 TypeSpec *ComponentRegistry::type(std::string name)
@@ -244,6 +268,7 @@ TypeSpec *ComponentRegistry::type(const std::type_info & ti)
 
 TypeSpec *ComponentRegistry::typeImpl(std::string name)
 {
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     auto t = typespecs_.find(name);
     if (t == typespecs_.end())
         return nullptr;
@@ -253,6 +278,7 @@ TypeSpec *ComponentRegistry::typeImpl(std::string name)
 
 TypeSpec *ComponentRegistry::typeImpl(const std::type_info & impl)
 {
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     auto t = typespecs2_.find(reinterpret_cast<std::uintptr_t>(&impl));
     if (t == typespecs2_.end())
         return nullptr;
@@ -267,7 +293,7 @@ std::list<std::string>  ComponentRegistry::taskNames()
 
 std::list<std::string> ComponentRegistry::taskNamesImpl() const
 {
-    // TODO lock
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     std::list<std::string> r;
     /*
     coco::util::keys_iteration<decltype(tasks_),std::string> ki(tasks_);
@@ -284,6 +310,7 @@ std::shared_ptr<TaskContext> ComponentRegistry::task(std::string name)
 }
 std::shared_ptr<TaskContext> ComponentRegistry::taskImpl(std::string name)
 {
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     auto t = tasks_.find(name);
     if (t == tasks_.end())
         return nullptr;
@@ -310,6 +337,26 @@ void ComponentRegistry::enableProfilingImpl(bool enable)
     profiling_enabled_ = enable;
 }
 
+bool ComponentRegistry::perfCountersEnabled()
+{
+    return get().perfCountersEnabledImpl();
+}
+
+bool ComponentRegistry::perfCountersEnabledImpl()
+{
+    return perf_counters_enabled_;
+}
+
+void ComponentRegistry::enablePerfCounters(bool enable)
+{
+    get().enablePerfCountersImpl(enable);
+}
+
+void ComponentRegistry::enablePerfCountersImpl(bool enable)
+{
+    perf_counters_enabled_ = enable;
+}
+
 int ComponentRegistry::numTasks()
 {
     return get().numTasksImpl();
@@ -319,13 +366,38 @@ int ComponentRegistry::numTasksImpl() const
     return get().num_tasks_;
 }
 
+void ComponentRegistry::scheduleConfig(const std::shared_ptr<ExecutionEngine> &engine)
+{
+    get().scheduleConfigImpl(engine);
+}
+void ComponentRegistry::scheduleConfigImpl(const std::shared_ptr<ExecutionEngine> &engine)
+{
+    if (engine->config_scheduled_.exchange(true))
+        return;
+    std::unique_lock<std::mutex> mlock(config_mutex_);
+    num_config_scheduled_ = std::max(num_config_scheduled_.load(), 0) + 1;
+}
+
+int ComponentRegistry::numConfigScheduled()
+{
+    return get().numConfigScheduledImpl();
+}
+int ComponentRegistry::numConfigScheduledImpl() const
+{
+    int scheduled = num_config_scheduled_;
+    return scheduled >= 0 ? scheduled : num_tasks_.load();
+}
+
 int ComponentRegistry::increaseConfigCompleted()
 {
     return get().increaseConfigCompletedImpl();
 }
 int ComponentRegistry::increaseConfigCompletedImpl()
 {
-    return ++(get().tasks_config_ended_);
+    std::unique_lock<std::mutex> mlock(config_mutex_);
+    int completed = ++tasks_config_ended_;
+    config_cond_.notify_all();
+    return completed;
 }
 
 int ComponentRegistry::numConfigCompleted()
@@ -337,6 +409,72 @@ int ComponentRegistry::numConfigCompletedImpl() const
     return get().tasks_config_ended_;
 }
 
+void ComponentRegistry::waitConfigCompleted(const std::atomic<bool> &abort)
+{
+    get().waitConfigCompletedImpl(abort);
+}
+void ComponentRegistry::waitConfigCompletedImpl(const std::atomic<bool> &abort)
+{
+    const auto report_period = std::chrono::seconds(10);
+    auto completed = [this, &abort]()
+        {
+            return abort || tasks_config_ended_ >= numConfigScheduledImpl();
+        };
+    std::unique_lock<std::mutex> mlock(config_mutex_);
+    while (!config_cond_.wait_for(mlock, report_period, completed))
+    {
+        /* A single waiting activity reports per period, a task stuck in
+           onConfig() or never started otherwise blocks silently */
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t reported = config_reported_;
+        if (now - reported < std::chrono::duration_cast<std::chrono::milliseconds>(report_period).count() ||
+            !config_reported_.compare_exchange_strong(reported, now))
+            continue;
+        int completed_tasks = tasks_config_ended_;
+        int scheduled_tasks = numConfigScheduledImpl();
+        mlock.unlock();
+        std::string pending;
+        for (auto &task : tasks())
+        {
+            if (isPeer(task.second))
+                continue;
+            auto engine = task.second->engine();
+            if (!engine || !engine->configCompleted())
+                pending += " " + task.first;
+        }
+        COCO_ERR() << "Still waiting for " << scheduled_tasks - completed_tasks << " of "
+                   << scheduled_tasks << " tasks to complete onConfig(), not configured:"
+                   << pending;
+        mlock.lock();
+    }
+}
+
+void ComponentRegistry::waitConfigReady(const std::atomic<bool> &abort,
+                                        const std::function<bool()> &ready)
+{
+    get().waitConfigReadyImpl(abort, ready);
+}
+void ComponentRegistry::waitConfigReadyImpl(const std::atomic<bool> &abort,
+                                            const std::function<bool()> &ready)
+{
+    std::unique_lock<std::mutex> mlock(config_mutex_);
+    config_cond_.wait(mlock, [&abort, &ready]()
+        {
+            return abort || ready();
+        });
+}
+
+void ComponentRegistry::notifyConfigWaiters()
+{
+    get().notifyConfigWaitersImpl();
+}
+void ComponentRegistry::notifyConfigWaitersImpl()
+{
+    std::unique_lock<std::mutex> mlock(config_mutex_);
+    config_cond_.notify_all();
+}
+
 void ComponentRegistry::setResourcesPath(const std::vector<std::string> & resources_path)
 {
     return get().setResourcesPathImpl(resources_path);
@@ -376,9 +514,14 @@ std::string ComponentRegistry::resourceFinderImpl(const std::string &value)
     return "";
 }
 
-const std::unordered_map<std::string, std::shared_ptr<TaskContext> >& ComponentRegistry::tasks()
+std::unordered_map<std::string, std::shared_ptr<TaskContext> > ComponentRegistry::tasks()
+{
+    return get().tasksImpl();
+}
+std::unordered_map<std::string, std::shared_ptr<TaskContext> > ComponentRegistry::tasksImpl() const
 {
-    return get().tasks_;
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
+    return tasks_;
 }
 
 void ComponentRegistry::setActivities(const std::vector<std::shared_ptr<Activity> > &activities)
@@ -387,12 +530,63 @@ void ComponentRegistry::setActivities(const std::vector<std::shared_ptr<Activity
 }
 void ComponentRegistry::setActivitiesImpl(const std::vector<std::shared_ptr<Activity> > &activities)
 {
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
     activities_ = activities;
 }
 
-const std::vector<std::shared_ptr<Activity>>& ComponentRegistry::activities()
+std::vector<std::shared_ptr<Activity>> ComponentRegistry::activities()
+{
+    return get().activitiesImpl();
+}
+std::vector<std::shared_ptr<Activity>> ComponentRegistry::activitiesImpl() const
+{
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
+    return activities_;
+}
+
+bool ComponentRegistry::removeTask(const std::string &name)
+{
+    return get().removeTaskImpl(name);
+}
+bool ComponentRegistry::removeTaskImpl(const std::string &name)
+{
+    std::unique_lock<std::recursive_mutex> mlock(mutex_);
+    auto t = tasks_.find(name);
+    if (t == tasks_.end())
+        return false;
+    if (!std::dynamic_pointer_cast<PeerTask>(t->second))
+    {
+        /* Keep the barrier balanced, a task stopped before onConfig() was never counted */
+        num_tasks_ -= 1;
+        auto engine = t->second->engine();
+        std::unique_lock<std::mutex> config_lock(config_mutex_);
+        if (engine && engine->config_counted_)
+            tasks_config_ended_ -= 1;
+        if (engine && engine->config_scheduled_)
+            num_config_scheduled_ -= 1;
+    }
+    tasks_.erase(t);
+    return true;
+}
+
+void ComponentRegistry::setGraphEditor(GraphEditor *editor)
+{
+    get().graph_editor_ = editor;
+}
+
+GraphEditor * ComponentRegistry::graphEditor()
+{
+    return get().graph_editor_;
+}
+
+void ComponentRegistry::increaseGraphVersion()
+{
+    get().graph_version_.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t ComponentRegistry::graphVersion()
 {
-    return get().activities_;
+    return get().graph_version_.load(std::memory_order_acquire);
 }
 
 }  // end of namespace coco
@@ -0,0 +1,114 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <alloca.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#include "coco/util/rt_memory.h"
+#include "coco/util/logging.h"
+
+namespace coco
+{
+namespace util
+{
+namespace rt_memory
+{
+
+bool lockProcessMemory()
+{
+    static std::once_flag once;
+    static bool locked = false;
+    std::call_once(once, []()
+    {
+#ifdef __linux__
+        /* Heap memory is never given back to the system, nor obtained with mmap */
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+
+        int flags = MCL_CURRENT;
+        struct rlimit limit;
+        if (geteuid() == 0 ||
+            (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY))
+            flags |= MCL_FUTURE;
+        else
+            COCO_LOG(1) << "Memlock limit is finite, only the current memory is locked";
+
+        locked = mlockall(flags) == 0;
+        if (!locked)
+            COCO_ERR() << "Failed to lock the process memory: " << std::strerror(errno);
+#endif
+    });
+    return locked;
+}
+
+void * map(std::size_t bytes)
+{
+#ifdef __linux__
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (bytes % HUGE_PAGE_SIZE == 0)
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED)
+    {
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            return nullptr;
+#ifdef MADV_HUGEPAGE
+        if (bytes >= HUGE_PAGE_SIZE)
+            madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    /* Locking also faults the pages in, touch them in case it is not allowed */
+    if (mlock(ptr, bytes) != 0)
+    {
+        long page = sysconf(_SC_PAGESIZE);
+        for (std::size_t i = 0; i < bytes; i += page)
+            static_cast<volatile char *>(ptr)[i] = 0;
+    }
+    return ptr;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+void unmap(void *ptr, std::size_t bytes)
+{
+    if (!ptr)
+        return;
+#ifdef __linux__
+    munmap(ptr, bytes);
+#else
+    ::operator delete(ptr);
+#endif
+}
+
+void prefaultStack(std::size_t bytes)
+{
+#ifdef __linux__
+    volatile char *buffer = static_cast<volatile char *>(alloca(bytes));
+    for (std::size_t i = 0; i < bytes; i += 4096)
+        buffer[i] = 0;
+#endif
+}
+
+}  // end of namespace rt_memory
+}  // end of namespace util
+}  // end of namespace coco
@@ -42,10 +42,6 @@ OperationBase::OperationBase(TaskContext *task,
     task->addOperation(shared_this);
 }
 
-OperationInvocation::OperationInvocation(const std::function<void(void)> & f)
-    : fx(f)
-{}
-
 // -------------------------------------------------------------------
 // Port
 // -------------------------------------------------------------------
@@ -73,6 +69,11 @@ unsigned int PortBase::queueLength(int connection) const
     return manager_->queueLenght();
 }
 
+ConnectionBufferStatistics PortBase::bufferStatistics(int connection) const
+{
+    return manager_->bufferStatistics(connection);
+}
+
 void PortBase::triggerComponent()
 {
     task_->triggerActivity(this->name_);
@@ -83,6 +84,11 @@ void PortBase::removeTriggerComponent()
     task_->removeTriggerActivity();
 }
 
+std::vector<std::shared_ptr<ConnectionBase> > PortBase::connections() const
+{
+    return manager_->connections();
+}
+
 bool PortBase::addConnection(std::shared_ptr<ConnectionBase> &connection)
 {
     if (!is_output_ && is_event_)
@@ -94,6 +100,24 @@ bool PortBase::addConnection(std::shared_ptr<ConnectionBase> &connection)
     return true;
 }
 
+bool PortBase::replaceConnection(const std::shared_ptr<ConnectionBase> &old_connection,
+                                 const std::shared_ptr<ConnectionBase> &connection)
+{
+    return manager_->replaceConnection(old_connection, connection);
+}
+
+bool PortBase::removeConnection(const std::shared_ptr<ConnectionBase> &connection)
+{
+    if (!manager_->removeConnection(connection))
+        return false;
+
+    if (!is_output_ && is_event_)
+    {
+        task_->removeEventPort();
+    }
+    return true;
+}
+
 std::shared_ptr<TaskContext> PortBase::task() const
 { return task_->sharedPtr(); }
 // -------------------------------------------------------------------
@@ -104,6 +128,13 @@ Service::Service(const std::string &name)
     : name_(name)
 {}
 
+Service::~Service()
+{
+    /* Operations never executed are dropped */
+    while (OperationInvocation *op = asked_ops_.pop())
+        releaseOperation(op);
+}
+
 bool Service::addAttribute(std::shared_ptr<AttributeBase> &attribute)
 {
     if (attributes_[attribute->name()])
@@ -166,14 +197,33 @@ bool Service::addOperation(std::shared_ptr<OperationBase> &operation)
 
 bool Service::hasPending() const
 {
-    return !asked_ops_.empty();
+    return asked_ops_.size() != 0;
+}
+
+void Service::enqueuePending(std::function<void()> fx)
+{
+    pushOperation(std::move(fx));
 }
 
 void Service::stepPending()
 {
-    auto op = asked_ops_.front();
-    asked_ops_.pop_front();
-    op.fx();
+    for (auto count = asked_ops_.size(); count > 0; --count)
+    {
+        OperationInvocation *op = asked_ops_.pop();
+        if (!op)
+            break;  // the producer has not linked it yet, run it at the next step
+        op->fx();
+        releaseOperation(op);
+    }
+}
+
+void Service::releaseOperation(OperationInvocation *op)
+{
+    op->fx.reset();
+    if (ops_pool_.owns(op))
+        ops_pool_.release(op);
+    else
+        delete op;
 }
 
 void Service::addPeer(std::shared_ptr<TaskContext> & peer)
@@ -217,6 +267,7 @@ uint32_t TaskContext::actvityId() const
 
 void TaskContext::triggerActivity(const std::string &port_name)
 {
+    triggers_.fetch_add(1, std::memory_order_relaxed);
     if (!wait_all_trigger_)
     {
         activity_->trigger();
@@ -258,37 +309,76 @@ void TaskContext::removeTriggerActivity()
     activity_->removeTrigger();
 }
 
+void TaskContext::wakeUp()
+{
+    if (activity_)
+        activity_->wakeUp();
+}
+
 util::TimeStatistics TaskContext::timeStatistics()
 {
     return engine_->timeStatistics();
 }
 
+unsigned long TaskContext::iterations()
+{
+    return engine_->iterations();
+}
+
+const util::Timer & TaskContext::timer() const
+{
+    return engine_->timer();
+}
+
+util::PerfStatistics TaskContext::perfStatistics()
+{
+    return engine_->perfStatistics();
+}
+
+util::MemoryStatistics TaskContext::memoryStatistics()
+{
+    return engine_->memoryStatistics();
+}
+
 void TaskContext::resetTimeStatistics()
 {
     return engine_->resetTimeStatistics();
 }
 
+util::Arena & TaskContext::scratch()
+{
+    util::Arena *arena = util::Arena::current();
+    if (arena)
+        return *arena;
+    static thread_local util::Arena thread_arena;
+    return thread_arena;
+}
+
+std::vector<LatencyPathStatistics> TaskContext::latencyStatistics()
+{
+    return engine_->latencyStatistics();
+}
+
 std::shared_ptr<ExecutionEngine> TaskContext::engine() const
 {
     return engine_;
 }
 
-int long TaskContext::latencyTimestamp()
+void TaskContext::outgoingTrace(TraceContext &trace)
 {
-    return engine_->latency_timer.start_time;
+    engine_->outgoingTrace(trace);
 }
-void TaskContext::setLatencyTimestamp(int long timestamp)
+void TaskContext::incomingTrace(const TraceContext &trace, int long now)
 {
-    engine_->latency_timer.tmp_time = timestamp;
+    engine_->incomingTrace(trace, now);
 }
 void TaskContext::setTaskLatencySource()
 {
-    engine()->latency_timer.source = true;
+    engine()->setLatencySource();
 }
 void TaskContext::setTaskLatencyTarget()
 {
-
-    engine()->latency_timer.target = true;
+    engine()->setLatencyTarget();
 }
 
 uint32_t PeerTask::actvityId() const
@@ -296,13 +386,13 @@ uint32_t PeerTask::actvityId() const
     return father_->actvityId();
 }
 
-int long PeerTask::latencyTimestamp()
+void PeerTask::outgoingTrace(TraceContext &trace)
 {
-    return father_->latencyTimestamp();
+    father_->outgoingTrace(trace);
 }
-void PeerTask::setLatencyTimestamp(int long timestamp)
+void PeerTask::incomingTrace(const TraceContext &trace, int long now)
 {
-    father_->setLatencyTimestamp(timestamp);
+    father_->incomingTrace(trace, now);
 }
 
 std::shared_ptr<ExecutionEngine> PeerTask::engine() const
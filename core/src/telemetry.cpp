@@ -0,0 +1,408 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#ifndef WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "coco/telemetry.h"
+#include "coco/register.h"
+#include "coco/util/logging.h"
+#include "coco/util/timing.h"
+
+namespace coco
+{
+
+namespace
+{
+const char MAGIC[8] = "COCOTLM";
+
+std::size_t segmentSize(uint32_t max_tasks, uint32_t max_connections)
+{
+    return sizeof(TelemetryHeader) + max_tasks * sizeof(TelemetryTask) +
+           max_connections * sizeof(TelemetryConnection);
+}
+
+void copyName(char *dest, const std::string &name)
+{
+    std::size_t n = std::min(name.size(), TELEMETRY_NAME_SIZE - 1);
+    memcpy(dest, name.c_str(), n);
+    dest[n] = '\0';
+}
+}  // end of anonymous namespace
+
+class Telemetry::TelemetryImpl
+{
+public:
+    ~TelemetryImpl()
+    {
+        stop();
+    }
+
+    bool start(const std::string &name, unsigned period_us,
+               unsigned max_tasks, unsigned max_connections);
+    void stop();
+    bool isRunning() const { return header_ != nullptr; }
+    void refresh();
+
+private:
+    struct TaskSource
+    {
+        std::string name;
+        std::shared_ptr<TaskContext> task;
+    };
+    struct ConnectionSource
+    {
+        std::string src, src_port, dest, dest_port;
+        std::shared_ptr<ConnectionBase> connection;
+    };
+
+    void run();
+    void publish();
+
+    std::string name_;
+    unsigned period_us_ = DEFAULT_PERIOD_US;
+    TelemetryHeader *header_ = nullptr;
+    TelemetryTask *tasks_ = nullptr;
+    TelemetryConnection *connections_ = nullptr;
+    std::size_t size_ = 0;
+
+    std::thread thread_;
+    std::atomic<bool> stop_ = {false};
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cond_;
+
+    std::mutex sources_mutex_;  //!< Between refresh() and the publishing thread
+    std::vector<TaskSource> task_sources_;
+    std::vector<ConnectionSource> connection_sources_;
+    bool graph_changed_ = false;
+};
+
+Telemetry::Telemetry()
+{
+    impl_ptr_.reset(new TelemetryImpl());
+}
+
+Telemetry & Telemetry::instance()
+{
+    static Telemetry instance;
+    return instance;
+}
+
+bool Telemetry::start(const std::string &name, unsigned period_us,
+                      unsigned max_tasks, unsigned max_connections)
+{
+    return instance().impl_ptr_->start(name, period_us, max_tasks, max_connections);
+}
+
+void Telemetry::stop()
+{
+    instance().impl_ptr_->stop();
+}
+
+bool Telemetry::isRunning()
+{
+    return instance().impl_ptr_->isRunning();
+}
+
+void Telemetry::refresh()
+{
+    if (isRunning())
+        instance().impl_ptr_->refresh();
+}
+
+bool Telemetry::TelemetryImpl::start(const std::string &name, unsigned period_us,
+                                     unsigned max_tasks, unsigned max_connections)
+{
+#ifndef WIN32
+    if (header_)
+    {
+        COCO_ERR() << "Telemetry is already published in /" << name_;
+        return false;
+    }
+    name_ = name;
+    period_us_ = std::max(period_us, 1u);
+    size_ = segmentSize(max_tasks, max_connections);
+
+    std::string path = "/" + name_;
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        COCO_ERR() << "Cannot create the telemetry segment " << path << ": " << strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, size_) < 0)
+    {
+        COCO_ERR() << "Cannot resize the telemetry segment " << path << ": " << strerror(errno);
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return false;
+    }
+    void *memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        COCO_ERR() << "Cannot map the telemetry segment " << path << ": " << strerror(errno);
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    header_ = new (memory) TelemetryHeader();
+    memcpy(header_->magic, MAGIC, sizeof(MAGIC));
+    header_->version = TELEMETRY_VERSION;
+    header_->max_tasks = max_tasks;
+    header_->max_connections = max_connections;
+    header_->pid = static_cast<uint32_t>(getpid());
+    header_->period_us = period_us_;
+    header_->seq.store(0, std::memory_order_relaxed);
+    tasks_ = reinterpret_cast<TelemetryTask *>(header_ + 1);
+    connections_ = reinterpret_cast<TelemetryConnection *>(tasks_ + max_tasks);
+
+    refresh();
+    stop_ = false;
+    /* The publishing thread inherits a mask blocking the asynchronous signals, so SIGINT
+       is handled by the threads of the application and never interrupts an update */
+    sigset_t blocked, previous;
+    sigfillset(&blocked);
+    sigdelset(&blocked, SIGSEGV);
+    sigdelset(&blocked, SIGBUS);
+    sigdelset(&blocked, SIGFPE);
+    sigdelset(&blocked, SIGILL);
+    pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+    thread_ = std::thread(&TelemetryImpl::run, this);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    COCO_LOG(0) << "Publishing telemetry in " << path;
+    return true;
+#else
+    COCO_ERR() << "Telemetry is available only on POSIX systems";
+    return false;
+#endif
+}
+
+void Telemetry::TelemetryImpl::stop()
+{
+    if (!header_)
+        return;
+    {
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_cond_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+#ifndef WIN32
+    munmap(header_, size_);
+    shm_unlink(("/" + name_).c_str());
+#endif
+    header_ = nullptr;
+}
+
+void Telemetry::TelemetryImpl::refresh()
+{
+    std::vector<TaskSource> tasks;
+    std::vector<ConnectionSource> connections;
+    for (auto &task : ComponentRegistry::tasks())
+    {
+        if (isPeer(task.second))
+            continue;
+        tasks.push_back({task.first, task.second});
+        for (auto &port : task.second->ports())
+        {
+            if (port.second->isOutput())
+                continue;
+            for (auto &conn : port.second->connections())
+            {
+                connections.push_back({conn->output()->task()->instantiationName(),
+                                       conn->output()->name(),
+                                       task.second->instantiationName(),
+                                       port.second->name(), conn});
+            }
+        }
+    }
+    if (tasks.size() > header_->max_tasks || connections.size() > header_->max_connections)
+    {
+        COCO_ERR() << "Telemetry segment has room for " << header_->max_tasks << " tasks and "
+                   << header_->max_connections << " connections, the others are not published";
+        tasks.resize(std::min<std::size_t>(tasks.size(), header_->max_tasks));
+        connections.resize(std::min<std::size_t>(connections.size(), header_->max_connections));
+    }
+
+    std::unique_lock<std::mutex> lock(sources_mutex_);
+    task_sources_.swap(tasks);
+    connection_sources_.swap(connections);
+    graph_changed_ = true;
+}
+
+void Telemetry::TelemetryImpl::run()
+{
+    auto period = std::chrono::microseconds(period_us_);
+    auto next = std::chrono::steady_clock::now();
+    while (!stop_)
+    {
+        publish();
+        next += period;
+        auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now;
+        std::unique_lock<std::mutex> lock(stop_mutex_);
+        stop_cond_.wait_until(lock, next, [this]() { return stop_.load(); });
+    }
+}
+
+/* Writer side of the seqlock, the same scheme of util::Timer */
+void Telemetry::TelemetryImpl::publish()
+{
+    std::unique_lock<std::mutex> lock(sources_mutex_);
+
+    uint32_t seq = header_->seq.load(std::memory_order_relaxed);
+    header_->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (graph_changed_)
+    {
+        ++header_->graph_version;
+        for (std::size_t i = 0; i < task_sources_.size(); ++i)
+            copyName(tasks_[i].name, task_sources_[i].name);
+        for (std::size_t i = 0; i < connection_sources_.size(); ++i)
+        {
+            auto &source = connection_sources_[i];
+            copyName(connections_[i].src, source.src);
+            copyName(connections_[i].src_port, source.src_port);
+            copyName(connections_[i].dest, source.dest);
+            copyName(connections_[i].dest_port, source.dest_port);
+        }
+        graph_changed_ = false;
+    }
+    header_->task_count = static_cast<uint32_t>(task_sources_.size());
+    header_->connection_count = static_cast<uint32_t>(connection_sources_.size());
+
+    for (std::size_t i = 0; i < task_sources_.size(); ++i)
+    {
+        auto &task = task_sources_[i].task;
+        auto time = task->timer().timeStatistics(false);
+        auto memory = task->memoryStatistics();
+        TelemetryTask &t = tasks_[i];
+        t.state = static_cast<uint32_t>(task->state());
+        t.steps = time.iterations;
+        t.triggers = task->triggers();
+        t.time_last = time.last;
+        t.time_mean = time.mean;
+        t.time_stddev = std::sqrt(time.variance);
+        t.time_min = time.iterations > 0 ? time.min : 0;
+        t.time_max = time.max;
+        t.service_mean = time.service_mean;
+        t.service_stddev = std::sqrt(time.service_variance);
+        t.memory_live_bytes = memory.live_bytes;
+        t.memory_allocations = memory.allocations;
+    }
+    for (std::size_t i = 0; i < connection_sources_.size(); ++i)
+    {
+        auto &conn = connection_sources_[i].connection;
+        TelemetryConnection &c = connections_[i];
+        c.queued = conn->queuedSamples();
+        c.written = conn->writtenSamples();
+        c.dropped = conn->droppedSamples();
+    }
+    ++header_->updates;
+    header_->time_us = util::time();
+
+    header_->seq.store(seq + 2, std::memory_order_release);
+}
+
+TelemetryReader::~TelemetryReader()
+{
+    close();
+}
+
+bool TelemetryReader::open(const std::string &name)
+{
+#ifndef WIN32
+    close();
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(TelemetryHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *memory = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+    header_ = static_cast<const TelemetryHeader *>(memory);
+    size_ = st.st_size;
+    if (memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header_->version != TELEMETRY_VERSION ||
+        size_ < segmentSize(header_->max_tasks, header_->max_connections))
+    {
+        close();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TelemetryReader::close()
+{
+#ifndef WIN32
+    if (header_)
+        munmap(const_cast<TelemetryHeader *>(header_), size_);
+#endif
+    header_ = nullptr;
+    size_ = 0;
+}
+
+/* Reader side of the seqlock */
+bool TelemetryReader::read(TelemetrySnapshot &snapshot) const
+{
+    if (!header_)
+        return false;
+    auto tasks = reinterpret_cast<const TelemetryTask *>(header_ + 1);
+    auto connections = reinterpret_cast<const TelemetryConnection *>(tasks + header_->max_tasks);
+    for (int attempt = 0; attempt < 1000; ++attempt)
+    {
+        uint32_t before = header_->seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t task_count = std::min(header_->task_count, header_->max_tasks);
+        uint32_t connection_count = std::min(header_->connection_count, header_->max_connections);
+        snapshot.pid = header_->pid;
+        snapshot.period_us = header_->period_us;
+        snapshot.graph_version = header_->graph_version;
+        snapshot.updates = header_->updates;
+        snapshot.time_us = header_->time_us;
+        snapshot.tasks.assign(tasks, tasks + task_count);
+        snapshot.connections.assign(connections, connections + connection_count);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->seq.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+    return false;
+}
+
+}  // end of namespace coco
@@ -0,0 +1,209 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "coco/util/tracing.h"
+
+namespace coco
+{
+namespace util
+{
+
+std::atomic<bool> Tracer::enabled_ = {false};
+
+namespace
+{
+void writeEscaped(std::ostream &out, const char *str)
+{
+    out << '"';
+    for (; str && *str; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+            out << '\\' << *str;
+        else if (static_cast<unsigned char>(*str) < 0x20)
+            out << ' ';
+        else
+            out << *str;
+    }
+    out << '"';
+}
+
+void writeHeader(std::ostream &out, const TraceEvent &event, uint32_t tid,
+                 const char *phase, bool &first)
+{
+    if (!first)
+        out << ",\n";
+    first = false;
+    out << "{\"name\":";
+    writeEscaped(out, event.name);
+    out << ",\"cat\":";
+    writeEscaped(out, event.category);
+    out << ",\"ph\":\"" << phase << "\",\"ts\":" << event.time
+        << ",\"pid\":1,\"tid\":" << tid;
+}
+}  // end of anonymous namespace
+
+Tracer & Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::enable(std::size_t capacity)
+{
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        if (capacity > 0)
+            capacity_ = capacity;
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+    Tracer &tracer = instance();
+    ThreadBuffer *buffer = tracer.threadBuffer();
+    std::unique_lock<std::mutex> mlock(tracer.mutex_);
+    buffer->name = name;
+}
+
+const char * Tracer::intern(const std::string &name)
+{
+    Tracer &tracer = instance();
+    std::unique_lock<std::mutex> mlock(tracer.names_mutex_);
+    return tracer.names_.insert(name).first->c_str();
+}
+
+Tracer::ThreadBuffer * Tracer::threadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        buffers_.emplace_back(new ThreadBuffer());
+        buffer = buffers_.back().get();
+        buffer->events.resize(capacity_);
+        buffer->tid = static_cast<uint32_t>(buffers_.size());
+    }
+    return buffer;
+}
+
+uint64_t Tracer::record(TraceEventType type, const char *category,
+                        const char *name, uint64_t id)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    if (type == TraceEventType::FLOW_OUT)
+        id = (static_cast<uint64_t>(buffer->tid) << 40) | ++buffer->next_flow;
+
+    TraceEvent &event = buffer->events[head % buffer->events.size()];
+    event.time = util::time();
+    event.category = category;
+    event.name = name;
+    event.id = id;
+    event.type = type;
+    buffer->head.store(head + 1, std::memory_order_release);
+    return id;
+}
+
+std::string Tracer::chromeJson() const
+{
+    std::stringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+
+    std::unique_lock<std::mutex> mlock(mutex_);
+    for (auto &buffer : buffers_)
+    {
+        const uint64_t size = buffer->events.size();
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t start = head > size ? head - size : 0;
+        std::vector<TraceEvent> events;
+        events.reserve(head - start);
+        for (uint64_t i = start; i < head; ++i)
+            events.push_back(buffer->events[i % size]);
+
+        /* Drop the events overwritten by the writer while copying */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t new_head = buffer->head.load(std::memory_order_relaxed);
+        uint64_t valid = new_head + 1 > size ? new_head + 1 - size : 0;
+        std::size_t skip = valid > start ? std::min<uint64_t>(valid - start, events.size()) : 0;
+
+        if (!first)
+            out << ",\n";
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":";
+        std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->tid)
+                                                : buffer->name;
+        writeEscaped(out, name.c_str());
+        out << "}}";
+
+        unsigned depth = 0;
+        for (std::size_t i = skip; i < events.size(); ++i)
+        {
+            const TraceEvent &event = events[i];
+            switch (event.type)
+            {
+                case TraceEventType::BEGIN:
+                    ++depth;
+                    writeHeader(out, event, buffer->tid, "B", first);
+                    out << "}";
+                    break;
+                case TraceEventType::END:
+                    /* The matching begin may have been overwritten */
+                    if (depth == 0)
+                        break;
+                    --depth;
+                    writeHeader(out, event, buffer->tid, "E", first);
+                    out << "}";
+                    break;
+                case TraceEventType::INSTANT:
+                    writeHeader(out, event, buffer->tid, "i", first);
+                    out << ",\"s\":\"t\"}";
+                    break;
+                case TraceEventType::FLOW_OUT:
+                    writeHeader(out, event, buffer->tid, "i", first);
+                    out << ",\"s\":\"t\",\"args\":{\"flow\":" << event.id << "}}";
+                    writeHeader(out, event, buffer->tid, "s", first);
+                    out << ",\"id\":" << event.id << "}";
+                    break;
+                case TraceEventType::FLOW_IN:
+                    writeHeader(out, event, buffer->tid, "i", first);
+                    out << ",\"s\":\"t\",\"args\":{\"flow\":" << event.id << "}}";
+                    writeHeader(out, event, buffer->tid, "f", first);
+                    out << ",\"bp\":\"e\",\"id\":" << event.id << "}";
+                    break;
+            }
+        }
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool Tracer::dump(const std::string &file_name) const
+{
+    std::ofstream file(file_name);
+    if (!file.is_open())
+        return false;
+    file << chromeJson();
+    return file.good();
+}
+
+}  // end of namespace util
+}  // end of namespace coco
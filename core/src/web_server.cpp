@@ -13,13 +13,22 @@
 #include <atomic>
 #include <sstream>
 #include <deque>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include "coco/util/threading.h"
+#include "coco/util/json_writer.h"
+#include "coco/util/memory.hpp"
 #include "coco/util/accesses.hpp"
+#include "coco/util/tracing.h"
 
 #include "json/json.h"
 #include "mongoose/mongoose.h"
 
 #include "coco/register.h"
+#include "coco/graph_svg.h"
 
 #ifndef COCO_DOCUMENT_ROOT
 #define COCO_DOCUMENT_ROOT    "."
@@ -39,11 +48,24 @@ static std::string makeJSON(Json::Value &root)
     return json.str();    
 }
 
+/* Rate of a counter between two updates of the overlay, unknown at the first one */
+static void overlayRate(const std::unordered_map<std::string, double> &previous,
+                        std::unordered_map<std::string, double> &counters,
+                        std::unordered_map<std::string, double> &values,
+                        const std::string &key, double counter, double elapsed)
+{
+    auto last = previous.find(key);
+    if (last != previous.end())
+        values[key] = std::max(0.0, counter - last->second) / elapsed;
+    counters[key] = counter;
+}
+
 class WebServer::WebServerImpl
 {
 public:
     bool start(unsigned port, const std::string& appname,
-            const std::string& graph_svg, const std::string& web_server_root);
+            const std::string& graph_svg, const std::string& web_server_root,
+            unsigned update_period);
     void stop();
     bool isRunning() const;
     void sendStringWebSocket(const std::string &msg);
@@ -54,12 +76,44 @@ public:
 
 private:
     bool handleTask(struct mg_connection* nc,std::shared_ptr<TaskContext> pt, coco::util::split_iterator it, coco::util::split_iterator ite);
+    bool handleGraph(struct mg_connection* nc, coco::util::split_iterator it, coco::util::split_iterator ite);
+
+    /* A row of the state shown by the web UI, e.g. the statistics of one task.
+     * The row is serialized again only when its signature, a cheap summary of the
+     * source like the number of iterations, changes. version is the state version
+     * in which the JSON last changed, an empty JSON marks a removed row. */
+    struct StateRow
+    {
+        uint64_t signature = 0;
+        uint64_t version = 0;
+        std::string json;
+        bool seen = false;
+    };
+    typedef std::map<std::string, StateRow> StateSection;
 
     void run();
     static void eventHandler(struct mg_connection * nc, int ev, void * ev_data);
-    std::string buildJSON();
+    void refreshLog();
+    void refreshState();
+    const std::string & graphSvg();
+    template <class F>
+    void updateRow(StateSection &section, const std::string &key, uint64_t signature, F build);
+    void endSection(StateSection &section);
+    void commitVersion();
+    uint64_t oldestClientVersion() const;
+    void purge(uint64_t version);
+    std::string stateJSON(uint64_t since) const;
+    static std::string renderMetrics();
+    void broadcastState();
 
     static const std::string SVG_URI;
+    static const std::string TRACE_URI;
+    static const std::string METRICS_URI;
+    static const std::string GRAPH_URI;
+    static const std::size_t LOG_BACKLOG = 64 * 1024;
+    static const std::size_t MAX_PENDING_SEND = 1024 * 1024;
+    static constexpr double MIN_OVERLAY_PERIOD = 0.25;
+    static constexpr double OVERLAY_REQUEST_HOLD = 10;  // Seconds of refreshes after an overlay request
 
     struct mg_serve_http_opts http_server_opts_;
     struct mg_mgr mgr_;
@@ -71,11 +125,37 @@ private:
     std::string appname_;
     std::string document_root_;
     std::string graph_svg_;
+    bool custom_graph_svg_ = false;  // Given to start(), not generated from the graph
     std::mutex log_mutex_;
     std::stringstream log_stream_;
+
+    /* Everything below is used only by the server thread */
+    unsigned update_period_ = WebServer::DEFAULT_UPDATE_PERIOD;
+    uint64_t version_ = 0;  // Version of the last state with changes
+    bool changed_ = false;  // Rows changed in the state being built, tagged version_ + 1
+    StateSection activities_;
+    StateSection tasks_;
+    StateSection components_;
+    StateSection stats_;
+    StateSection connections_;
+    StateSection overlay_;  // Load of the tasks and rates of the connections, keyed by the ids in graph.svg
+    uint64_t graph_version_ = 0;  // ComponentRegistry::graphVersion() sent to the web pages
+    GraphSvg graph_;
+    uint64_t svg_version_ = 0;  // ComponentRegistry::graphVersion() drawn in graph_svg_
+    GraphOverlay graph_overlay_;
+    GraphOverlay overlay_counters_;  // Step time and written samples at the last overlay update
+    std::chrono::steady_clock::time_point overlay_time_;
+    std::chrono::steady_clock::time_point overlay_request_;  // Last GET /graph.svg?overlay=1
+    std::deque<std::pair<uint64_t, std::string> > log_chunks_;
+    std::size_t log_bytes_ = 0;
+    std::unordered_map<struct mg_connection *, uint64_t> clients_;  // Version seen by every websocket
 };
 
 const std::string WebServer::WebServerImpl::SVG_URI = "/graph.svg";
+const std::string WebServer::WebServerImpl::TRACE_URI = "/trace.json";
+const std::string WebServer::WebServerImpl::METRICS_URI = "/metrics";
+const std::string WebServer::WebServerImpl::GRAPH_URI = "/graph/";
+const unsigned WebServer::DEFAULT_UPDATE_PERIOD;
 
 WebServer::WebServer()
 {
@@ -89,13 +169,15 @@ WebServer & WebServer::instance()
 }
 
 bool WebServer::start(unsigned port, const std::string& appname,
-        const std::string& graph_svg, const std::string& web_server_root)
+        const std::string& graph_svg, const std::string& web_server_root,
+        unsigned update_period)
 {
     return instance().impl_ptr_->start(port, appname, graph_svg,
-            web_server_root);
+            web_server_root, update_period);
 }
 bool WebServer::WebServerImpl::start(unsigned port, const std::string& appname,
-        const std::string& graph_svg, const std::string& web_server_root)
+        const std::string& graph_svg, const std::string& web_server_root,
+        unsigned update_period)
 {
     if (web_server_root.empty())
         document_root_ = COCO_DOCUMENT_ROOT;
@@ -105,6 +187,8 @@ bool WebServer::WebServerImpl::start(unsigned port, const std::string& appname,
 
     appname_ = appname;
     graph_svg_ = graph_svg;
+    custom_graph_svg_ = !graph_svg.empty();
+    update_period_ = std::max(update_period, 1u);
     stop_server_ = false;
 
     http_server_opts_.document_root = document_root_.c_str();
@@ -116,6 +200,7 @@ bool WebServer::WebServerImpl::start(unsigned port, const std::string& appname,
         return false;
     }
     mg_set_protocol_http_websocket(mg_connection_);
+    util::LoggerManager::instance()->setWebOutput(true);
     server_thread_ = std::thread(&WebServer::WebServerImpl::run, this);
     return true;
 }
@@ -154,15 +239,196 @@ void WebServer::WebServerImpl::sendStringHttp(struct mg_connection *conn,
     mg_printf(conn,
             "HTTP/1.1 200 OK\r\nContent-type: %s\nTransfer-Encoding: chunked\r\nAccess-Control-Allow-Origin: *\r\n\r\n",
             type.c_str());
-    mg_printf_http_chunk(conn, msg.c_str());
+    mg_send_http_chunk(conn, msg.c_str(), msg.size());
     mg_send_http_chunk(conn, "", 0);
 }
 
-static std::string format(double v)
+/* Metrics in the Prometheus text format served at /metrics. Everything is read from
+ * relaxed atomic counters and the RCU connection lists, never from the locks of the
+ * tasks and of the connections, so a scrape doesn't block the activities. */
+class MetricsWriter
+{
+public:
+    void family(const char *name, const char *type, const char *help)
+    {
+        text_ += "# HELP ";
+        text_ += name;
+        text_ += ' ';
+        text_ += help;
+        text_ += "\n# TYPE ";
+        text_ += name;
+        text_ += ' ';
+        text_ += type;
+        text_ += '\n';
+    }
+    void sample(const std::string &name, const std::string &labels, double value)
+    {
+        char str[64];
+        snprintf(str, sizeof(str), "%.9g", value);
+        line(name, labels, str);
+    }
+    void sample(const std::string &name, const std::string &labels, uint64_t value)
+    {
+        line(name, labels, std::to_string(value));
+    }
+    /*! \brief Histogram with the given bounds in microseconds, exported in seconds.
+     */
+    void histogram(const std::string &name, const std::string &labels,
+                   const util::Histogram &histogram, double sum)
+    {
+        static const uint64_t BOUNDS[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000,
+                                          10000, 25000, 50000, 100000, 250000, 500000, 1000000};
+        static const std::size_t N = sizeof(BOUNDS) / sizeof(BOUNDS[0]);
+        uint64_t counts[N];
+        uint64_t total = histogram.cumulativeCounts(BOUNDS, N, counts);
+        char le[32];
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            snprintf(le, sizeof(le), ",le=\"%g\"", BOUNDS[i] / 1000000.0);
+            line(name + "_bucket", labels + le, std::to_string(counts[i]));
+        }
+        line(name + "_bucket", labels + ",le=\"+Inf\"", std::to_string(total));
+        sample(name + "_sum", labels, sum);
+        sample(name + "_count", labels, total);
+    }
+    const std::string & text() const { return text_; }
+
+    static std::string label(const char *name, const std::string &value)
+    {
+        std::string l = name;
+        l += "=\"";
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                l += '\\';
+            if (c == '\n')
+                l += "\\n";
+            else
+                l += c;
+        }
+        l += '"';
+        return l;
+    }
+
+private:
+    void line(const std::string &name, const std::string &labels, const std::string &value)
+    {
+        text_ += name;
+        if (!labels.empty())
+        {
+            text_ += '{';
+            text_ += labels;
+            text_ += '}';
+        }
+        text_ += ' ';
+        text_ += value;
+        text_ += '\n';
+    }
+
+    std::string text_;
+};
+
+std::string WebServer::WebServerImpl::renderMetrics()
 {
-    char str[64];
-    snprintf(str, sizeof(str), "%.6lf", v);
-    return std::string(str);
+    std::vector<std::pair<std::string, std::shared_ptr<TaskContext> > > tasks;
+    for (auto &task : ComponentRegistry::tasks())
+    {
+        if (!std::dynamic_pointer_cast<PeerTask>(task.second))
+            tasks.emplace_back(MetricsWriter::label("task", task.first), task.second);
+    }
+
+    MetricsWriter m;
+    m.family("coco_task_execution_seconds", "histogram", "Execution time of the steps of the task.");
+    for (auto &task : tasks)
+    {
+        auto &timer = task.second->timer();
+        m.histogram("coco_task_execution_seconds", task.first, timer.timeHistogram(), timer.elapsed());
+    }
+    m.family("coco_task_service_seconds", "histogram", "Time between the start of consecutive steps of the task.");
+    for (auto &task : tasks)
+    {
+        auto &timer = task.second->timer();
+        m.histogram("coco_task_service_seconds", task.first, timer.serviceHistogram(),
+                    timer.serviceElapsed());
+    }
+    m.family("coco_task_steps_total", "counter", "Steps executed by the task since the last reset of the statistics.");
+    for (auto &task : tasks)
+        m.sample("coco_task_steps_total", task.first,
+                 static_cast<uint64_t>(task.second->timer().iterations()));
+    m.family("coco_task_triggers_total", "counter", "Triggers received by the task from its event ports.");
+    for (auto &task : tasks)
+        m.sample("coco_task_triggers_total", task.first, task.second->triggers());
+    m.family("coco_task_memory_live_bytes", "gauge", "Memory allocated by the task and still in use.");
+    for (auto &task : tasks)
+        m.sample("coco_task_memory_live_bytes", task.first,
+                 static_cast<uint64_t>(task.second->memoryStatistics().live_bytes));
+    m.family("coco_task_memory_allocations_total", "counter", "Allocations of the task since the last reset.");
+    for (auto &task : tasks)
+        m.sample("coco_task_memory_allocations_total", task.first,
+                 task.second->memoryStatistics().allocations);
+
+    m.family("coco_activity_overruns_total", "counter", "Periods in which the tasks of a periodic activity ran longer than the period.");
+    for (auto &activity : ComponentRegistry::activities())
+    {
+        if (!activity->isPeriodic())
+            continue;
+        std::string names;
+        for (auto &runnable : activity->runnables())
+        {
+            auto engine = std::dynamic_pointer_cast<ExecutionEngine>(runnable);
+            if (!engine)
+                continue;
+            if (!names.empty())
+                names += ',';
+            names += engine->task()->instantiationName();
+        }
+        m.sample("coco_activity_overruns_total",
+                 MetricsWriter::label("activity", std::to_string(activity->id())) + "," +
+                 MetricsWriter::label("tasks", names),
+                 activity->overruns());
+    }
+
+    std::vector<std::pair<std::string, std::shared_ptr<ConnectionBase> > > connections;
+    for (auto &task : ComponentRegistry::tasks())
+    {
+        for (auto &port : task.second->ports())
+        {
+            if (port.second->isOutput())
+                continue;
+            for (auto &conn : port.second->connections())
+            {
+                std::string labels =
+                    MetricsWriter::label("src", conn->output()->task()->instantiationName()) + "," +
+                    MetricsWriter::label("src_port", conn->output()->name()) + "," +
+                    MetricsWriter::label("dest", task.second->instantiationName()) + "," +
+                    MetricsWriter::label("dest_port", port.second->name());
+                connections.emplace_back(labels, conn);
+            }
+        }
+    }
+    m.family("coco_connection_queue_length", "gauge", "Samples in the connection after the last read or write.");
+    for (auto &conn : connections)
+        m.sample("coco_connection_queue_length", conn.first,
+                 static_cast<uint64_t>(conn.second->queuedSamples()));
+    m.family("coco_connection_written_total", "counter", "Samples written in the connection.");
+    for (auto &conn : connections)
+        m.sample("coco_connection_written_total", conn.first, conn.second->writtenSamples());
+    m.family("coco_connection_dropped_total", "counter", "Samples refused by a full buffer or overwritten before being read.");
+    for (auto &conn : connections)
+        m.sample("coco_connection_dropped_total", conn.first, conn.second->droppedSamples());
+
+    auto pool = util::MemoryPool::defaultPool()->statistics();
+    m.family("coco_memory_pool_in_use_bytes", "gauge", "Bytes allocated from the default memory pool and not released.");
+    m.sample("coco_memory_pool_in_use_bytes", "", static_cast<uint64_t>(pool.bytes_in_use));
+    m.family("coco_memory_pool_cached_bytes", "gauge", "Bytes of the free blocks kept by the default memory pool.");
+    m.sample("coco_memory_pool_cached_bytes", "", static_cast<uint64_t>(pool.cached_bytes));
+    m.family("coco_memory_pool_cap_bytes", "gauge", "Maximum bytes kept by the default memory pool.");
+    m.sample("coco_memory_pool_cap_bytes", "", static_cast<uint64_t>(pool.memory_cap));
+    m.family("coco_memory_pool_allocations_total", "counter", "Allocations from the default memory pool.");
+    m.sample("coco_memory_pool_allocations_total", "", static_cast<uint64_t>(pool.allocations));
+    m.family("coco_memory_pool_hits_total", "counter", "Allocations served by a block cached by the default memory pool.");
+    m.sample("coco_memory_pool_hits_total", "", static_cast<uint64_t>(pool.hits));
+    return m.text();
 }
 
 static const std::string TaskStateDesc[] =
@@ -302,81 +568,484 @@ bool WebServer::WebServerImpl::handleTask(struct mg_connection* nc,std::shared_p
     return true;
 }
 
-std::string WebServer::WebServerImpl::buildJSON()
+/* Runtime editing of the graph with POST requests, available only when the launcher
+ * registered a GraphEditor (--graph_edit). The requests are not authenticated and add
+ * can load any library, so the option must be enabled only on trusted networks:
+ *   /graph/add/COMPONENT/NAME/PERIOD_MS[/LIBRARY]  period 0 for a triggered task
+ *   /graph/remove/NAME
+ *   /graph/connect/SRC/PORT/DEST/PORT[/DATA|BUFFER|CIRCULAR[/SIZE]]
+ *   /graph/disconnect/SRC/PORT/DEST/PORT
+ *   /graph/start/NAME
+ *   /graph/stop/NAME
+ */
+bool WebServer::WebServerImpl::handleGraph(struct mg_connection* nc, coco::util::split_iterator si, coco::util::split_iterator se)
+{
+    auto ws = (WebServer::WebServerImpl*) nc->mgr->user_data;
+    GraphEditor *editor = ComponentRegistry::graphEditor();
+    if (!editor)
+    {
+        ws->sendError(nc, 403,"graph editing is not enabled");
+        return true;
+    }
+    std::vector<std::string> args;
+    for (++si; si != se; ++si)
+        args.push_back(*si);
+    if (args.empty())
+    {
+        ws->sendError(nc, 404,"only: add,remove,connect,disconnect,start,stop");
+        return true;
+    }
+
+    const std::string &command = args[0];
+    bool done;
+    if (command == "add" && (args.size() == 4 || args.size() == 5))
+    {
+        int period = atoi(args[3].c_str());
+        SchedulePolicy policy(period > 0 ? SchedulePolicy::PERIODIC : SchedulePolicy::TRIGGERED,
+                              period);
+        done = editor->addTask(args[1], args[2], args.size() == 5 ? args[4] : "", policy);
+    }
+    else if (command == "remove" && args.size() == 2)
+    {
+        done = editor->removeTask(args[1]);
+    }
+    else if (command == "connect" && args.size() >= 5 && args.size() <= 7)
+    {
+        ConnectionPolicy policy;
+        if (args.size() >= 6)
+        {
+            if (args[5] == "DATA")
+                policy.data_policy = ConnectionPolicy::DATA;
+            else if (args[5] == "BUFFER")
+                policy.data_policy = ConnectionPolicy::BUFFER;
+            else if (args[5] == "CIRCULAR")
+                policy.data_policy = ConnectionPolicy::CIRCULAR;
+            else
+            {
+                ws->sendError(nc, 400,"policy is one of DATA,BUFFER,CIRCULAR");
+                return true;
+            }
+        }
+        if (args.size() == 7)
+            policy.buffer_size = std::max(1, atoi(args[6].c_str()));
+        done = editor->connectPorts(args[1], args[2], args[3], args[4], policy);
+    }
+    else if (command == "disconnect" && args.size() == 5)
+    {
+        done = editor->disconnectPorts(args[1], args[2], args[3], args[4]);
+    }
+    else if (command == "start" && args.size() == 2)
+    {
+        done = editor->startTask(args[1]);
+    }
+    else if (command == "stop" && args.size() == 2)
+    {
+        done = editor->stopTask(args[1]);
+    }
+    else
+    {
+        ws->sendError(nc, 400,"wrong arguments");
+        return true;
+    }
+
+    if (done)
+        ws->sendError(nc, 200,"done");
+    else
+        ws->sendError(nc, 400,"failed, see the log");
+    return true;
+}
+
+/* The state shown by the web UI is kept as sections of rows serialized once,
+ * every websocket receives only the rows changed since the version it has seen,
+ * null for the removed ones. A new websocket or a POST /info receive everything:
+ *   {"version":N,"graph":G,"full":true,"info":{...},"log":"...","activities":{"0":{...}},
+ *    "tasks":{NAME:{...}},"components":{...},"stats":{NAME:{...}},"connections":{...},
+ *    "overlay":{"task:NAME":{"load":L},"conn:KEY":{"rate":R}}}
+ * graph is the version of the graph drawn in graph.svg, the overlay rows use the ids of its elements.
+ */
+void WebServer::WebServerImpl::refreshLog()
 {
-    Json::Value root;
-    Json::Value& info = root["info"];
-    info["project_name"] = appname_;
+    std::string text;
     {
         std::unique_lock<std::mutex> tmp(log_mutex_);
-        root["log"] = log_stream_.str();
+        text = log_stream_.str();
         log_stream_.str("");
     }
-    Json::Value& acts = root["activities"];
+    if (!text.empty())
+    {
+        log_bytes_ += text.size();
+        log_chunks_.emplace_back(version_ + 1, std::move(text));
+        changed_ = true;
+    }
+    while (log_bytes_ > LOG_BACKLOG && log_chunks_.size() > 1)
+    {
+        log_bytes_ -= log_chunks_.front().second.size();
+        log_chunks_.pop_front();
+    }
+    commitVersion();
+}
+
+template <class F>
+void WebServer::WebServerImpl::updateRow(StateSection &section, const std::string &key,
+                                         uint64_t signature, F build)
+{
+    StateRow &row = section[key];
+    row.seen = true;
+    if (!row.json.empty() && row.signature == signature)
+        return;
+    std::string json;
+    util::JsonWriter writer(json);
+    writer.beginObject();
+    build(writer);
+    writer.endObject();
+    row.signature = signature;
+    if (json != row.json)
+    {
+        row.json.swap(json);
+        row.version = version_ + 1;
+        changed_ = true;
+    }
+}
+
+void WebServer::WebServerImpl::endSection(StateSection &section)
+{
+    for (auto &row : section)
+    {
+        if (!row.second.seen && !row.second.json.empty())
+        {
+            row.second.json.clear();
+            row.second.version = version_ + 1;
+            changed_ = true;
+        }
+        row.second.seen = false;
+    }
+}
+
+void WebServer::WebServerImpl::commitVersion()
+{
+    if (changed_)
+        ++version_;
+    changed_ = false;
+}
+
+void WebServer::WebServerImpl::refreshState()
+{
+    /* The overlay of the graph compares the counters of two refreshes not too close in time */
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - overlay_time_).count();
+    bool overlay = elapsed >= MIN_OVERLAY_PERIOD;
+    GraphOverlay counters, values;
+
     int acti = 0;
     for (auto& v : ComponentRegistry::activities())
     {
-        Json::Value jact;
-        jact["id"] = acti++;
-        jact["active"] = v->isActive() ? "Yes" : "No";
-        jact["periodic"] = v->isPeriodic() ? "Yes" : "No";
-        jact["period"] = v->period();
-        jact["policy"] = SchedulePolicyDesc[v->policy().scheduling_policy];
-        acts.append(jact);
+        int id = acti++;
+        bool active = v->isActive();
+        updateRow(activities_, std::to_string(id), active ? 1 : 2,
+                  [&](util::JsonWriter &w)
+        {
+            w.field("id", id);
+            w.field("active", active ? "Yes" : "No");
+            w.field("periodic", v->isPeriodic() ? "Yes" : "No");
+            w.field("period", v->period());
+            w.field("policy", SchedulePolicyDesc[v->policy().scheduling_policy]);
+        });
     }
-    Json::Value& tasks = root["tasks"];
+    endSection(activities_);
+
     for (auto& v : ComponentRegistry::tasks())
     {
-        Json::Value jtask;
-        jtask["name"] = v.second->instantiationName();
-        jtask["class"] = v.second->name();
-        jtask["type"] =
-                std::dynamic_pointer_cast<PeerTask>(v.second) ? "Peer" : "Task";
-        jtask["state"] = TaskStateDesc[static_cast<int>(v.second->state())];
-        tasks.append(jtask);
+        auto state = static_cast<int>(v.second->state());
+        updateRow(tasks_, v.first, state + 1, [&](util::JsonWriter &w)
+        {
+            w.field("name", v.second->instantiationName());
+            w.field("class", v.second->name());
+            w.field("type", std::dynamic_pointer_cast<PeerTask>(v.second) ? "Peer" : "Task");
+            w.field("state", TaskStateDesc[state]);
+        });
     }
-    //Json::Value& taskspecs = root["taskspecs"];
+    endSection(tasks_);
+
     int itaskspecs = 0;
-    //const std::unordered_map<std::string, ComponentSpec*> &
     for (auto& v : ComponentRegistry::components())
     {
-        Json::Value jcs;
-        jcs["id"] = itaskspecs++;
-        jcs["class"] = v.second->class_name_;
-        jcs["name"] = v.first; // for alias, while second.name_ is originakl
-        acts.append(jcs);
-    }    
-    Json::Value& stats = root["stats"];
+        int id = itaskspecs++;
+        updateRow(components_, v.first, 1, [&](util::JsonWriter &w)
+        {
+            w.field("id", id);
+            w.field("class", v.second->class_name_);
+            w.field("name", v.first); // for alias, while second.name_ is originakl
+        });
+    }
+    endSection(components_);
+
     for (auto& task : ComponentRegistry::tasks())
     {
         if (std::dynamic_pointer_cast<PeerTask>(task.second))
             continue;
-        Json::Value jtask;
-        auto name = task.second->instantiationName();
-        auto time = task.second->timeStatistics();
-
-        auto tm = time.mean;
-        auto tv = time.variance;
-        jtask["name"] = name;
-        jtask["iterations"] = static_cast<uint32_t>(time.iterations);
-        jtask["time"] = format(time.elapsed);
-        jtask["time_inst"] = format(time.last);
-        jtask["time_mean"] = format(tm);
-        jtask["time_stddev"] = format(tv);
-        jtask["time_exec_mean"] = format(time.service_mean);
-        jtask["time_exec_stddev"] = format(time.service_variance);
-        jtask["time_min"] = format(time.min);
-        jtask["time_max"] = format(time.max);
-        stats.append(jtask);
+        if (overlay && ComponentRegistry::profilingEnabled())
+            overlayRate(overlay_counters_.task_load, counters.task_load, values.task_load,
+                        task.second->instantiationName(), task.second->timer().elapsed(),
+                        elapsed);
+        /* A task that didn't step has the same statistics, skip the percentiles */
+        updateRow(stats_, task.first, task.second->iterations() + 1, [&](util::JsonWriter &w)
+        {
+            auto time = task.second->timeStatistics();
+            w.field("name", task.second->instantiationName());
+            w.field("iterations", time.iterations);
+            w.field("time", time.elapsed);
+            w.field("time_inst", time.last);
+            w.field("time_mean", time.mean);
+            w.field("time_stddev", time.variance);
+            w.field("time_exec_mean", time.service_mean);
+            w.field("time_exec_stddev", time.service_variance);
+            w.field("time_min", time.min);
+            w.field("time_max", time.max);
+            w.field("time_p50", time.time_percentiles.p50);
+            w.field("time_p99", time.time_percentiles.p99);
+            w.field("time_p999", time.time_percentiles.p999);
+            w.field("time_exec_p50", time.service_percentiles.p50);
+            w.field("time_exec_p99", time.service_percentiles.p99);
+            w.field("time_exec_p999", time.service_percentiles.p999);
+            auto perf = task.second->perfStatistics();
+            if (perf.steps > 0 && perf.available != 0)
+            {
+                w.key("perf").beginObject();
+                if (perf.has(util::PerfCounters::CYCLES))
+                    w.field("cycles", perf.cycles);
+                if (perf.has(util::PerfCounters::INSTRUCTIONS))
+                    w.field("instructions", perf.instructions);
+                if (perf.has(util::PerfCounters::CYCLES) && perf.has(util::PerfCounters::INSTRUCTIONS))
+                    w.field("ipc", perf.ipc());
+                if (perf.has(util::PerfCounters::LLC_MISSES))
+                    w.field("llc_misses", perf.llc_misses);
+                if (perf.has(util::PerfCounters::CONTEXT_SWITCHES))
+                    w.field("context_switches", perf.context_switches);
+                w.endObject();
+            }
+            auto memory = task.second->memoryStatistics();
+            if (memory.allocations > 0 || memory.live_bytes > 0)
+            {
+                w.key("memory").beginObject();
+                w.field("live_bytes", memory.live_bytes);
+                w.field("peak_bytes", memory.peak_bytes);
+                w.field("allocations", memory.allocations);
+                w.field("rate", memory.allocation_rate);
+                w.endObject();
+            }
+            auto latency = task.second->latencyStatistics();
+            if (!latency.empty())
+            {
+                w.key("latency").beginArray();
+                for (auto &path : latency)
+                {
+                    w.beginObject();
+                    w.field("source", path.source);
+                    w.field("samples", path.latency.count);
+                    w.field("p50", path.latency.p50);
+                    w.field("p99", path.latency.p99);
+                    w.field("p999", path.latency.p999);
+                    w.field("max", path.latency.max);
+                    w.field("queue_p50", path.queue.p50);
+                    w.field("queue_p99", path.queue.p99);
+                    w.field("compute_p50", path.compute.p50);
+                    w.field("compute_p99", path.compute.p99);
+                    w.endObject();
+                }
+                w.endArray();
+            }
+        });
     }
+    endSection(stats_);
 
-    Json::StreamWriterBuilder builder;
-    builder["commentStyle"] = "None";
-    builder["indentation"] = "";
-    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-    std::stringstream json;
-    writer->write(root, &json);
-    return json.str();
+    for (auto& task : ComponentRegistry::tasks())
+    {
+        for (auto& port : task.second->ports())
+        {
+            if (port.second->isOutput())
+                continue;
+            for (auto& conn : port.second->connections())
+            {
+                std::string key = GraphSvg::connectionKey(conn->output()->task()->instantiationName(),
+                                                          conn->output()->name(),
+                                                          task.second->instantiationName(),
+                                                          port.second->name());
+                if (overlay)
+                    overlayRate(overlay_counters_.connection_rate, counters.connection_rate,
+                                values.connection_rate, key, conn->writtenSamples(), elapsed);
+                uint64_t samples = conn->queueSamples();
+                auto buffer = conn->bufferStatistics();
+                if (samples == 0 && buffer.writes == 0)
+                    continue;
+                updateRow(connections_, key, samples + buffer.writes, [&](util::JsonWriter &w)
+                {
+                    w.field("src", conn->output()->task()->instantiationName());
+                    w.field("src_port", conn->output()->name());
+                    w.field("dest", task.second->instantiationName());
+                    w.field("dest_port", port.second->name());
+                    if (samples > 0)
+                    {
+                        auto queue = conn->queueStatistics();
+                        w.field("samples", queue.count);
+                        w.field("queue_p50", queue.p50);
+                        w.field("queue_p99", queue.p99);
+                        w.field("queue_p999", queue.p999);
+                        w.field("queue_max", queue.max);
+                    }
+                    w.key("buffer").beginObject();
+                    w.field("bytes", buffer.buffer_bytes);
+                    w.field("writes", buffer.writes);
+                    w.field("rate", buffer.write_rate);
+                    w.endObject();
+                });
+            }
+        }
+    }
+    endSection(connections_);
+
+    if (overlay)
+    {
+        /* A step is counted when it ends, a long one can exceed the interval */
+        for (auto &load : values.task_load)
+            load.second = std::min(1.0, load.second);
+        overlay_time_ = now;
+        overlay_counters_ = std::move(counters);
+        graph_overlay_ = std::move(values);
+    }
+    for (auto &load : graph_overlay_.task_load)
+    {
+        updateRow(overlay_, "task:" + load.first, std::llround(load.second * 1000) + 1,
+                  [&](util::JsonWriter &w) { w.field("load", load.second); });
+    }
+    for (auto &rate : graph_overlay_.connection_rate)
+    {
+        updateRow(overlay_, "conn:" + rate.first, std::llround(rate.second * 10) + 1,
+                  [&](util::JsonWriter &w) { w.field("rate", rate.second); });
+    }
+    endSection(overlay_);
+
+    /* The web pages download graph.svg again when the graph changes */
+    uint64_t graph_version = ComponentRegistry::graphVersion();
+    if (graph_version != graph_version_)
+    {
+        graph_version_ = graph_version;
+        changed_ = true;
+    }
+
+    commitVersion();
+    purge(oldestClientVersion());
+}
+
+/* The layout is computed again only when tasks or connections changed,
+ * the web pages draw the overlay on the cached graph */
+const std::string & WebServer::WebServerImpl::graphSvg()
+{
+    uint64_t version = ComponentRegistry::graphVersion();
+    if (!custom_graph_svg_ && (graph_svg_.empty() || version != svg_version_))
+    {
+        graph_.layout();
+        graph_svg_ = graph_.render();
+        svg_version_ = version;
+    }
+    return graph_svg_;
+}
+
+uint64_t WebServer::WebServerImpl::oldestClientVersion() const
+{
+    uint64_t oldest = version_;
+    for (auto &client : clients_)
+        oldest = std::min(oldest, client.second);
+    return oldest;
+}
+
+/* Drop the removed rows that every websocket already knows about,
+ * new websockets receive the full state without them */
+void WebServer::WebServerImpl::purge(uint64_t version)
+{
+    for (StateSection *section : {&activities_, &tasks_, &components_, &stats_, &connections_,
+                                  &overlay_})
+    {
+        for (auto it = section->begin(); it != section->end();)
+        {
+            if (it->second.json.empty() && it->second.version <= version)
+                it = section->erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+std::string WebServer::WebServerImpl::stateJSON(uint64_t since) const
+{
+    bool full = since == 0;
+    std::string json;
+    util::JsonWriter w(json);
+    w.beginObject();
+    w.field("version", version_);
+    w.field("graph", graph_version_);
+    w.field("full", full);
+    if (full)
+    {
+        w.key("info").beginObject();
+        w.field("project_name", appname_);
+        w.endObject();
+    }
+    std::string log;
+    for (auto &chunk : log_chunks_)
+    {
+        if (chunk.first > since)
+            log += chunk.second;
+    }
+    w.field("log", log);
+
+    auto section = [&](const char *name, const StateSection &rows)
+    {
+        w.key(name).beginObject();
+        for (auto &row : rows)
+        {
+            if (row.second.version <= since || (full && row.second.json.empty()))
+                continue;
+            w.key(row.first);
+            if (row.second.json.empty())
+                w.null();
+            else
+                w.raw(row.second.json);
+        }
+        w.endObject();
+    };
+    section("activities", activities_);
+    section("tasks", tasks_);
+    section("components", components_);
+    section("stats", stats_);
+    section("connections", connections_);
+    section("overlay", overlay_);
+    w.endObject();
+    return json;
+}
+
+/* Clients at the same version share the message, clients with data still
+ * to be sent are skipped and catch up at a later update */
+void WebServer::WebServerImpl::broadcastState()
+{
+    std::map<uint64_t, std::string> messages;
+    for (auto &client : clients_)
+    {
+        if (client.second == version_ || client.first->send_mbuf.len > MAX_PENDING_SEND)
+            continue;
+        auto it = messages.find(client.second);
+        if (it == messages.end())
+            it = messages.emplace(client.second, stateJSON(client.second)).first;
+        mg_send_websocket_frame(client.first, WEBSOCKET_OP_TEXT,
+                                it->second.c_str(), it->second.size());
+        client.second = version_;
+    }
+    uint64_t oldest = oldestClientVersion();
+    while (!log_chunks_.empty() && log_chunks_.front().first <= oldest && !clients_.empty())
+    {
+        log_bytes_ -= log_chunks_.front().second.size();
+        log_chunks_.pop_front();
+    }
+    purge(oldest);
 }
 
 void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
@@ -394,13 +1063,28 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
         	// handles commands from the web UI
             if (mg_vcmp(&hm->uri, "/info") == 0)
             {
-                ws->sendStringHttp(nc, "text/json", ws->buildJSON());
+                ws->refreshLog();
+                ws->refreshState();
+                ws->sendStringHttp(nc, "text/json", ws->stateJSON(0));
+            }
+            else if (std::string(hm->uri.p, hm->uri.len).compare(0, GRAPH_URI.size(), GRAPH_URI) == 0)
+            {
+                coco::util::string_splitter ss(std::string(hm->uri.p+1,hm->uri.len-1),'/');
+                ws->handleGraph(nc,ss.begin(),ss.end());
             }
             else if (mg_vcmp(&hm->body, "action=reset_stats") == 0)
             {
                 //  COCO_RESET_TIMERS;
                 for (auto& task : ComponentRegistry::tasks())
                 {
+                    for (auto& port : task.second->ports())
+                    {
+                        for (auto& conn : port.second->connections())
+                        {
+                            conn->resetQueueStatistics();
+                            conn->resetBufferStatistics();
+                        }
+                    }
                     if ( std::dynamic_pointer_cast<PeerTask>(task.second))
                         continue;
                     task.second->resetTimeStatistics();
@@ -409,7 +1093,9 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
             }
             else
             {
-                ws->sendStringHttp(nc, "text/json", ws->buildJSON());
+                ws->refreshLog();
+                ws->refreshState();
+                ws->sendStringHttp(nc, "text/json", ws->stateJSON(0));
             }
             dodefault = false;
         }
@@ -418,7 +1104,31 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
         {
             if(mg_vcmp(&hm->uri, SVG_URI.c_str()) == 0)
             {
-                ws->sendStringHttp(nc, "text/svg", ws->graph_svg_);
+                char overlay[8];
+                if (mg_get_http_var(&hm->query_string, "overlay", overlay, sizeof(overlay)) >= 0 &&
+                    !ws->custom_graph_svg_)
+                {
+                    /* Drawn with the values of the last refresh, never waiting on the server
+                     * thread: without open pages the first request starts the refreshes
+                     * and gets no rates, the following ones do */
+                    ws->overlay_request_ = std::chrono::steady_clock::now();
+                    if (ws->clients_.empty())
+                        ws->refreshState();
+                    ws->graphSvg();
+                    ws->sendStringHttp(nc, "image/svg+xml", ws->graph_.render(&ws->graph_overlay_));
+                }
+                else
+                    ws->sendStringHttp(nc, "image/svg+xml", ws->graphSvg());
+                dodefault = false;
+            }
+            else if (mg_vcmp(&hm->uri, TRACE_URI.c_str()) == 0)
+            {
+                ws->sendStringHttp(nc, "text/json", util::Tracer::instance().chromeJson());
+                dodefault = false;
+            }
+            else if (mg_vcmp(&hm->uri, METRICS_URI.c_str()) == 0)
+            {
+                ws->sendStringHttp(nc, "text/plain; version=0.0.4", renderMetrics());
                 dodefault = false;
             }
             else
@@ -457,6 +1167,11 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
                         ws->sendStringHttp(nc, "text/json", makeJSON(root));
                     }
                 }
+                else if(*si == "graph")
+                {
+                    dodefault = false;
+                    ws->sendError(nc, 405,"the graph is edited with POST requests");
+                }
 
             }
         }
@@ -466,14 +1181,12 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
         }
     }
     break;
-    // MG_EV_POLL is generated by mongoose every mg_mgr_poll's polling time
-    case MG_EV_POLL:
-    if (nc->flags & MG_F_IS_WEBSOCKET)
-    {
-    	// TODO update json only every x milliseconds, x >= mg_mgr_poll's polling time
-        const auto& json = ws->buildJSON();
-        mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, json.c_str(), json.size());
-    }
+    // the state is pushed by run(), a new websocket starts from the full state
+    case MG_EV_WEBSOCKET_HANDSHAKE_DONE:
+        ws->clients_[nc] = 0;
+    break;
+    case MG_EV_CLOSE:
+        ws->clients_.erase(nc);
     break;
     default:
     break;
@@ -482,9 +1195,24 @@ void WebServer::WebServerImpl::eventHandler(struct mg_connection* nc, int ev,
 
 void WebServer::WebServerImpl::run()
 {
+    auto period = std::chrono::milliseconds(update_period_);
+    auto next_update = std::chrono::steady_clock::now() + period;
     while (!stop_server_)
     {
-        mg_mgr_poll(&mgr_, 100);
+        mg_mgr_poll(&mgr_, std::min(100u, update_period_));
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_update)
+            continue;
+        next_update = now + period;
+        refreshLog();
+        /* nothing to compute when no page is open or asked for the overlay recently */
+        if (!clients_.empty())
+        {
+            refreshState();
+            broadcastState();
+        }
+        else if (std::chrono::duration<double>(now - overlay_request_).count() < OVERLAY_REQUEST_HOLD)
+            refreshState();
     }
     mg_mgr_free(&mgr_);
 }
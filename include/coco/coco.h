@@ -15,8 +15,13 @@
 #include <coco/util/generics.hpp>
 #include <coco/util/accesses.hpp>
 #include <coco/util/memory.hpp>
+#include <coco/util/arena.h>
 #include <coco/util/logging.h>
+#include <coco/util/binary_log.h>
+#include <coco/util/histogram.h>
 #include <coco/util/timing.h>
+#include <coco/util/tracing.h>
+#include <coco/util/perf_counters.h>
 #include <coco/task_impl.hpp>
 #include <coco/connection_impl.hpp>
 #include <coco/execution.h>
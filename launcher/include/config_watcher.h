@@ -0,0 +1,58 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <atomic>
+#include <thread>
+
+namespace coco
+{
+
+/*! \brief Watches the xml files of the application with inotify and calls a function
+ *  when one of them changes. The directories are watched instead of the files, so
+ *  editors replacing the file on save are detected as well. Changes arriving close
+ *  together are notified once, at most one second after the first of them.
+ */
+class ConfigWatcher
+{
+public:
+    /*! \brief Called from the watcher thread after a change.
+     *  \return The files to watch from now on, empty to keep the current ones.
+     */
+    typedef std::function<std::vector<std::string>()> Callback;
+
+    explicit ConfigWatcher(Callback on_change);
+    ~ConfigWatcher();
+
+    /*! \brief Start watching the files on a new thread.
+     *  \return False if inotify is not available.
+     */
+    bool start(const std::vector<std::string> &files);
+    void stop();
+
+private:
+    void watch(const std::vector<std::string> &files);
+    void loop();
+
+    Callback on_change_;
+    int fd_ = -1;
+    std::unordered_map<int, std::string> directories_;  //!< Watch descriptor to directory
+    std::unordered_set<std::string> files_;
+    std::atomic<bool> stopping_ = {false};
+    std::thread thread_;
+};
+
+}  // end of namespace coco
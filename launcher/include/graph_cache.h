@@ -0,0 +1,60 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "graph_spec.h"
+
+namespace coco
+{
+
+/*! \brief Compiled form of the application graph.
+ *  Stores a TaskGraphSpec in a compact binary file together with the hash of the
+ *  content of every xml file read to build it, the main files and the includes.
+ *  When none of them changed the graph is loaded from the file, without parsing
+ *  the xml and looking for includes, libraries and resources in the paths.
+ */
+class GraphCache
+{
+public:
+    explicit GraphCache(const std::string &cache_file);
+
+    /*! \brief Load the graph if the cache was created from the same config files,
+     *  with the same COCO_PREFIX_PATH, and none of the xml files changed since.
+     *  \return False if the cache is missing, stale or invalid.
+     */
+    bool load(const std::vector<std::string> &config_files,
+              std::shared_ptr<TaskGraphSpec> app_spec);
+    /*! \brief Write the graph parsed from the config files.
+     *  \param xml_files All the xml files read by the parser, used to check freshness.
+     */
+    bool store(const std::vector<std::string> &config_files,
+               const std::vector<std::string> &xml_files,
+               const TaskGraphSpec &app_spec);
+    /*! \brief FNV-1a hash of the content of the file.
+     *  \return False if the file cannot be read, the cache is then not valid.
+     */
+    static bool hashFile(const std::string &file, uint64_t &hash);
+    /*!
+     * \return The xml files the loaded graph was built from.
+     */
+    const std::vector<std::string> & files() const { return files_; }
+
+private:
+    std::string cache_file_;
+    std::vector<std::string> files_;
+};
+
+}  // end of namespace coco
@@ -17,20 +17,61 @@
 
 #include "coco/register.h"
 #include "graph_spec.h"
+#include "startup_scheduler.h"
 
 namespace coco
 {
 
-class GraphLoader
+class GraphLoader : public GraphEditor
 {
 public:
     void loadGraph(std::shared_ptr<TaskGraphSpec> app_spec,
                    std::unordered_set<std::string> disabled_components);
     void enableProfiling(bool profiling);
+    /*! \brief Number of threads loading the libraries and creating and configuring
+     *  the tasks, 0 for one per core.
+     */
+    void setStartupThreads(unsigned threads) { startup_.setThreads(threads); }
+    /*!
+     * \return The time spent in every phase of loadGraph() and startApp().
+     */
+    std::string startupReport() const { return startup_.report(); }
+    /*! \brief Call onConfig() of the tasks on the startup threads instead of on the
+     *  threads of their activities. Faster when many tasks share an activity, but
+     *  onConfig() no longer runs on the thread that calls onUpdate().
+     */
+    void setParallelConfig(bool parallel) { parallel_config_ = parallel; }
+    /*! \brief Order the configuration of the tasks following configureAfter() and
+     *  configureAfterPort(). With the parallel configuration the tasks are configured
+     *  here by the startup threads, otherwise each activity configures its own tasks
+     *  in that order once started. Called by startApp() if not done before.
+     */
+    void configureTasks();
 	void startApp();
 	void waitToComplete();
     void terminateApp();
-
+    /*! \brief Apply to the running application the differences between the loaded graph
+     *  and an updated one: changed attributes are set and connections whose policy changed
+     *  are rebuilt, both through the pending operations of the tasks, so no activity is stopped.
+     *  Other changes require a restart and are only reported.
+     *  \return The number of attributes and connections changed.
+     */
+    unsigned applyChanges(const std::shared_ptr<TaskGraphSpec> &app_spec);
+
+    /* GraphEditor, usable once the application has been started */
+    bool addTask(const std::string &class_name, const std::string &instance_name,
+                 const std::string &library_name, const SchedulePolicy &policy) final;
+    bool removeTask(const std::string &instance_name) final;
+    bool connectPorts(const std::string &src_task, const std::string &src_port,
+                      const std::string &dest_task, const std::string &dest_port,
+                      const ConnectionPolicy &policy) final;
+    bool disconnectPorts(const std::string &src_task, const std::string &src_port,
+                         const std::string &dest_task, const std::string &dest_port) final;
+    bool startTask(const std::string &instance_name) final;
+    bool stopTask(const std::string &instance_name) final;
+
+    /*! \brief Write the drawing of the graph in filename.svg.
+     */
     void printGraph(const std::string& filename) const;
     std::string graphSvg() const;
     bool writeSvg(const std::string& filename) const;
@@ -40,24 +81,65 @@ private:
     void startActivity(std::unique_ptr<ActivitySpec> &activity_spec);
     void startPipeline(std::unique_ptr<PipelineSpec> &pipeline_spec);
     void startFarm(std::unique_ptr<FarmSpec> &farm_spec);
+    /*!
+     * \return The activities run by startApp(), only the first sequential one, which is last.
+     */
+    std::vector<std::shared_ptr<Activity> > startedActivities() const;
+    typedef std::unordered_map<std::string, std::shared_ptr<TaskContext>> TaskMap;
+
+    /*! \brief Load the libraries and create the tasks of all the activities, pipelines
+     *  and farms in parallel, before building the activities.
+     */
+    void instantiateTasks();
     bool loadTask(std::shared_ptr<TaskSpec> &task_spec, std::shared_ptr<TaskContext> &task_owner);
+    /*! \brief Create the task with its peers and call its init(), adding all of them to tasks.
+     */
+    bool createTask(const std::shared_ptr<TaskSpec> &task_spec,
+                    const std::shared_ptr<TaskContext> &task_owner, TaskMap &tasks);
+
     void makeConnection(std::unique_ptr<ConnectionSpec> &connection_spec);
+    void connectionPorts(const ConnectionSpec &connection_spec,
+                         const std::shared_ptr<TaskContext> &src_task,
+                         const std::shared_ptr<TaskContext> &dest_task,
+                         std::shared_ptr<PortBase> &left,
+                         std::shared_ptr<PortBase> &right) const;
+    /*!
+     * \return The task whose activity executes the given task, the task itself or the owner of a peer.
+     */
+    static std::shared_ptr<TaskContext> executingTask(std::shared_ptr<TaskContext> task);
+    unsigned reloadAttributes(TaskSpec &task_spec, const TaskSpec &updated,
+                              const std::shared_ptr<TaskContext> &task);
+    /*!
+     * \return For each task of the farm pipelines, with its peers, the specs cloned by
+     *  startFarm() for the other workers.
+     */
+    std::unordered_map<std::string, std::vector<std::shared_ptr<TaskSpec> > > farmClones() const;
+    bool rebuildConnection(ConnectionSpec &connection_spec, const ConnectionPolicySpec &policy_spec);
 
 	void checkTaskConnections() const;
+    /*!
+     * \return The connection between the two ports, null if they are not connected.
+     */
+    static std::shared_ptr<ConnectionBase> findConnection(const std::shared_ptr<PortBase> &left,
+                                                          const std::shared_ptr<PortBase> &right);
+    std::shared_ptr<TaskContext> editedTask(const std::string &instance_name) const;
 
-    void createGraphPort(std::shared_ptr<PortBase> port, std::ofstream &dot_file,
-                         std::unordered_map<std::string, int> &graph_port_nodes,
-                         int &node_count) const;
-    void createGraphPeer(std::shared_ptr<TaskContext> peer, std::ofstream &dot_file,
-                         std::unordered_map<std::string, int> &graph_port_nodes,
-                         int &subgraph_count, int &node_count) const;
-    void createGraphConnection(std::shared_ptr<TaskContext> & task, std::ofstream &dot_file,
-                               std::unordered_map<std::string, int> &graph_port_nodes) const;
+    /*! \brief Invalidate the drawings and the telemetry of the graph after an edit.
+     */
+    void graphChanged() const;
 
 private:
 	std::shared_ptr<TaskGraphSpec> app_spec_;
-
-    std::unordered_map<std::string, std::shared_ptr<TaskContext>> tasks_;
+    /// Connections read from the config, the following ones are added by startFarm()
+    std::size_t declared_connections_ = 0;
+
+    TaskMap tasks_;
+    /// Created by instantiateTasks(), for each task the task itself and its peers
+    std::unordered_map<std::string, TaskMap> instantiated_;
+    std::mutex instantiated_mutex_;
+    StartupScheduler startup_;
+    bool parallel_config_ = false;
+    bool tasks_configured_ = false;  //!< configureTasks() already called
     std::vector<std::shared_ptr<Activity>> activities_;
 
     std::list<std::string> peers_;
@@ -65,6 +147,8 @@ private:
 	std::unordered_set<int> assigned_core_id_;
 
     std::unordered_set<std::string> disabled_components_;
+    /// Serializes the GraphEditor functions
+    std::mutex edit_mutex_;
 };
 
 }
@@ -66,6 +66,8 @@ struct SchedulePolicySpec
 	int priority = 0;
 	int runtime = 0;
 	bool exclusive = false;
+	bool lock_memory = false;
+	int prefault_kb = 2048;
 };
 
 struct ActivityBase
@@ -126,6 +128,7 @@ struct TaskGraphSpec
     std::vector<std::unique_ptr<ConnectionSpec> > connections;
 
 	std::vector<std::string> resources_paths;
+	std::string log_config = ""; // <log> element of the main file, applied also when loaded from the cache
 
 	// TODO: add exported attribute and external ports
 	std::vector<std::shared_ptr<ExportedAttributeSpec> > exported_attributes;
@@ -28,14 +28,32 @@ public:
                 ("profiling,p", boost::program_options::value<int>()->implicit_value(5),
                     "Enable the collection of statistics of the executions. Use only during debug as it slow down the performances.")
                 ("graph,g", boost::program_options::value<std::string>(),
-                        "Create the graph of the various components and of their connections.")
+                        "Draw the graph of the various components and of their connections in the given file, with the .svg extension.")
                 ("xml_template,t", boost::program_options::value<std::string>(),
                         "Print the xml template for all the components contained in the library.")
                 ("web_server,w", boost::program_options::value<int>()->implicit_value(7707),
                         "Instantiate a web server that allows to view statics about the executions.")
 				("web_root,r", boost::program_options::value<std::string>(), "set document root for web server")
+                ("web_update,u", boost::program_options::value<int>(),
+                    "Milliseconds between the updates that the web server sends to the open pages, only what changed is sent. Default 200.")
                 ("latency,l", boost::program_options::value<std::vector<std::string> >()->multitoken(),
-                    "Set the two task between which calculate the latency. Peer are not valid.");
+                    "Set pairs of source and target task between which calculate the latency. Peer are not valid.")
+                ("perf_counters,c",
+                    "Collect cycles, instructions, cache misses and context switches for every task step. Used together with --profiling.")
+                ("trace,T", boost::program_options::value<std::string>(),
+                    "Record the execution events and write them at exit in the given file in Chrome trace format.")
+                ("startup_threads,j", boost::program_options::value<int>(),
+                    "Number of threads loading the libraries and creating the components at startup, and configuring them with --parallel_config. Default one per core.")
+                ("parallel_config,P",
+                    "Call onConfig() of all the components on the startup threads before starting the activities, instead of on the thread of each activity.")
+                ("graph_edit,E",
+                    "Let the web server add, remove, connect, start and stop tasks with POST /graph/ requests. The requests are not authenticated and can load any library, use it only on trusted networks.")
+                ("watch,W",
+                    "Watch the xml files and apply changed attributes and connection policies without restarting.")
+                ("graph_cache,C", boost::program_options::value<std::string>(),
+                    "Binary file caching the parsed graph. Loaded instead of the xml files when none of them changed, written otherwise.")
+                ("telemetry,m", boost::program_options::value<std::string>()->implicit_value("coco"),
+                    "Publish the statistics of tasks and connections in the shared memory segment with the given name, read by coco_monitor.");
 
         boost::program_options::store(boost::program_options::command_line_parser(argc_, argv_).
                 options(description_).run(), vm_);
@@ -0,0 +1,97 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+
+#include <string>
+#include <exception>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace coco
+{
+
+/*! \brief Executes the startup jobs of the application on a pool of threads.
+ *  Each job runs as soon as all the jobs it depends on are completed, so that
+ *  e.g. a task is created as soon as its library is loaded while other libraries
+ *  are still loading. Every job belongs to a phase and the time of each job is
+ *  recorded to report where the startup time goes.
+ */
+class StartupScheduler
+{
+public:
+    typedef std::size_t JobId;
+
+    /*! \param threads Number of threads executing the jobs, 0 for one per core.
+     */
+    explicit StartupScheduler(unsigned threads = 0);
+
+    void setThreads(unsigned threads);
+    /*! \brief Add a job, executed by the next run() after all its dependencies.
+     *  \param phase Name of the phase the job belongs to, used in the report.
+     *  \param name Name of the job, e.g. the task or library it works on.
+     */
+    JobId add(const std::string &phase, const std::string &name,
+              std::function<void()> fx,
+              const std::vector<JobId> &dependencies = std::vector<JobId>());
+    /*! \brief Execute all the jobs added since the last run and wait for them.
+     *  A job throwing an exception fails, and the jobs depending on it are not executed.
+     *  \return False if any job failed, see errors().
+     */
+    bool run();
+    /*!
+     * \return One line for each job failed in the last run, with its phase, name and error.
+     */
+    std::string errors() const;
+    /*! \brief Record a step executed outside the scheduler, e.g. sequential work.
+     *  \param start Start time in us, as returned by util::time().
+     */
+    void record(const std::string &phase, const std::string &name, int long start);
+    /*!
+     * \return For every phase the number of jobs, the wall time, the sum of the
+     * job times and the slowest job.
+     */
+    std::string report() const;
+
+private:
+    struct Job
+    {
+        std::string phase;
+        std::string name;
+        std::function<void()> fx;
+        std::vector<JobId> dependents;
+        unsigned pending = 0;  //!< Dependencies not completed yet
+        bool done = false;
+        bool failed = false;   //!< Threw an exception or one of its dependencies failed
+        std::string error;
+        int long start = 0;
+        int long end = 0;
+    };
+
+    void worker();
+    /*! \brief Execute the job, catching what it throws.
+     */
+    static void execute(Job &job);
+
+    unsigned threads_;
+    std::vector<Job> jobs_;
+    std::size_t first_pending_ = 0;  //!< First job not executed by a run()
+    std::size_t run_begin_ = 0;      //!< First job of the last run()
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<JobId> ready_;
+    std::size_t remaining_ = 0;
+};
+
+}  // end of namespace coco
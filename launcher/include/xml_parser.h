@@ -26,6 +26,13 @@ public:
 				   std::shared_ptr<TaskGraphSpec> app_spec, bool first = true);
 	bool createXML(const std::string &xml_file,
 				   std::shared_ptr<TaskGraphSpec> app_spec);
+	/*! \brief Initialize the logger from the <log> element stored in TaskGraphSpec::log_config.
+	 */
+	void applyLogConfig(const std::string &log_config);
+	/*!
+	 * \return All the xml files read so far, main files and includes.
+	 */
+	const std::vector<std::string> & parsedFiles() const { return parsed_files_; }
 	
 private:
 	void parseLogConfig(tinyxml2::XMLElement *logconfig);
@@ -68,6 +75,7 @@ private:
 
 	std::vector<std::string> resources_paths_;
     std::vector<std::string> libraries_paths_;
+    std::vector<std::string> parsed_files_;
 };
 
 }
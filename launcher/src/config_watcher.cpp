@@ -0,0 +1,171 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "coco/util/logging.h"
+#include "config_watcher.h"
+
+namespace coco
+{
+
+namespace
+{
+const int DEBOUNCE_MS = 200;  //!< Quiet time after the last change before notifying
+const int MAX_DELAY_MS = 1000;  //!< Notify at most this long after the first change
+}  // end of anonymous namespace
+
+ConfigWatcher::ConfigWatcher(Callback on_change)
+    : on_change_(on_change)
+{}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+#ifdef __linux__
+
+bool ConfigWatcher::start(const std::vector<std::string> &files)
+{
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0)
+    {
+        COCO_ERR() << "Failed to initialize inotify, config files are not watched";
+        return false;
+    }
+    watch(files);
+    thread_ = std::thread(&ConfigWatcher::loop, this);
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    stopping_ = true;
+    /* The signal stopping the launcher can be delivered to the watcher thread */
+    if (thread_.joinable())
+    {
+        if (thread_.get_id() == std::this_thread::get_id())
+            thread_.detach();
+        else
+            thread_.join();
+    }
+    if (fd_ >= 0)
+        close(fd_);
+    fd_ = -1;
+}
+
+void ConfigWatcher::watch(const std::vector<std::string> &files)
+{
+    files_.clear();
+    for (auto & file : files)
+    {
+        auto separator = file.find_last_of('/');
+        std::string directory = separator == std::string::npos ? "." : file.substr(0, separator + 1);
+        std::string name = separator == std::string::npos ? file : file.substr(separator + 1);
+
+        char resolved[PATH_MAX];
+        if (!realpath(directory.c_str(), resolved))
+        {
+            COCO_ERR() << "Cannot watch " << file;
+            continue;
+        }
+        int wd = inotify_add_watch(fd_, resolved, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0)
+        {
+            COCO_ERR() << "Cannot watch " << file;
+            continue;
+        }
+        directories_[wd] = resolved;
+        files_.insert(std::string(resolved) + "/" + name);
+        COCO_DEBUG("ConfigWatcher") << "Watching " << resolved << "/" << name;
+    }
+}
+
+void ConfigWatcher::loop()
+{
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+    std::chrono::steady_clock::time_point deadline;
+    while (!stopping_)
+    {
+        int timeout = DEBOUNCE_MS;
+        if (changed)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            timeout = static_cast<int>(std::max<long long>(0, std::min<long long>(timeout, left)));
+        }
+        pollfd pfd = {fd_, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0)
+            continue;
+
+        ssize_t length;
+        while (ready > 0 && (length = read(fd_, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *p = buffer; p < buffer + length; )
+            {
+                auto event = reinterpret_cast<const inotify_event *>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->len == 0)
+                    continue;
+                auto directory = directories_.find(event->wd);
+                if (directory == directories_.end())
+                    continue;
+                if (!files_.count(directory->second + "/" + event->name))
+                    continue;
+                if (!changed)
+                    deadline = std::chrono::steady_clock::now() +
+                               std::chrono::milliseconds(MAX_DELAY_MS);
+                changed = true;
+            }
+        }
+
+        /* Quiet for DEBOUNCE_MS, or changing for too long to wait any more */
+        if (changed && (ready == 0 || std::chrono::steady_clock::now() >= deadline))
+        {
+            changed = false;
+            auto files = on_change_();
+            if (!files.empty())
+                watch(files);
+        }
+    }
+}
+
+#else
+
+bool ConfigWatcher::start(const std::vector<std::string> &files)
+{
+    COCO_ERR() << "Watching the config files is supported only on Linux";
+    return false;
+}
+
+void ConfigWatcher::stop()
+{}
+
+void ConfigWatcher::watch(const std::vector<std::string> &files)
+{}
+
+void ConfigWatcher::loop()
+{}
+
+#endif
+
+}  // end of namespace coco
@@ -0,0 +1,568 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#include "coco/util/logging.h"
+#include "graph_cache.h"
+
+namespace coco
+{
+
+namespace
+{
+const char MAGIC[8] = {'C', 'O', 'C', 'O', 'G', 'R', 'F', '\0'};
+const uint32_t VERSION = 2;
+const uint32_t NO_TASK = 0xffffffff;
+
+/*! \brief Appends little endian integers and length prefixed strings to a buffer.
+ */
+class Writer
+{
+public:
+    void u8(uint8_t v) { data_.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            u8(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void u64(uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            u8(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void i32(int v) { u32(static_cast<uint32_t>(v)); }
+    void str(const std::string &s)
+    {
+        u32(static_cast<uint32_t>(s.size()));
+        data_.append(s);
+    }
+    void strings(const std::vector<std::string> &v)
+    {
+        u32(static_cast<uint32_t>(v.size()));
+        for (auto &s : v)
+            str(s);
+    }
+    void raw(const char *p, std::size_t size) { data_.append(p, size); }
+    const std::string & data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+/*! \brief Reads back what Writer produced. Reading past the end sets the failure
+ *  flag and returns zeros, so the caller checks ok() once at the end.
+ */
+class Reader
+{
+public:
+    explicit Reader(const std::string &data)
+        : data_(data)
+    {}
+    bool ok() const { return ok_; }
+    void fail() { ok_ = false; }
+    uint8_t u8()
+    {
+        if (!check(1))
+            return 0;
+        return static_cast<uint8_t>(data_[pos_++]);
+    }
+    uint32_t u32()
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<uint32_t>(u8()) << (8 * i);
+        return v;
+    }
+    uint64_t u64()
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= static_cast<uint64_t>(u8()) << (8 * i);
+        return v;
+    }
+    int i32() { return static_cast<int>(u32()); }
+    std::string str()
+    {
+        uint32_t size = u32();
+        if (!check(size))
+            return "";
+        std::string s = data_.substr(pos_, size);
+        pos_ += size;
+        return s;
+    }
+    std::vector<std::string> strings()
+    {
+        std::vector<std::string> v(count());
+        for (auto &s : v)
+            s = str();
+        return v;
+    }
+    /*! \brief Read a number of elements, bounded by the remaining bytes.
+     */
+    uint32_t count()
+    {
+        uint32_t n = u32();
+        if (n > data_.size() - pos_)
+        {
+            ok_ = false;
+            return 0;
+        }
+        return n;
+    }
+    bool raw(const char *p, std::size_t size)
+    {
+        if (!check(size) || std::memcmp(data_.data() + pos_, p, size) != 0)
+            return ok_ = false;
+        pos_ += size;
+        return true;
+    }
+
+private:
+    bool check(std::size_t size)
+    {
+        if (ok_ && size <= data_.size() - pos_)
+            return true;
+        ok_ = false;
+        return false;
+    }
+
+    const std::string &data_;
+    std::size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+std::string prefixPath()
+{
+    const char *prefix = std::getenv("COCO_PREFIX_PATH");
+    return prefix ? prefix : "";
+}
+
+bool fileExists(const std::string &file)
+{
+    struct stat st;
+    return ::stat(file.c_str(), &st) == 0;
+}
+
+/*! \brief Tasks are shared between the task map, the peers, the connections and the
+ *  activities: they are written once in a table and referenced by index.
+ */
+class TaskTable
+{
+public:
+    uint32_t add(const std::shared_ptr<TaskSpec> &task)
+    {
+        if (!task)
+            return NO_TASK;
+        auto it = index_.find(task.get());
+        if (it != index_.end())
+            return it->second;
+        uint32_t id = static_cast<uint32_t>(tasks_.size());
+        index_[task.get()] = id;
+        tasks_.push_back(task);
+        for (auto &peer : task->peers)
+            add(peer);
+        return id;
+    }
+    uint32_t id(const std::shared_ptr<TaskSpec> &task) const
+    {
+        return task ? index_.at(task.get()) : NO_TASK;
+    }
+    const std::vector<std::shared_ptr<TaskSpec> > & tasks() const { return tasks_; }
+
+private:
+    std::unordered_map<const TaskSpec *, uint32_t> index_;
+    std::vector<std::shared_ptr<TaskSpec> > tasks_;
+};
+
+void writeTasks(Writer &w, const TaskTable &table, const std::vector<std::shared_ptr<TaskSpec> > &tasks)
+{
+    w.u32(static_cast<uint32_t>(tasks.size()));
+    for (auto &task : tasks)
+        w.u32(table.id(task));
+}
+
+void writeSchedule(Writer &w, const SchedulePolicySpec &policy)
+{
+    w.str(policy.type);
+    w.str(policy.realtime);
+    w.i32(policy.period);
+    w.i32(policy.affinity);
+    w.i32(policy.priority);
+    w.i32(policy.runtime);
+    w.u8(policy.exclusive);
+    w.u8(policy.lock_memory);
+    w.i32(policy.prefault_kb);
+}
+
+void writePipeline(Writer &w, const TaskTable &table, const PipelineSpec &pipeline)
+{
+    writeTasks(w, table, pipeline.tasks);
+    w.strings(pipeline.out_ports);
+    w.strings(pipeline.in_ports);
+    w.u8(pipeline.parallel);
+}
+
+void writeGraph(Writer &w, const TaskGraphSpec &spec)
+{
+    TaskTable table;
+    for (auto &task : spec.tasks)
+        table.add(task.second);
+    for (auto &connection : spec.connections)
+    {
+        table.add(connection->src_task);
+        table.add(connection->dest_task);
+    }
+    for (auto &activity : spec.activities)
+        for (auto &task : activity->tasks)
+            table.add(task);
+    for (auto &pipeline : spec.pipelines)
+        for (auto &task : pipeline->tasks)
+            table.add(task);
+    for (auto &farm : spec.farms)
+    {
+        table.add(farm->source_task);
+        table.add(farm->gather_task);
+        for (auto &pipeline : farm->pipelines)
+            for (auto &task : pipeline->tasks)
+                table.add(task);
+    }
+
+    w.str(spec.name);
+    w.str(spec.log_config);
+    w.strings(spec.resources_paths);
+
+    w.u32(static_cast<uint32_t>(table.tasks().size()));
+    for (auto &task : table.tasks())
+    {
+        w.str(task->name);
+        w.str(task->instance_name);
+        w.str(task->library_name);
+        w.u8(task->is_peer);
+        w.u32(static_cast<uint32_t>(task->attributes.size()));
+        for (auto &attribute : task->attributes)
+        {
+            w.str(attribute.name);
+            w.str(attribute.value);
+        }
+        w.u32(static_cast<uint32_t>(task->contents.size()));
+        for (auto &content : task->contents)
+        {
+            w.str(content.first);
+            w.str(content.second);
+        }
+    }
+    for (auto &task : table.tasks())
+        writeTasks(w, table, task->peers);
+
+    w.u32(static_cast<uint32_t>(spec.tasks.size()));
+    for (auto &task : spec.tasks)
+    {
+        w.str(task.first);
+        w.u32(table.id(task.second));
+    }
+
+    w.u32(static_cast<uint32_t>(spec.connections.size()));
+    for (auto &connection : spec.connections)
+    {
+        w.u32(table.id(connection->src_task));
+        w.str(connection->src_port);
+        w.u32(table.id(connection->dest_task));
+        w.str(connection->dest_port);
+        w.str(connection->policy.data);
+        w.str(connection->policy.policy);
+        w.str(connection->policy.transport);
+        w.str(connection->policy.buffersize);
+    }
+
+    w.u32(static_cast<uint32_t>(spec.activities.size()));
+    for (auto &activity : spec.activities)
+    {
+        writeSchedule(w, activity->policy);
+        w.u8(activity->is_parallel);
+        writeTasks(w, table, activity->tasks);
+    }
+
+    w.u32(static_cast<uint32_t>(spec.pipelines.size()));
+    for (auto &pipeline : spec.pipelines)
+        writePipeline(w, table, *pipeline);
+
+    w.u32(static_cast<uint32_t>(spec.farms.size()));
+    for (auto &farm : spec.farms)
+    {
+        w.u32(static_cast<uint32_t>(farm->pipelines.size()));
+        for (auto &pipeline : farm->pipelines)
+            writePipeline(w, table, *pipeline);
+        w.u32(table.id(farm->source_task));
+        writeSchedule(w, farm->source_task_schedule);
+        w.str(farm->source_port);
+        w.u32(table.id(farm->gather_task));
+        w.str(farm->gather_port);
+        w.u32(farm->num_workers);
+    }
+}
+
+std::shared_ptr<TaskSpec> readTask(Reader &r, const std::vector<std::shared_ptr<TaskSpec> > &table)
+{
+    uint32_t id = r.u32();
+    if (id == NO_TASK)
+        return nullptr;
+    if (id >= table.size())
+    {
+        r.fail();
+        return nullptr;
+    }
+    return table[id];
+}
+
+std::vector<std::shared_ptr<TaskSpec> > readTasks(Reader &r, const std::vector<std::shared_ptr<TaskSpec> > &table)
+{
+    std::vector<std::shared_ptr<TaskSpec> > tasks(r.count());
+    for (auto &task : tasks)
+        task = readTask(r, table);
+    return tasks;
+}
+
+void readSchedule(Reader &r, SchedulePolicySpec &policy)
+{
+    policy.type = r.str();
+    policy.realtime = r.str();
+    policy.period = r.i32();
+    policy.affinity = r.i32();
+    policy.priority = r.i32();
+    policy.runtime = r.i32();
+    policy.exclusive = r.u8() != 0;
+    policy.lock_memory = r.u8() != 0;
+    policy.prefault_kb = r.i32();
+}
+
+std::unique_ptr<PipelineSpec> readPipeline(Reader &r, const std::vector<std::shared_ptr<TaskSpec> > &table)
+{
+    std::unique_ptr<PipelineSpec> pipeline(new PipelineSpec);
+    pipeline->tasks = readTasks(r, table);
+    pipeline->out_ports = r.strings();
+    pipeline->in_ports = r.strings();
+    pipeline->parallel = r.u8() != 0;
+    return pipeline;
+}
+
+bool readGraph(Reader &r, TaskGraphSpec &spec)
+{
+    spec.name = r.str();
+    spec.log_config = r.str();
+    spec.resources_paths = r.strings();
+
+    std::vector<std::shared_ptr<TaskSpec> > table(r.count());
+    for (auto &task : table)
+    {
+        task = std::make_shared<TaskSpec>();
+        task->name = r.str();
+        task->instance_name = r.str();
+        task->library_name = r.str();
+        task->is_peer = r.u8() != 0;
+        task->attributes.resize(r.count());
+        for (auto &attribute : task->attributes)
+        {
+            attribute.name = r.str();
+            attribute.value = r.str();
+        }
+        uint32_t contents = r.count();
+        for (uint32_t i = 0; i < contents; ++i)
+        {
+            std::string name = r.str();
+            task->contents[name] = r.str();
+        }
+    }
+    for (auto &task : table)
+        task->peers = readTasks(r, table);
+
+    uint32_t tasks = r.count();
+    for (uint32_t i = 0; i < tasks; ++i)
+    {
+        std::string name = r.str();
+        spec.tasks[name] = readTask(r, table);
+    }
+
+    uint32_t connections = r.count();
+    for (uint32_t i = 0; i < connections; ++i)
+    {
+        std::unique_ptr<ConnectionSpec> connection(new ConnectionSpec);
+        connection->src_task = readTask(r, table);
+        connection->src_port = r.str();
+        connection->dest_task = readTask(r, table);
+        connection->dest_port = r.str();
+        connection->policy.data = r.str();
+        connection->policy.policy = r.str();
+        connection->policy.transport = r.str();
+        connection->policy.buffersize = r.str();
+        spec.connections.push_back(std::move(connection));
+    }
+
+    uint32_t activities = r.count();
+    for (uint32_t i = 0; i < activities; ++i)
+    {
+        std::unique_ptr<ActivitySpec> activity(new ActivitySpec);
+        readSchedule(r, activity->policy);
+        activity->is_parallel = r.u8() != 0;
+        activity->tasks = readTasks(r, table);
+        spec.activities.push_back(std::move(activity));
+    }
+
+    uint32_t pipelines = r.count();
+    for (uint32_t i = 0; i < pipelines; ++i)
+        spec.pipelines.push_back(readPipeline(r, table));
+
+    uint32_t farms = r.count();
+    for (uint32_t i = 0; i < farms; ++i)
+    {
+        std::unique_ptr<FarmSpec> farm(new FarmSpec);
+        uint32_t farm_pipelines = r.count();
+        for (uint32_t j = 0; j < farm_pipelines; ++j)
+            farm->pipelines.push_back(readPipeline(r, table));
+        farm->source_task = readTask(r, table);
+        readSchedule(r, farm->source_task_schedule);
+        farm->source_port = r.str();
+        farm->gather_task = readTask(r, table);
+        farm->gather_port = r.str();
+        farm->num_workers = r.u32();
+        spec.farms.push_back(std::move(farm));
+    }
+
+    if (!r.ok())
+        return false;
+    for (auto &task : table)
+    {
+        if (!task->library_name.empty() && !fileExists(task->library_name))
+        {
+            COCO_DEBUG("GraphCache") << "Library " << task->library_name << " moved";
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // end of anonymous namespace
+
+GraphCache::GraphCache(const std::string &cache_file)
+    : cache_file_(cache_file)
+{}
+
+bool GraphCache::hashFile(const std::string &file, uint64_t &hash)
+{
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream.is_open())
+        return false;
+    hash = 14695981039346656037ULL;
+    char buffer[4096];
+    while (stream)
+    {
+        stream.read(buffer, sizeof(buffer));
+        for (std::streamsize i = 0; i < stream.gcount(); ++i)
+        {
+            hash ^= static_cast<uint8_t>(buffer[i]);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return !stream.bad();
+}
+
+bool GraphCache::load(const std::vector<std::string> &config_files,
+                      std::shared_ptr<TaskGraphSpec> app_spec)
+{
+    std::ifstream stream(cache_file_, std::ios::binary);
+    if (!stream.is_open())
+        return false;
+    std::stringstream ss;
+    ss << stream.rdbuf();
+    std::string data = ss.str();
+
+    Reader r(data);
+    if (!r.raw(MAGIC, sizeof(MAGIC)) || r.u32() != VERSION)
+    {
+        COCO_DEBUG("GraphCache") << cache_file_ << " is not a graph cache of this version";
+        return false;
+    }
+    if (r.strings() != config_files || r.str() != prefixPath())
+    {
+        COCO_DEBUG("GraphCache") << cache_file_ << " was created for different config files";
+        return false;
+    }
+    std::vector<std::string> xml_files(r.count());
+    for (auto & file : xml_files)
+    {
+        file = r.str();
+        uint64_t hash = r.u64();
+        uint64_t current = 0;
+        if (!r.ok() || !hashFile(file, current) || current != hash)
+        {
+            COCO_DEBUG("GraphCache") << file << " changed since the cache was created";
+            return false;
+        }
+    }
+
+    TaskGraphSpec spec;
+    if (!readGraph(r, spec))
+    {
+        COCO_DEBUG("GraphCache") << cache_file_ << " is invalid";
+        return false;
+    }
+    *app_spec = std::move(spec);
+    files_ = xml_files;
+    return true;
+}
+
+bool GraphCache::store(const std::vector<std::string> &config_files,
+                       const std::vector<std::string> &xml_files,
+                       const TaskGraphSpec &app_spec)
+{
+    Writer w;
+    w.raw(MAGIC, sizeof(MAGIC));
+    w.u32(VERSION);
+    w.strings(config_files);
+    w.str(prefixPath());
+    w.u32(static_cast<uint32_t>(xml_files.size()));
+    for (auto &file : xml_files)
+    {
+        uint64_t hash = 0;
+        if (!hashFile(file, hash))
+        {
+            COCO_DEBUG("GraphCache") << "Cannot read " << file << ", the graph is not cached";
+            return false;
+        }
+        w.str(file);
+        w.u64(hash);
+    }
+    writeGraph(w, app_spec);
+
+    // Write and rename, so a concurrent launcher never reads a partial file
+    std::string tmp_file = cache_file_ + ".tmp";
+    {
+        std::ofstream stream(tmp_file, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open())
+            return false;
+        stream.write(w.data().data(), w.data().size());
+        if (!stream)
+            return false;
+    }
+    if (std::rename(tmp_file.c_str(), cache_file_.c_str()) != 0)
+    {
+        std::remove(tmp_file.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // end of namespace coco
@@ -19,20 +19,26 @@
 #include "xml_parser.h"
 #include "library_parser.h"
 #include "graph_loader.h"
+#include "graph_cache.h"
+#include "config_watcher.h"
 #include "input_parser.h"
 
 #include "coco/util/timing.h"
+#include "coco/util/tracing.h"
+#include "coco/util/binary_log.h"
 #include "coco/util/accesses.hpp"
 #include "coco/web_server/web_server.h"
+#include "coco/telemetry.h"
 #include "coco/register.h"
 
 std::shared_ptr<coco::GraphLoader> loader;
+std::unique_ptr<coco::ConfigWatcher> watcher;
+std::string trace_file;
 
 std::atomic<bool> stop_execution =
 { false };
-std::mutex launcher_mutex, statistics_mutex;
-std::condition_variable launcher_condition_variable,
-		statistics_condition_variable;
+std::mutex statistics_mutex;
+std::condition_variable statistics_condition_variable;
 
 void handler(int sig)
 {
@@ -50,13 +56,32 @@ void handler(int sig)
 	exit(1);
 }
 
+/* Only flags the stop, the application is torn down by waitTermination() */
 void terminate(int sig)
 {
+	stop_execution = true;
+}
+
+/*! \brief Wait for SIGINT and tear down the application outside of the signal handler.
+ *  Runs on its own thread, because the first sequential activity runs on the main thread.
+ */
+void waitTermination()
+{
+	while (!stop_execution)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	if (!trace_file.empty())
+	{
+		coco::util::Tracer::instance().disable();
+		if (!coco::util::Tracer::instance().dump(trace_file))
+			COCO_ERR() << "Failed to write the execution trace in: " << trace_file;
+	}
+	coco::util::BinaryLog::instance().close();
+	coco::Telemetry::stop();
+	/* No reload may edit the graph while it is torn down */
+	if (watcher)
+		watcher->stop();
 	if (loader)
 		loader->terminateApp();
-
-	stop_execution = true;
-	launcher_condition_variable.notify_all();
 	statistics_condition_variable.notify_all();
 }
 
@@ -70,7 +95,27 @@ void printStatistics(int interval)
 			if (coco::isPeer(task.second))
             	continue;
 			std::cout << "Task: " << task.first << std::endl;
-			std::cout << task.second->timeStatistics().toString() << std::endl;
+			std::cout << task.second->timeStatistics().toString();
+			auto perf = task.second->perfStatistics();
+			if (perf.steps > 0 && perf.available != 0)
+				std::cout << "\tCounters: " << perf.toString() << std::endl;
+			auto memory = task.second->memoryStatistics();
+			if (memory.allocations > 0 || memory.live_bytes > 0)
+				std::cout << "\tMemory: " << memory.toString() << std::endl;
+			for (auto &port : task.second->ports())
+			{
+				if (port.second->isOutput() || port.second->connectionsCount() == 0)
+					continue;
+				std::cout << "\tBuffers of " << port.first << " connections: "
+						  << port.second->bufferStatistics().toString() << std::endl;
+			}
+			for (auto &path : task.second->latencyStatistics())
+			{
+				std::cout << "\tLatency from " << path.source << ": " << path.latency.toString() << std::endl;
+				std::cout << "\t\tQueue   : " << path.queue.toString() << std::endl;
+				std::cout << "\t\tCompute : " << path.compute.toString() << std::endl;
+			}
+			std::cout << std::endl;
 		}
 
         std::unique_lock<std::mutex> mlock(statistics_mutex);
@@ -78,37 +123,74 @@ void printStatistics(int interval)
 	}
 }
 
+std::vector<std::string> reloadConfig(const std::vector<std::string> & config_files_path)
+{
+	std::shared_ptr<coco::TaskGraphSpec> graph_spec(new coco::TaskGraphSpec());
+	coco::XmlParser parser;
+	for(auto & x : config_files_path)
+	{
+		if (!parser.parseFile(x, graph_spec, false))
+		{
+			COCO_ERR() << "Failed Parsing " << x << ", changes not applied";
+			return std::vector<std::string>();
+		}
+	}
+	unsigned changes = loader->applyChanges(graph_spec);
+	std::cout << "Configuration reloaded, " << changes << " attributes and connections changed" << std::endl;
+	return parser.parsedFiles();
+}
+
 void launchApp(const std::vector<std::string> & config_files_path, bool profiling,
 		const std::string &graph, int web_server_port,
-		const std::string& web_server_root,
+		const std::string& web_server_root, int web_update_ms,
 		std::unordered_set<std::string> disabled_component,
-	    std::vector<std::string> latency)
+	    std::vector<std::string> latency, int startup_threads,
+	    const std::string &graph_cache, bool watch, const std::string &telemetry,
+	    bool graph_edit, bool parallel_config)
 {
 	std::shared_ptr<coco::TaskGraphSpec> graph_spec(new coco::TaskGraphSpec());
 	coco::XmlParser parser;
-	bool first = true;
-	for(auto & x : config_files_path)
+	coco::GraphCache cache(graph_cache);
+	std::vector<std::string> xml_files;
+	if (!graph_cache.empty() && cache.load(config_files_path, graph_spec))
 	{
-		if (!parser.parseFile(x, graph_spec,first))
+		parser.applyLogConfig(graph_spec->log_config);
+		COCO_DEBUG("GraphLauncher") << "Loaded graph from cache " << graph_cache;
+		xml_files = cache.files();
+	}
+	else
+	{
+		bool first = true;
+		for(auto & x : config_files_path)
 		{
-			std::cerr  << "Failed Parsing " << x << " abort " << std::endl;
-			exit(-1);
+			if (!parser.parseFile(x, graph_spec,first))
+			{
+				std::cerr  << "Failed Parsing " << x << " abort " << std::endl;
+				exit(-1);
+			}
+			first = true;
 		}
-		first = true;
+		if (!graph_cache.empty() &&
+			!cache.store(config_files_path, parser.parsedFiles(), *graph_spec))
+			COCO_ERR() << "Failed to write the graph cache " << graph_cache;
+		xml_files = parser.parsedFiles();
 	}
 
 	loader = std::make_shared<coco::GraphLoader>();
+	loader->setStartupThreads(startup_threads);
+	loader->setParallelConfig(parallel_config);
 	loader->loadGraph(graph_spec, disabled_component);
 
 	loader->enableProfiling(profiling);
 
-	if (latency.size() != 0)
+	for (unsigned i = 0; i + 1 < latency.size(); i += 2)
 	{
-		auto src_task = COCO_TASK(latency[0]);
-		auto dst_task = COCO_TASK(latency[1]);
+		auto src_task = COCO_TASK(latency[i]);
+		auto dst_task = COCO_TASK(latency[i + 1]);
 
 		if ((!src_task || !dst_task) || (coco::isPeer(src_task) || coco::isPeer(dst_task)))
-			COCO_FATAL() << "To use latency specify the name of two valid task.";
+			COCO_FATAL() << "To use latency specify the name of two valid task: "
+						 << latency[i] << " " << latency[i + 1];
 
 		src_task->setTaskLatencySource();
 		dst_task->setTaskLatencyTarget();
@@ -119,24 +201,41 @@ void launchApp(const std::vector<std::string> & config_files_path, bool profilin
 
 	if (web_server_port > 0)
 	{
-		std::string graph_svg = loader->graphSvg();
         COCO_DEBUG("GraphLauncher") << "Starting web server on " << web_server_port;
-		if (graph_svg.empty())
-		{
-            COCO_ERR() << "Failed to create svg graph from execution setup";
-		}
+		/* The web server draws the graph itself and again when it is edited */
 		if (!coco::WebServer::start(web_server_port, graph_spec->name,
-				graph_svg, web_server_root))
+				"", web_server_root,
+				web_update_ms > 0 ? web_update_ms : coco::WebServer::DEFAULT_UPDATE_PERIOD))
 		{
 			COCO_FATAL()<< "Failed to initialize server on port: " << web_server_port << std::endl;
 		}
 	}
 
+	loader->configureTasks();
+	if (profiling)
+		std::cout << loader->startupReport() << std::endl;
+	else
+		COCO_DEBUG("GraphLauncher") << loader->startupReport();
+
+	if (!telemetry.empty() && !coco::Telemetry::start(telemetry))
+		COCO_ERR() << "Failed to publish the telemetry in " << telemetry;
+
+	if (watch)
+	{
+		watcher.reset(new coco::ConfigWatcher([config_files_path]()
+			{ return reloadConfig(config_files_path); }));
+		watcher->start(xml_files);
+	}
+
+	/* The web server can add, connect and start tasks from now on */
+	if (graph_edit)
+		coco::ComponentRegistry::setGraphEditor(loader.get());
+
+	std::thread termination(waitTermination);
 	loader->startApp(); // first sequential could block here
     COCO_DEBUG("GraphLauncher") << "Application is running!";
 
-	std::unique_lock<std::mutex> mlock(launcher_mutex);
-	launcher_condition_variable.wait(mlock);
+	termination.join();
 }
 
 
@@ -169,17 +268,28 @@ int main(int argc, char **argv)
 
 		std::string graph = options.getString("graph");
 
+		if (options.get("perf_counters"))
+			coco::ComponentRegistry::enablePerfCounters(true);
+
+		trace_file = options.getString("trace");
+		if (!trace_file.empty())
+			coco::util::Tracer::instance().enable();
+
 		std::vector<std::string> disabled = options.getStringVector("disabled");
 		std::unordered_set<std::string> disabled_component;
 		for (auto & d : disabled)
 			disabled_component.insert(d);
 
 		std::vector<std::string> latency = options.getStringVector("latency");
-		if (latency.size() > 0 && latency.size() != 2)
-			COCO_FATAL() << "To calculate latency specify the name of two task. [-l task1 task2]";
+		if (latency.size() % 2 != 0)
+			COCO_FATAL() << "To calculate latency specify pairs of source and target task. [-l source1 target1 source2 target2 ...]";
 
 		launchApp(config_file, profiling, graph, web_server_port, root,
-				disabled_component, latency);
+				options.getInt("web_update"),
+				disabled_component, latency, options.getInt("startup_threads"),
+				options.getString("graph_cache"), options.get("watch"),
+				options.getString("telemetry"), options.get("graph_edit"),
+				options.get("parallel_config"));
 
 		if (statistics.joinable())
 		{
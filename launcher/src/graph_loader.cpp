@@ -8,8 +8,11 @@
  * file 'LICENSE.txt', which is part of this source code package.
  */
 
-#include <unistd.h>
+#include <fstream>
 #include "coco/util/accesses.hpp"
+#include "coco/util/timing.h"
+#include "coco/telemetry.h"
+#include "coco/graph_svg.h"
 
 #include "graph_loader.h"
 
@@ -34,6 +37,10 @@ void GraphLoader::loadGraph(std::shared_ptr<TaskGraphSpec> app_spec,
 {
 	app_spec_ = app_spec;
 	disabled_components_ = disabled_components;
+
+	instantiateTasks();
+
+	int long start = util::time();
 	/* Launch activitie
 	 * Activities and the component inside them, are guaranteed to be loaded,
 	 * with the same oredr as they are encountered in the xml file.
@@ -50,14 +57,18 @@ void GraphLoader::loadGraph(std::shared_ptr<TaskGraphSpec> app_spec,
         startPipeline(pipeline);
 
     COCO_DEBUG("GraphLoader") << "Loading " << app_spec_->farms.size() << " Farms";
+    declared_connections_ = app_spec_->connections.size();
     for (auto &farm: app_spec_->farms)
         startFarm(farm);
     // TODO Manage ConnectionManager
+    startup_.record("activities", "activities", start);
 
     /* Make connections */
+    start = util::time();
     COCO_DEBUG("GraphLoader") << "Making connections";
     for (auto & connection : app_spec_->connections)
         makeConnection(connection);
+    startup_.record("connections", "connections", start);
 
 	COCO_DEBUG("GraphLoader") <<
 			"Checking that all the components have at least one port connected";
@@ -135,6 +146,8 @@ void GraphLoader::loadSchedule(const SchedulePolicySpec &policy_spec, SchedulePo
 
 	policy.priority = policy_spec.priority;
 	policy.runtime = policy_spec.runtime;
+	policy.lock_memory = policy_spec.lock_memory;
+	policy.prefault_bytes = static_cast<std::size_t>(policy_spec.prefault_kb) << 10;
 }
 
 void GraphLoader::startActivity(std::unique_ptr<ActivitySpec> &activity_spec)
@@ -327,8 +340,99 @@ void GraphLoader::startFarm(std::unique_ptr<FarmSpec> &farm_spec)
 
 }
 
+void GraphLoader::instantiateTasks()
+{
+	/* Tasks of the activities, pipelines and farms, the workers of a farm
+	 * after the first are cloned and created by startFarm()
+	 */
+	std::vector<std::shared_ptr<TaskSpec> > task_specs;
+	for (auto & activity : app_spec_->activities)
+		task_specs.insert(task_specs.end(), activity->tasks.begin(), activity->tasks.end());
+	for (auto & pipeline : app_spec_->pipelines)
+		task_specs.insert(task_specs.end(), pipeline->tasks.begin(), pipeline->tasks.end());
+	for (auto & farm : app_spec_->farms)
+	{
+		bool disabled = disabled_components_.count(farm->source_task->instance_name) != 0 ||
+						disabled_components_.count(farm->gather_task->instance_name) != 0;
+		for (auto & task : farm->pipelines[0]->tasks)
+			disabled = disabled || disabled_components_.count(task->instance_name) != 0;
+		if (disabled)
+			continue;
+		task_specs.push_back(farm->source_task);
+		task_specs.push_back(farm->gather_task);
+		task_specs.insert(task_specs.end(), farm->pipelines[0]->tasks.begin(),
+						  farm->pipelines[0]->tasks.end());
+	}
+
+	/* A task is created as soon as the libraries of its components are loaded */
+	std::unordered_map<std::string, StartupScheduler::JobId> libraries;
+	std::function<void(const std::shared_ptr<TaskSpec> &, std::vector<StartupScheduler::JobId> &)> addLibraries =
+		[&](const std::shared_ptr<TaskSpec> &task_spec, std::vector<StartupScheduler::JobId> &dependencies)
+		{
+			if (disabled_components_.count(task_spec->instance_name) != 0)
+				return;
+			const std::string &library = task_spec->library_name;
+			if (!library.empty() && ComponentRegistry::components().count(task_spec->name) == 0)
+			{
+				auto it = libraries.find(library);
+				if (it == libraries.end())
+				{
+					auto job = startup_.add("libraries", library, [library]()
+						{
+							if (!ComponentRegistry::addLibrary(library))
+								COCO_ERR() << "Failed to load library (maybe) " << library;
+						});
+					it = libraries.insert(std::make_pair(library, job)).first;
+				}
+				dependencies.push_back(it->second);
+			}
+			for (auto & peer : task_spec->peers)
+				addLibraries(peer, dependencies);
+		};
+
+	std::unordered_set<std::string> scheduled;
+	for (auto & task_spec : task_specs)
+	{
+		if (disabled_components_.count(task_spec->instance_name) != 0 ||
+			!scheduled.insert(task_spec->instance_name).second)
+			continue;
+		std::vector<StartupScheduler::JobId> dependencies;
+		addLibraries(task_spec, dependencies);
+		startup_.add("tasks", task_spec->instance_name, [this, task_spec]()
+			{
+				TaskMap created;
+				createTask(task_spec, nullptr, created);
+				std::unique_lock<std::mutex> mlock(instantiated_mutex_);
+				instantiated_[task_spec->instance_name] = std::move(created);
+			}, dependencies);
+	}
+	COCO_DEBUG("GraphLoader") << "Creating " << scheduled.size() << " tasks from "
+							  << libraries.size() << " libraries";
+	if (!startup_.run())
+		COCO_FATAL() << "Failed to create the tasks:\n" << startup_.errors();
+}
+
 bool GraphLoader::loadTask(std::shared_ptr<TaskSpec> & task_spec,
 						   std::shared_ptr<TaskContext> & task_owner)
+{
+	auto created = instantiated_.find(task_spec->instance_name);
+	if (created == instantiated_.end() || task_owner)
+		return createTask(task_spec, task_owner, tasks_);
+
+	for (auto & task : created->second)
+	{
+		if (tasks_.find(task.first) != tasks_.end())
+			COCO_FATAL() << "Trying to instantiate two task with the same name: "
+						 << task.first;
+		tasks_.insert(task);
+	}
+	instantiated_.erase(created);
+	return true;
+}
+
+bool GraphLoader::createTask(const std::shared_ptr<TaskSpec> & task_spec,
+							 const std::shared_ptr<TaskContext> & task_owner,
+							 TaskMap & tasks)
 {
 	// Issue: In this way, rightly, are disabled also all the peers of a given task.
 	if (disabled_components_.count(task_spec->instance_name) != 0)
@@ -341,7 +445,7 @@ bool GraphLoader::loadTask(std::shared_ptr<TaskSpec> & task_spec,
 	COCO_DEBUG("GraphLoader") << "Loading "
 							  << (task_spec->is_peer ? "peer" : "task") << ": "
 							  << task_spec->instance_name << " (" << task_spec->name << ")";
-	if (tasks_.find(task_spec->instance_name) != tasks_.end())
+	if (tasks.find(task_spec->instance_name) != tasks.end())
 		COCO_FATAL() << "Trying to instantiate two task with the same name: "
 					 << task_spec->instance_name;
 
@@ -376,7 +480,7 @@ bool GraphLoader::loadTask(std::shared_ptr<TaskSpec> & task_spec,
 		task->setEngine(std::make_shared<ExecutionEngine>(task));
 	}
 
-	tasks_[task_spec->instance_name] = task;
+	tasks[task_spec->instance_name] = task;
 
 	COCO_DEBUG("GraphLoader") << "Loading attributes";
 	for (auto & attribute : task_spec->attributes)
@@ -411,7 +515,7 @@ bool GraphLoader::loadTask(std::shared_ptr<TaskSpec> & task_spec,
 	{
 		COCO_DEBUG("GraphLoader") << "Loading " << task_spec->peers.size() << " peers of "  << task_spec->instance_name ;
 		for (auto & peer : task_spec->peers)
-			loadTask(peer, task);
+			createTask(peer, task, tasks);
 	}
 
 	// TBD: better do that at the very end of loading process
@@ -428,6 +532,30 @@ bool GraphLoader::loadTask(std::shared_ptr<TaskSpec> & task_spec,
 	return true;
 }
 
+void GraphLoader::connectionPorts(const ConnectionSpec &connection_spec,
+								  const std::shared_ptr<TaskContext> &src_task,
+								  const std::shared_ptr<TaskContext> &dest_task,
+								  std::shared_ptr<PortBase> &left,
+								  std::shared_ptr<PortBase> &right) const
+{
+    left = src_task->port(connection_spec.src_port);
+
+    // try same value
+    // try replace OUT -> IN
+    if(connection_spec.dest_port.empty())
+    {
+    	right = dest_task->port(connection_spec.src_port);
+    	if(!right && endswith(connection_spec.src_port,"IN"))
+    	{
+	    	right = dest_task->port(connection_spec.src_port.substr(0,connection_spec.src_port.size()-2)+"OUT");
+    	}
+    }
+    else
+    {
+    	right = dest_task->port(connection_spec.dest_port);
+    }
+}
+
 void GraphLoader::makeConnection(
 		std::unique_ptr<ConnectionSpec> &connection_spec)
 {
@@ -449,23 +577,8 @@ void GraphLoader::makeConnection(
 	if (src_task->second->isOnSameThread(dest_task->second))
 		policy.lock_policy = ConnectionPolicy::UNSYNC;
 
-    std::shared_ptr<PortBase> left = src_task->second->port(connection_spec->src_port);
-    std::shared_ptr<PortBase>  right;	
-
-    // try same value
-    // try replace OUT -> IN
-    if(connection_spec->dest_port.empty())
-    {
-    	right = dest_task->second->port(connection_spec->src_port);
-    	if(!right && endswith(connection_spec->src_port,"IN"))
-    	{
-	    	right = dest_task->second->port(connection_spec->src_port.substr(0,connection_spec->src_port.size()-2)+"OUT");
-    	}
-    }
-    else
-    {
-    	right = dest_task->second->port(connection_spec->dest_port);
-    }
+    std::shared_ptr<PortBase> left, right;
+    connectionPorts(*connection_spec, src_task->second, dest_task->second, left, right);
 
     if (left && right)
     {
@@ -481,36 +594,175 @@ void GraphLoader::makeConnection(
     }
 }
 
-void GraphLoader::startApp()
+void GraphLoader::configureTasks()
 {
-	COCO_DEBUG("Loader")<< "Starting the Activities!";
-	if (activities_.size() <= 0)
+	if (tasks_configured_)
+		return;
+	tasks_configured_ = true;
+	std::vector<std::shared_ptr<ExecutionEngine> > engines;
+	std::unordered_map<const TaskContext *, std::size_t> index;
+	for (auto & activity : startedActivities())
 	{
-		COCO_FATAL() << "No app created, first run createApp()";
+		for (auto & runnable : activity->runnables())
+		{
+			auto engine = std::static_pointer_cast<ExecutionEngine>(runnable);
+			if (engine->isConfigured())
+				continue;
+			index[engine->task().get()] = engines.size();
+			engines.push_back(engine);
+		}
 	}
-	std::vector<std::shared_ptr<Activity> > seq_act_list;
-	for (auto act : activities_)
+	if (engines.empty())
+		return;
+
+	/* Readiness graph: a task is configured after the tasks it declared */
+	std::vector<std::vector<std::size_t> > dependencies(engines.size());
+	auto addDependency = [&](std::size_t i, std::shared_ptr<TaskContext> task)
+		{
+			while (task && isPeer(task))
+				task = std::static_pointer_cast<PeerTask>(task)->fatherTask();
+			auto it = task ? index.find(task.get()) : index.end();
+			if (it != index.end() && it->second != i)
+				dependencies[i].push_back(it->second);
+		};
+	for (std::size_t i = 0; i < engines.size(); ++i)
 	{
-		if (dynamic_cast<SequentialActivity *>(act.get()))
+		auto task = engines[i]->task();
+		for (auto & name : task->config_after_tasks_)
 		{
-			seq_act_list.push_back(act);
-			continue;
+			auto dependency = tasks_.find(name);
+			if (dependency == tasks_.end())
+				COCO_ERR() << "Task " << task->instantiationName()
+						   << " is configured after unknown task " << name;
+			else
+				addDependency(i, dependency->second);
+		}
+		for (auto & name : task->config_after_ports_)
+		{
+			auto port = task->port(name);
+			if (!port)
+			{
+				COCO_ERR() << "Task " << task->instantiationName()
+						   << " is configured after the tasks of unknown port " << name;
+				continue;
+			}
+			for (auto & connection : port->connections())
+				addDependency(i, port->isOutput() ? connection->input()->task()
+												  : connection->output()->task());
 		}
-		act->start();
 	}
-	if (seq_act_list.size() > 0)
+
+	/* Split the tasks in waves, a wave depends only on the previous ones */
+	std::vector<std::vector<std::size_t> > waves;
+	std::vector<bool> added(engines.size(), false);
+	std::size_t count = 0;
+	while (count < engines.size())
 	{
-		if (seq_act_list.size() > 1)
+		std::vector<std::size_t> wave;
+		for (std::size_t i = 0; i < engines.size(); ++i)
+		{
+			if (added[i])
+				continue;
+			bool ready = true;
+			for (std::size_t dependency : dependencies[i])
+				ready = ready && added[dependency];
+			if (ready)
+				wave.push_back(i);
+		}
+		if (wave.empty())
+		{
+			std::stringstream tasks;
+			for (std::size_t i = 0; i < engines.size(); ++i)
+				if (!added[i])
+					tasks << " " << engines[i]->task()->instantiationName();
+			COCO_FATAL() << "Cyclic configuration dependencies between tasks:" << tasks.str();
+		}
+		for (std::size_t i : wave)
+			added[i] = true;
+		count += wave.size();
+		waves.push_back(std::move(wave));
+	}
+
+	if (!parallel_config_)
+	{
+		/* Each activity configures its tasks on its own thread in this order */
+		for (std::size_t i = 0; i < engines.size(); ++i)
+		{
+			std::vector<std::shared_ptr<ExecutionEngine> > after;
+			for (std::size_t dependency : dependencies[i])
+				after.push_back(engines[dependency]);
+			engines[i]->configureAfter(after);
+		}
+		COCO_DEBUG("GraphLoader") << "The activities configure " << engines.size()
+								  << " tasks in " << waves.size() << " waves";
+		return;
+	}
+
+	std::vector<StartupScheduler::JobId> jobs(engines.size());
+	for (auto & wave : waves)
+	{
+		for (std::size_t i : wave)
+		{
+			std::vector<StartupScheduler::JobId> wave_dependencies;
+			for (std::size_t dependency : dependencies[i])
+				wave_dependencies.push_back(jobs[dependency]);
+			auto engine = engines[i];
+			jobs[i] = startup_.add("configuration", engine->task()->instantiationName(),
+								   [engine]() { engine->init(); }, wave_dependencies);
+		}
+	}
+	COCO_DEBUG("GraphLoader") << "Configuring " << engines.size() << " tasks in "
+							  << waves.size() << " waves";
+	if (!startup_.run())
+		COCO_FATAL() << "Failed to configure the tasks:\n" << startup_.errors();
+}
+
+void GraphLoader::startApp()
+{
+	COCO_DEBUG("Loader")<< "Starting the Activities!";
+	if (activities_.size() <= 0)
+	{
+		COCO_FATAL() << "No app created, first run createApp()";
+	}
+	/* Order the configuration, or configure the tasks before the activities start */
+	configureTasks();
+	auto started = startedActivities();
+	if (started.size() < activities_.size())
 		COCO_ERR()
 		<< "Only one sequential activity per application is allowed.\
                            Only the first will be run!";
-		seq_act_list[0]->start();
+	/* The barrier waits only for the tasks of the activities that run */
+	for (auto act : started)
+		for (auto & runnable : act->runnables())
+			ComponentRegistry::scheduleConfig(std::static_pointer_cast<ExecutionEngine>(runnable));
+	for (auto act : started)
+		act->start(); // the sequential activity is last, it could block here
+}
+
+std::vector<std::shared_ptr<Activity> > GraphLoader::startedActivities() const
+{
+	std::vector<std::shared_ptr<Activity> > started;
+	std::shared_ptr<Activity> sequential;
+	for (auto act : activities_)
+	{
+		if (!dynamic_cast<SequentialActivity *>(act.get()))
+			started.push_back(act);
+		else if (!sequential)
+			sequential = act;
 	}
+	if (sequential)
+		started.push_back(sequential);
+	return started;
 }
 
 void GraphLoader::waitToComplete()
 {
-	for (auto activity : activities_)
+	std::vector<std::shared_ptr<Activity> > activities;
+	{
+		std::unique_lock<std::mutex> lock(edit_mutex_);
+		activities = activities_;
+	}
+	for (auto activity : activities)
 	{
 		activity->join();
 	}
@@ -518,272 +770,496 @@ void GraphLoader::waitToComplete()
 
 void GraphLoader::terminateApp()
 {
-	for (auto activity : activities_)
-		activity->stop();
+	{
+		std::unique_lock<std::mutex> lock(edit_mutex_);
+		for (auto activity : activities_)
+			activity->stop();
+	}
 	waitToComplete();
 }
 
-void GraphLoader::printGraph(const std::string& filename) const
+namespace
+{
+std::string connectionKey(const ConnectionSpec &connection)
+{
+	return connection.src_task->instance_name + "." + connection.src_port + "->" +
+		   connection.dest_task->instance_name + "." + connection.dest_port;
+}
+
+bool samePolicy(const ConnectionPolicySpec &a, const ConnectionPolicySpec &b)
 {
-	std::string dot_file_name = filename + ".dot";
-	std::ofstream dot_file(dot_file_name.c_str());
-
-	dot_file << "digraph {\n";
-	dot_file << "graph[rankdir=LR, center=true  ];\n";
-	//dot_file << "rankdir=LR;\n";
-	//dot_file << "splines=ortho;\n";
-	int activity_count = 0;
-	int subgraph_count = 0;
-	int node_count = 0;
-	std::unordered_map<std::string, int> graph_port_nodes;
-
-	for (auto activity : activities_)
-	{
-		dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-				<< "color = blue;\n" << "label = \"activity "
-				<< activity_count++ << ": "
-				<< (activity->isPeriodic() ? "Periodic" : "Triggered");
-		if (activity->isPeriodic())
-			dot_file << " (" << activity->period() << " ms)";
-		dot_file << " \";\n"; // TODO add schedule policy
-
-		// Add the components
-		for (auto& runnable : activity->runnables())
+	return a.data == b.data && a.policy == b.policy &&
+		   a.transport == b.transport && a.buffersize == b.buffersize;
+}
+}  // end of anonymous namespace
+
+std::shared_ptr<TaskContext> GraphLoader::executingTask(std::shared_ptr<TaskContext> task)
+{
+	while (isPeer(task))
+		task = std::static_pointer_cast<PeerTask>(task)->fatherTask();
+	return task;
+}
+
+unsigned GraphLoader::applyChanges(const std::shared_ptr<TaskGraphSpec> &app_spec)
+{
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	unsigned changes = 0;
+
+	auto clones = farmClones();
+	for (auto & task_spec : app_spec_->tasks)
+	{
+		auto updated = app_spec->tasks.find(task_spec.first);
+		if (updated == app_spec->tasks.end())
 		{
-			auto task = static_cast<ExecutionEngine *>(runnable.get())->task();
-			dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-					<< "color = red;\n" << "label = \"Component: "
-					<< task->name() << "\\nName: " << task->instantiationName()
-					<< "\";\n";
-
-			// Add port
-            for (auto port : util::values_iteration(task->ports()))
-			{
-				createGraphPort(port, dot_file, graph_port_nodes, node_count);
-			}
+			COCO_ERR() << "Component " << task_spec.first << " removed, restart to apply";
+			continue;
+		}
+		auto task = tasks_.find(task_spec.first);
+		if (task == tasks_.end())
+			continue;  // disabled
+		if (updated->second->name != task_spec.second->name ||
+			updated->second->contents != task_spec.second->contents)
+			COCO_ERR() << "Component " << task_spec.first << " changed, restart to apply";
+		changes += reloadAttributes(*task_spec.second, *updated->second, task->second);
+		/* The workers of a farm run clones of the declared task */
+		auto task_clones = clones.find(task_spec.first);
+		if (task_clones == clones.end())
+			continue;
+		for (auto & clone : task_clones->second)
+		{
+			auto clone_task = tasks_.find(clone->instance_name);
+			if (clone_task != tasks_.end())
+				changes += reloadAttributes(*clone, *updated->second, clone_task->second);
+		}
+	}
+	for (auto & task_spec : app_spec->tasks)
+	{
+		if (app_spec_->tasks.find(task_spec.first) == app_spec_->tasks.end())
+			COCO_ERR() << "Component " << task_spec.first << " added, restart to apply";
+	}
 
-			// Add peer
-			for (auto peer : task->peers())
-			{
-				createGraphPeer(peer, dot_file, graph_port_nodes,
-						subgraph_count, node_count);
-			}
-			dot_file << "}\n";
+	std::unordered_map<std::string, ConnectionSpec *> connections;
+	for (auto & connection : app_spec->connections)
+		connections[connectionKey(*connection)] = connection.get();
+	/* The farm connections are not in the config, they follow the farm */
+	for (std::size_t i = 0; i < declared_connections_; ++i)
+	{
+		auto & connection = app_spec_->connections[i];
+		auto updated = connections.find(connectionKey(*connection));
+		if (updated == connections.end())
+		{
+			COCO_ERR() << "Connection " << connectionKey(*connection) << " removed, restart to apply";
+			continue;
+		}
+		if (!samePolicy(connection->policy, updated->second->policy))
+		{
+			if (rebuildConnection(*connection, updated->second->policy))
+				++changes;
 		}
-		dot_file << "}\n";
+		connections.erase(updated);
 	}
-	// Add connections
+	for (auto & connection : connections)
+		COCO_ERR() << "Connection " << connection.first << " added, restart to apply";
 
-    for (auto task : util::values_iteration(tasks_))
+	if (changes > 0)
+		graphChanged();
+	return changes;
+}
+
+std::unordered_map<std::string, std::vector<std::shared_ptr<TaskSpec> > > GraphLoader::farmClones() const
+{
+	std::unordered_map<std::string, std::vector<std::shared_ptr<TaskSpec> > > clones;
+	std::function<void(const std::shared_ptr<TaskSpec> &, const std::shared_ptr<TaskSpec> &)> add =
+		[&](const std::shared_ptr<TaskSpec> &task, const std::shared_ptr<TaskSpec> &clone)
+		{
+			clones[task->instance_name].push_back(clone);
+			for (std::size_t i = 0; i < task->peers.size() && i < clone->peers.size(); ++i)
+				add(task->peers[i], clone->peers[i]);
+		};
+	for (auto & farm : app_spec_->farms)
 	{
-		createGraphConnection(task, dot_file, graph_port_nodes);
+		auto & first = farm->pipelines[0]->tasks;
+		for (std::size_t worker = 1; worker < farm->pipelines.size(); ++worker)
+		{
+			auto & tasks = farm->pipelines[worker]->tasks;
+			for (std::size_t i = 0; i < first.size() && i < tasks.size(); ++i)
+				add(first[i], tasks[i]);
+		}
 	}
+	return clones;
+}
 
-	dot_file << "}" << std::endl;
+unsigned GraphLoader::reloadAttributes(TaskSpec &task_spec, const TaskSpec &updated,
+									   const std::shared_ptr<TaskContext> &task)
+{
+	// Attributes can be repeated by extending components, the last value wins
+	std::unordered_map<std::string, std::string> values;
+	for (auto & attribute : task_spec.attributes)
+		values[attribute.name] = attribute.value;
 
-	dot_file.close();
+	std::unordered_map<std::string, std::string> changed;
+	for (auto & attribute : updated.attributes)
+	{
+		auto value = values.find(attribute.name);
+		if (value == values.end() || value->second != attribute.value)
+			changed[attribute.name] = attribute.value;
+		else
+			changed.erase(attribute.name);
+	}
 
-	std::string cmd = "dot " + dot_file_name + " -o " + filename
-			+ std::string(".pdf") + " -Tpdf";
-	if (std::system(cmd.c_str()) == -1)
+	auto executor = executingTask(task);
+	for (auto & value : changed)
 	{
-		COCO_ERR() << "error executing " << cmd;
+		auto attribute = task->attribute(value.first);
+		if (!attribute)
+		{
+			COCO_ERR() << "Attribute: " << value.first << " doesn't exist in " << task_spec.instance_name;
+			continue;
+		}
+		COCO_DEBUG("GraphLoader") << "Setting " << task_spec.instance_name << "." << value.first
+								  << " to " << value.second;
+		std::string new_value = value.second;
+		executor->enqueuePending([attribute, new_value]() { attribute->setValue(new_value); });
 	}
+	task_spec.attributes = updated.attributes;
+	return changed.size();
 }
 
-std::string GraphLoader::graphSvg() const
+bool GraphLoader::rebuildConnection(ConnectionSpec &connection_spec,
+									const ConnectionPolicySpec &policy_spec)
 {
-    char* temp = strdup("COCO_XXXXXX");
-    int fd = mkstemp(temp);
-    close(fd);
-    if (!writeSvg(std::string(temp)))
-        return "";
-    std::string svgfile = std::string(temp) + ".svg";
-    std::stringstream s;
-    std::ifstream f(svgfile);
-    char c;
-    while (f.get(c))
-    {
-        s << c;
-    }
-    f.close();
-    std::string graph_svg = s.str();
-    remove(temp);
-    remove((std::string(temp) + ".dot").c_str());
-    remove(svgfile.c_str());
-    free(temp);
+	auto src_task = tasks_.find(connection_spec.src_task->instance_name);
+	auto dest_task = tasks_.find(connection_spec.dest_task->instance_name);
+	if (src_task == tasks_.end() || dest_task == tasks_.end())
+		return false;
+
+	std::shared_ptr<PortBase> left, right;
+	connectionPorts(connection_spec, src_task->second, dest_task->second, left, right);
+	if (!left || !right)
+		return false;
+
+	auto old_connection = findConnection(left, right);
+	if (!old_connection)
+	{
+		COCO_ERR() << "Connection " << connectionKey(connection_spec) << " not found";
+		return false;
+	}
+
+	ConnectionPolicy policy(policy_spec.data, policy_spec.policy,
+							policy_spec.transport, policy_spec.buffersize);
+	if (src_task->second->isOnSameThread(dest_task->second))
+		policy.lock_policy = ConnectionPolicy::UNSYNC;
+	auto connection = left->newConnection(right, policy);
+	if (!connection)
+		return false;
+
+	/* Each side swaps the connection in its own thread between two steps, so the activities
+	 * keep running. Until both have done it the writer and the reader can use different
+	 * connections and the data in the old buffer is dropped.
+	 */
+	COCO_DEBUG("GraphLoader") << "Rebuilding connection " << connectionKey(connection_spec);
+	executingTask(src_task->second)->enqueuePending([left, old_connection, connection]()
+		{ left->replaceConnection(old_connection, connection); });
+	executingTask(dest_task->second)->enqueuePending([right, old_connection, connection]()
+		{ right->replaceConnection(old_connection, connection); });
 
-    return graph_svg;
+	connection_spec.policy = policy_spec;
+	return true;
 }
 
-bool GraphLoader::writeSvg(const std::string& name) const
+std::shared_ptr<ConnectionBase> GraphLoader::findConnection(const std::shared_ptr<PortBase> &left,
+															  const std::shared_ptr<PortBase> &right)
 {
-	std::string dot_file_name = name + ".dot";
-	std::ofstream dot_file(dot_file_name.c_str());
-	dot_file << "digraph {\n";
-	dot_file << "graph[rankdir=LR, center=true, bgcolor=transparent];\n";
-	dot_file << "subgraph cluster_border{\ncolor=white;\nbgcolor=white;\nshape=record;\n";
-	int activity_count = 0;
-	int subgraph_count = 0;
-	int node_count = 0;
-	std::unordered_map<std::string, int> graph_port_nodes;
-	for (auto activity : activities_)
-	{
-		dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-				<< "color = blue;\n" << "label = \"activity "
-				<< activity_count++ << ": "
-				<< (activity->isPeriodic() ? "Periodic" : "Triggered");
-		if (activity->isPeriodic())
-			dot_file << " (" << activity->period() << " ms)";
-		dot_file << " \";\n"; // TODO add schedule policy
-
-		// Add the components
-		for (auto& runnable : activity->runnables())
-		{
-			auto task = static_cast<ExecutionEngine *>(runnable.get())->task();
-			dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-					<< "color = red;\nshape = record;\nstyle = rounded;\n"
-					<< "label = \"" << task->instantiationName() << " ("
-					<< task->name() << ")\"\n";
-			// Add port
-            for (auto port : util::values_iteration(task->ports()))
-			{
-				dot_file << node_count << "[color="
-						<< (port->isOutput() ? "darkgreen" : "darkorchid4")
-						<< ", shape=ellipse, label=\"" << port->name();
-				if (port->isEvent())
-					dot_file << "\\n(event)";
-				dot_file << "\"];\n";
-				std::string name_id = port->task()->instantiationName()
-						+ port->name();
-				graph_port_nodes[name_id] = node_count++;
-			}
-			// Add peer
-			for (auto peer : task->peers())
-			{
-                if (peer->ports().size() > 0 || peer->peers().size() > 0)
-				{
-					dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-							<< "color = orange;\nshape=box;\nlabel = \"Component: "
-							<< peer->name() << "\\nName: "
-							<< peer->instantiationName() << "\";\n";
-				}
-				else
-				{
-					dot_file << node_count++
-							<< "[color=orange, shape=box, label=\"Component: "
-							<< peer->name() << "\\nName: "
-							<< peer->instantiationName() << "\"];\n";
-                    continue;
-				}
-				// Add port
-                for (auto port : util::values_iteration(peer->ports()))
-				{
-                    //if (port->isConnected())
-						createGraphPort(port, dot_file, graph_port_nodes,
-								node_count);
-				}
+	for (auto & connection : left->connections())
+	{
+		if (connection->input() == right || connection->output() == right)
+			return connection;
+	}
+	return nullptr;
+}
 
-				for (auto sub_peer : peer->peers())
-					createGraphPeer(sub_peer, dot_file, graph_port_nodes,
-							subgraph_count, node_count);
+std::shared_ptr<TaskContext> GraphLoader::editedTask(const std::string &instance_name) const
+{
+	auto task = tasks_.find(instance_name);
+	if (task == tasks_.end())
+	{
+		COCO_ERR() << "Task " << instance_name << " doesn't exist";
+		return nullptr;
+	}
+	if (isPeer(task->second))
+	{
+		COCO_ERR() << "Task " << instance_name << " is a peer, it has no activity";
+		return nullptr;
+	}
+	return task->second;
+}
 
-				dot_file << "}\n";
-			}
-			dot_file << "}\n";
+namespace
+{
+std::string libraryPath(const std::string &library_name)
+{
+	std::string path = ComponentRegistry::resourceFinder(library_name);
+	if (path.empty())
+	{
+#ifdef __APPLE__
+		path = ComponentRegistry::resourceFinder("lib" + library_name + ".dylib");
+#else
+		path = ComponentRegistry::resourceFinder("lib" + library_name + ".so");
+#endif
+	}
+	return path;
+}
+}  // end of anonymous namespace
+
+void GraphLoader::graphChanged() const
+{
+	ComponentRegistry::increaseGraphVersion();
+	Telemetry::refresh();
+}
+
+bool GraphLoader::addTask(const std::string &class_name, const std::string &instance_name,
+						  const std::string &library_name, const SchedulePolicy &policy)
+{
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	if (instance_name.empty() || tasks_.count(instance_name) || ComponentRegistry::task(instance_name))
+	{
+		COCO_ERR() << "Cannot add task " << instance_name << ", the name is already used";
+		return false;
+	}
+	if (ComponentRegistry::components().count(class_name) == 0)
+	{
+		std::string library = library_name.empty() ? "" : libraryPath(library_name);
+		if (library.empty())
+		{
+			COCO_ERR() << "Component " << class_name << " not loaded and library "
+					   << library_name << " not found";
+			return false;
+		}
+		if (!ComponentRegistry::addLibrary(library) ||
+			ComponentRegistry::components().count(class_name) == 0)
+		{
+			COCO_ERR() << "Component " << class_name << " not found in " << library;
+			return false;
 		}
-		dot_file << "}\n";
 	}
-	dot_file << "}\n";
 
-	// Add connections
-    for (auto task : util::values_iteration(tasks_))
+	std::list<unsigned> available_core_id;
+	for (unsigned int i = 0; i < std::thread::hardware_concurrency(); ++i)
+		if (assigned_core_id_.find(i) == assigned_core_id_.end())
+			available_core_id.push_back(i);
+	if (policy.affinity >= 0 &&
+		std::find(available_core_id.begin(), available_core_id.end(),
+				  (unsigned)policy.affinity) == available_core_id.end())
 	{
-		createGraphConnection(task, dot_file, graph_port_nodes);
+		COCO_ERR() << "Core " << policy.affinity << " either doesn't exist or it is"
+				   << " assigned exclusively to another activity";
+		return false;
 	}
-	dot_file << "}" << std::endl;
-	dot_file.close();
 
-	std::string cmd = "dot " + dot_file_name + " -o " + name + ".svg -Tsvg";
-	return std::system(cmd.c_str()) >= 0;
+	auto task_spec = std::make_shared<TaskSpec>();
+	task_spec->name = class_name;
+	task_spec->instance_name = instance_name;
+	if (!createTask(task_spec, nullptr, tasks_))
+		return false;
+	auto & task = tasks_[instance_name];
+
+	std::shared_ptr<Activity> activity = std::make_shared<ParallelActivity>(policy);
+	activity->policy().available_core_id = available_core_id;
+	activity->addRunnable(task->engine());
+	task->setActivity(activity);
+	/* Configured now, so that the tasks started later don't wait for it */
+	task->engine()->init();
+
+	activities_.push_back(activity);
+	ComponentRegistry::setActivities(activities_);
+	graphChanged();
+	COCO_LOG(0) << "Added task " << instance_name << " (" << class_name << ")";
+	return true;
 }
 
-void GraphLoader::createGraphPort(std::shared_ptr<PortBase> port,
-		std::ofstream &dot_file,
-		std::unordered_map<std::string, int> &graph_port_nodes,
-		int &node_count) const
+bool GraphLoader::removeTask(const std::string &instance_name)
 {
-	dot_file << node_count << "[color="
-			<< (port->isOutput() ? "darkgreen" : "darkorchid4")
-			<< ", shape=ellipse, label=\"" << port->name();
-	if (port->isEvent())
-		dot_file << "\\n(event)";
-	dot_file << "\"];\n";
-	std::string name_id = port->task()->instantiationName() + port->name();
-	graph_port_nodes[name_id] = node_count++;
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	auto task = editedTask(instance_name);
+	if (!task)
+		return false;
+	auto activity = task->activity_;
+	if (activity->isActive())
+	{
+		COCO_ERR() << "Task " << instance_name << " is running, stop it before removing it";
+		return false;
+	}
+	if (activity->runnables().size() != 1)
+	{
+		COCO_ERR() << "Task " << instance_name << " shares its activity with other tasks"
+				   << " and cannot be removed";
+		return false;
+	}
+
+	std::list<std::shared_ptr<TaskContext> > removed(1, task);
+	for (auto & peer : task->peers())
+		removed.push_back(peer);
+	for (auto & removed_task : removed)
+	{
+		for (auto & port : removed_task->ports())
+		{
+			for (auto & connection : port.second->connections())
+			{
+				connection->input()->removeConnection(connection);
+				connection->output()->removeConnection(connection);
+			}
+		}
+	}
+	activity->join();
+	activities_.erase(std::find(activities_.begin(), activities_.end(), activity));
+	ComponentRegistry::setActivities(activities_);
+	for (auto & removed_task : removed)
+	{
+		tasks_.erase(removed_task->instantiationName());
+		ComponentRegistry::removeTask(removed_task->instantiationName());
+	}
+	graphChanged();
+	COCO_LOG(0) << "Removed task " << instance_name;
+	return true;
 }
 
-void GraphLoader::createGraphPeer(std::shared_ptr<TaskContext> peer,
-		std::ofstream &dot_file,
-		std::unordered_map<std::string, int> &graph_port_nodes,
-		int &subgraph_count, int &node_count) const
+bool GraphLoader::connectPorts(const std::string &src_task, const std::string &src_port,
+							   const std::string &dest_task, const std::string &dest_port,
+							   const ConnectionPolicy &policy)
 {
-    std::cout << "PEER: " << peer->instantiationName() << std::endl;
-    if (peer->ports().size() > 0 || peer->peers().size() > 0)
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	auto src = tasks_.find(src_task);
+	auto dest = tasks_.find(dest_task);
+	if (src == tasks_.end() || dest == tasks_.end())
 	{
-		dot_file << "subgraph cluster_" << subgraph_count++ << "{\n"
-				<< "color = red;\n" << "style = rounded;\n"
-				<< "label = \"Component: " << peer->name() << "\\nName: "
-				<< peer->instantiationName() << "\";\n";
+		COCO_ERR() << "Either task " << src_task << " or task " << dest_task << " doesn't exist";
+		return false;
 	}
-	else
+	auto left = src->second->port(src_port);
+	auto right = dest->second->port(dest_port);
+	if (!left || !right)
 	{
-		dot_file << node_count++
-				<< "[color=red, shape=box, style=rounded, label = \"Component: "
-				<< peer->name() << "\\nName: " << peer->instantiationName()
-				<< "\"];\n";
-		return;
+		COCO_ERR() << "Either task " << src_task << " doesn't have port " << src_port
+				   << " or task " << dest_task << " doesn't have port " << dest_port;
+		return false;
+	}
+	if (findConnection(left, right))
+	{
+		COCO_ERR() << "Ports " << src_task << "." << src_port << " and "
+				   << dest_task << "." << dest_port << " are already connected";
+		return false;
 	}
 
-	// Add port
-    for (auto port : util::values_iteration(peer->ports()))
+	ConnectionPolicy connection_policy = policy;
+	if (executingTask(src->second)->isOnSameThread(executingTask(dest->second)))
+		connection_policy.lock_policy = ConnectionPolicy::UNSYNC;
+	auto connection = left->newConnection(right, connection_policy);
+	if (!connection)
 	{
-        //if (port->isConnected())
-			createGraphPort(port, dot_file, graph_port_nodes, node_count);
+		COCO_ERR() << "Ports " << src_task << "." << src_port << " and "
+				   << dest_task << "." << dest_port << " cannot be connected";
+		return false;
 	}
+	/* The reader is connected first, so the data written is never lost */
+	connection->input()->addConnection(connection);
+	connection->output()->addConnection(connection);
+	graphChanged();
+	COCO_LOG(0) << "Connected " << src_task << "." << src_port << " to "
+				<< dest_task << "." << dest_port;
+	return true;
+}
 
-	for (auto sub_peer : peer->peers())
-		createGraphPeer(sub_peer, dot_file, graph_port_nodes, subgraph_count,
-				node_count);
+bool GraphLoader::disconnectPorts(const std::string &src_task, const std::string &src_port,
+								  const std::string &dest_task, const std::string &dest_port)
+{
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	auto src = tasks_.find(src_task);
+	auto dest = tasks_.find(dest_task);
+	if (src == tasks_.end() || dest == tasks_.end())
+	{
+		COCO_ERR() << "Either task " << src_task << " or task " << dest_task << " doesn't exist";
+		return false;
+	}
+	auto left = src->second->port(src_port);
+	auto right = dest->second->port(dest_port);
+	auto connection = left && right ? findConnection(left, right) : nullptr;
+	if (!connection)
+	{
+		COCO_ERR() << "Ports " << src_task << "." << src_port << " and "
+				   << dest_task << "." << dest_port << " are not connected";
+		return false;
+	}
+	/* The writer is disconnected first, then the reader drops the data left in the buffer */
+	connection->output()->removeConnection(connection);
+	connection->input()->removeConnection(connection);
+	graphChanged();
+	COCO_LOG(0) << "Disconnected " << src_task << "." << src_port << " from "
+				<< dest_task << "." << dest_port;
+	return true;
+}
 
-	dot_file << "}\n";
+bool GraphLoader::startTask(const std::string &instance_name)
+{
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	auto task = editedTask(instance_name);
+	if (!task)
+		return false;
+	auto activity = task->activity_;
+	if (!dynamic_cast<ParallelActivity *>(activity.get()))
+	{
+		COCO_ERR() << "Task " << instance_name << " runs in the sequential activity";
+		return false;
+	}
+	if (activity->isActive())
+	{
+		COCO_ERR() << "Task " << instance_name << " is already running";
+		return false;
+	}
+	/* The thread of a previous run must have ended before starting a new one */
+	activity->join();
+	for (auto & runnable : activity->runnables())
+		ComponentRegistry::scheduleConfig(std::static_pointer_cast<ExecutionEngine>(runnable));
+	activity->start();
+	COCO_LOG(0) << "Started task " << instance_name;
+	return true;
 }
 
-void GraphLoader::createGraphConnection(std::shared_ptr<TaskContext> &task,
-		std::ofstream &dot_file,
-		std::unordered_map<std::string, int> &graph_port_nodes) const
+bool GraphLoader::stopTask(const std::string &instance_name)
 {
-    for (auto port : util::values_iteration(task->ports()))
+	std::unique_lock<std::mutex> lock(edit_mutex_);
+	auto task = editedTask(instance_name);
+	if (!task)
+		return false;
+	auto activity = task->activity_;
+	if (!dynamic_cast<ParallelActivity *>(activity.get()))
 	{
-		if (!port->isOutput())
-			continue;
-        std::string this_id = task->instantiationName() + port->name();
+		COCO_ERR() << "Task " << instance_name << " runs in the sequential activity";
+		return false;
+	}
+	activity->stop();
+	activity->join();
+	COCO_LOG(0) << "Stopped task " << instance_name;
+	return true;
+}
 
-        int src = graph_port_nodes.at(this_id);
+void GraphLoader::printGraph(const std::string& filename) const
+{
+	if (!writeSvg(filename))
+		COCO_ERR() << "Failed to write the graph in " << filename << ".svg";
+}
 
-        auto connections = port->connectionManager()->connections();
-		for (auto connection : connections)
-		{
-			std::string port_id =
-					connection->input()->task()->instantiationName()
-                            + connection->input()->name();
+std::string GraphLoader::graphSvg() const
+{
+	GraphSvg graph;
+	graph.layout();
+	return graph.render();
+}
 
-            int dst = graph_port_nodes.at(port_id);
-            dot_file << src << " -> " << dst << ";\n";
-		}
-	}
-	for (auto peer : task->peers())
-		createGraphConnection(peer, dot_file, graph_port_nodes);
+bool GraphLoader::writeSvg(const std::string& name) const
+{
+	std::ofstream svg_file((name + ".svg").c_str());
+	svg_file << graphSvg();
+	return static_cast<bool>(svg_file);
 }
 
 }
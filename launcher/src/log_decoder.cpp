@@ -0,0 +1,50 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+/* Print as text a log written with COCO_LOG_BIN.
+ * Usage: coco_log_decoder <binary log> [text output]
+ */
+
+#include <iostream>
+#include <fstream>
+
+#include "coco/util/binary_log.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <binary log> [text output]\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    std::ofstream file;
+    if (argc > 2)
+    {
+        file.open(argv[2]);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open " << argv[2] << "\n";
+            return 1;
+        }
+    }
+    std::ostream &out = file.is_open() ? file : std::cout;
+    if (!coco::util::BinaryLog::decode(in, out))
+    {
+        std::cerr << argv[1] << " is not a binary log or is truncated\n";
+        return 1;
+    }
+    return 0;
+}
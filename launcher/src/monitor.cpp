@@ -0,0 +1,106 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+/* Print the statistics published by a launcher started with --telemetry.
+ * Usage: coco_monitor [segment name] [refresh rate in Hz] [number of refreshes]
+ * The defaults are coco, 10 Hz and 0, that is until interrupted. Rates are
+ * computed between two refreshes, so the segment can be sampled at kHz rates.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "coco/telemetry.h"
+
+static const char *TaskStateDesc[] =
+{ "INIT", "PRE_OPERATIONAL", "RUNNING", "IDLE", "STOPPED" };
+
+static std::string connectionName(const coco::TelemetryConnection &c)
+{
+    return std::string(c.src) + "/" + c.src_port + " -> " + c.dest + "/" + c.dest_port;
+}
+
+static void print(const coco::TelemetrySnapshot &now, const coco::TelemetrySnapshot &previous,
+                  bool clear)
+{
+    double elapsed = (now.time_us - previous.time_us) / 1e6;
+    bool rates = elapsed > 0 && now.graph_version == previous.graph_version;
+
+    if (clear)
+        printf("\033[H\033[2J");
+    printf("pid %u, update %llu every %u us\n\n", now.pid,
+           static_cast<unsigned long long>(now.updates), now.period_us);
+    printf("%-24s %-10s %10s %8s %10s %10s %10s %10s %10s\n", "task", "state", "steps",
+           "steps/s", "last ms", "mean ms", "max ms", "triggers", "live KiB");
+    for (std::size_t i = 0; i < now.tasks.size(); ++i)
+    {
+        auto &t = now.tasks[i];
+        double rate = rates ? (t.steps - previous.tasks[i].steps) / elapsed : 0;
+        printf("%-24.24s %-10.10s %10llu %8.1f %10.3f %10.3f %10.3f %10llu %10.1f\n",
+               t.name, t.state < 5 ? TaskStateDesc[t.state] : "?",
+               static_cast<unsigned long long>(t.steps), rate,
+               t.time_last * 1e3, t.time_mean * 1e3, t.time_max * 1e3,
+               static_cast<unsigned long long>(t.triggers), t.memory_live_bytes / 1024.0);
+    }
+    printf("\n%-60s %8s %10s %10s %10s\n", "connection", "queued", "written", "writes/s", "dropped");
+    for (std::size_t i = 0; i < now.connections.size(); ++i)
+    {
+        auto &c = now.connections[i];
+        double rate = rates ? (c.written - previous.connections[i].written) / elapsed : 0;
+        printf("%-60.60s %8u %10llu %10.1f %10llu\n", connectionName(c).c_str(), c.queued,
+               static_cast<unsigned long long>(c.written), rate,
+               static_cast<unsigned long long>(c.dropped));
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    std::string name = argc > 1 ? argv[1] : "coco";
+    double rate = argc > 2 ? atof(argv[2]) : 10;
+    long count = argc > 3 ? atol(argv[3]) : 0;
+    if (rate <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [segment name] [refresh rate in Hz] [number of refreshes]\n";
+        return 1;
+    }
+
+    coco::TelemetryReader reader;
+    if (!reader.open(name))
+    {
+        std::cerr << "Cannot open the telemetry segment /" << name
+                  << ", start the launcher with --telemetry " << name << "\n";
+        return 1;
+    }
+
+    bool clear = isatty(STDOUT_FILENO);
+    auto period = std::chrono::microseconds(static_cast<long>(1e6 / rate));
+    auto next = std::chrono::steady_clock::now();
+    coco::TelemetrySnapshot previous, now;
+    reader.read(previous);
+    for (long i = 0; count == 0 || i < count; ++i)
+    {
+        next += period;
+        std::this_thread::sleep_until(next);
+        if (!reader.read(now))
+        {
+            std::cerr << "The telemetry segment is not updated consistently\n";
+            continue;
+        }
+        print(now, previous, clear);
+        std::swap(now, previous);
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "coco/util/timing.h"
+#include "coco/util/logging.h"
+#include "startup_scheduler.h"
+
+namespace coco
+{
+
+StartupScheduler::StartupScheduler(unsigned threads)
+{
+    setThreads(threads);
+}
+
+void StartupScheduler::setThreads(unsigned threads)
+{
+    threads_ = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+StartupScheduler::JobId StartupScheduler::add(const std::string &phase, const std::string &name,
+                                              std::function<void()> fx,
+                                              const std::vector<JobId> &dependencies)
+{
+    JobId id = jobs_.size();
+    jobs_.emplace_back();
+    Job &job = jobs_.back();
+    job.phase = phase;
+    job.name = name;
+    job.fx = std::move(fx);
+    for (JobId dependency : dependencies)
+    {
+        if (dependency >= id)
+            COCO_FATAL() << "Startup job " << name << " depends on a job added after it";
+        if (!jobs_[dependency].done)
+        {
+            jobs_[dependency].dependents.push_back(id);
+            ++job.pending;
+        }
+    }
+    return id;
+}
+
+bool StartupScheduler::run()
+{
+    run_begin_ = first_pending_;
+    {
+        std::unique_lock<std::mutex> mlock(mutex_);
+        remaining_ = jobs_.size() - first_pending_;
+        for (JobId id = first_pending_; id < jobs_.size(); ++id)
+            if (jobs_[id].pending == 0)
+                ready_.push_back(id);
+    }
+    if (remaining_ == 0)
+        return true;
+
+    unsigned count = static_cast<unsigned>(std::min<std::size_t>(threads_, remaining_));
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < count; ++i)
+        workers.emplace_back(&StartupScheduler::worker, this);
+    worker();
+    for (auto &w : workers)
+        w.join();
+    first_pending_ = jobs_.size();
+    for (JobId id = run_begin_; id < jobs_.size(); ++id)
+        if (jobs_[id].failed)
+            return false;
+    return true;
+}
+
+std::string StartupScheduler::errors() const
+{
+    std::stringstream ss;
+    for (JobId id = run_begin_; id < jobs_.size(); ++id)
+    {
+        const Job &job = jobs_[id];
+        if (job.failed)
+            ss << job.phase << " " << job.name << ": " << job.error << "\n";
+    }
+    return ss.str();
+}
+
+void StartupScheduler::execute(Job &job)
+{
+    job.start = util::time();
+    try
+    {
+        job.fx();
+    }
+    catch (const std::exception &e)
+    {
+        job.failed = true;
+        job.error = e.what();
+    }
+    catch (...)
+    {
+        job.failed = true;
+        job.error = "unknown exception";
+    }
+    job.end = util::time();
+}
+
+void StartupScheduler::worker()
+{
+    std::unique_lock<std::mutex> mlock(mutex_);
+    while (true)
+    {
+        cond_.wait(mlock, [this] { return !ready_.empty() || remaining_ == 0; });
+        if (remaining_ == 0)
+            break;
+        JobId id = ready_.front();
+        ready_.pop_front();
+        Job &job = jobs_[id];
+        mlock.unlock();
+
+        /* failed is only set before the job is ready, by the dependency that failed */
+        if (!job.failed)
+            execute(job);
+        else
+            job.start = job.end = util::time();
+
+        mlock.lock();
+        job.done = true;
+        for (JobId dependent : job.dependents)
+        {
+            Job &next = jobs_[dependent];
+            if (job.failed && !next.failed)
+            {
+                next.failed = true;
+                next.error = "not executed, " + job.name + " failed";
+            }
+            if (--next.pending == 0)
+                ready_.push_back(dependent);
+        }
+        --remaining_;
+        cond_.notify_all();
+    }
+}
+
+void StartupScheduler::record(const std::string &phase, const std::string &name, int long start)
+{
+    Job job;
+    job.phase = phase;
+    job.name = name;
+    job.done = true;
+    job.start = start;
+    job.end = util::time();
+    jobs_.push_back(job);
+    first_pending_ = jobs_.size();
+}
+
+std::string StartupScheduler::report() const
+{
+    struct Phase
+    {
+        std::string name;
+        unsigned jobs = 0;
+        int long start = 0;
+        int long end = 0;
+        int long busy = 0;
+        const Job *slowest = nullptr;
+    };
+    std::vector<Phase> phases;
+    int long start = 0, end = 0;
+    for (auto &job : jobs_)
+    {
+        if (!job.done)
+            continue;
+        auto it = std::find_if(phases.begin(), phases.end(),
+                               [&job](const Phase &p) { return p.name == job.phase; });
+        if (it == phases.end())
+        {
+            phases.emplace_back();
+            it = phases.end() - 1;
+            it->name = job.phase;
+            it->start = job.start;
+        }
+        ++it->jobs;
+        it->start = std::min(it->start, job.start);
+        it->end = std::max(it->end, job.end);
+        it->busy += job.end - job.start;
+        if (!it->slowest || job.end - job.start > it->slowest->end - it->slowest->start)
+            it->slowest = &job;
+        start = start == 0 ? job.start : std::min(start, job.start);
+        end = std::max(end, job.end);
+    }
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Startup time: " << (end - start) / 1000.0 << " ms with " << threads_ << " threads\n";
+    for (auto &phase : phases)
+    {
+        ss << "\t" << std::left << std::setw(16) << phase.name << std::right
+           << phase.jobs << " jobs, wall " << (phase.end - phase.start) / 1000.0
+           << " ms, busy " << phase.busy / 1000.0 << " ms, slowest " << phase.slowest->name
+           << " " << (phase.slowest->end - phase.slowest->start) / 1000.0 << " ms\n";
+    }
+    return ss.str();
+}
+
+}  // end of namespace coco
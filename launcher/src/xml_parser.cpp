@@ -8,7 +8,11 @@
  * file 'LICENSE.txt', which is part of this source code package.
  */
 
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include "coco/util/accesses.hpp"
+#include "coco/util/binary_log.h"
 #include "tinyxml2/tinyxml2.h"
 #include "graph_spec.h"
 #include "xml_parser.h"
@@ -17,7 +21,7 @@
 
 const char * defAttribute(tinyxml2::XMLElement *e, const char * name, const char * def)
 {
-    auto q = e->Attribute("name");
+    auto q = e->Attribute(name);
     return !q ? def : q;
 }
 
@@ -77,12 +81,21 @@ bool XmlParser::parseFile(const std::string & config_file,
         		  << ", doesn't start withthe package block" << std::endl;
         return false;
     }
+    parsed_files_.push_back(config_file);
     if(first)
     {
         const char* name = package->Attribute("name");
         app_spec_->name = name ? name : "<not defined>";
 
-        parseLogConfig(package->FirstChildElement("log"));
+        XMLElement *log = package->FirstChildElement("log");
+        app_spec_->log_config.clear();
+        if (log)
+        {
+            XMLPrinter printer;
+            log->Accept(&printer);
+            app_spec_->log_config = printer.CStr();
+        }
+        parseLogConfig(log);
     }
 
     parsePaths(package->FirstChildElement("paths"));
@@ -107,6 +120,19 @@ bool XmlParser::parseFile(const std::string & config_file,
     return true;
 }
 	
+void XmlParser::applyLogConfig(const std::string &log_config)
+{
+    using namespace tinyxml2;
+
+    XMLDocument doc;
+    if (log_config.empty() || doc.Parse(log_config.c_str()) != XML_NO_ERROR)
+    {
+        parseLogConfig(nullptr);
+        return;
+    }
+    parseLogConfig(doc.FirstChildElement("log"));
+}
+
 void XmlParser::parseLogConfig(tinyxml2::XMLElement *logconfig)
 {
 	using namespace tinyxml2;
@@ -175,6 +201,26 @@ void XmlParser::parseLogConfig(tinyxml2::XMLElement *logconfig)
         if (text)
             coco::util::LoggerManager::instance()->setOutLogFile(text);
     }
+    XMLElement *binary_file_ele = logconfig->FirstChildElement("binaryfile");
+    if (binary_file_ele)
+    {
+        auto text = binary_file_ele->GetText();
+        if (text && !coco::util::BinaryLog::instance().open(text))
+            COCO_ERR() << "Failed to open the binary log file: " << text;
+    }
+    XMLElement *async_ele = logconfig->FirstChildElement("async");
+    if (async_ele)
+    {
+        std::string text = async_ele->GetText() != nullptr ? async_ele->GetText() : "";
+        if (text == "true" || text == "1")
+        {
+            int buffer = async_ele->IntAttribute("buffer");
+            if (buffer > 0)
+                coco::util::LoggerManager::instance()->enableAsync(buffer);
+            else
+                coco::util::LoggerManager::instance()->enableAsync();
+        }
+    }
     COCO_LOG_INFO()
 }
 
@@ -287,6 +333,7 @@ bool XmlParser::parseInclude(tinyxml2::XMLElement *include)
         return false;
     }
     COCO_DEBUG("xmlreader") << "Loading include " << config_file << " from " << file;
+    parsed_files_.push_back(config_file);
 
     XMLElement *package = xml_doc.FirstChildElement("package");
     if (package == 0)
@@ -678,7 +725,6 @@ void XmlParser::parseActivities(tinyxml2::XMLElement *activities)
         for(XMLElement *farm = activities ->FirstChildElement("farm"); farm; farm = farm->NextSiblingElement("farm"))
         {
             parseFarm(farm);
-            farm = farm->NextSiblingElement("farm");
         }
     }
 }
@@ -853,6 +899,7 @@ void XmlParser::parseFarm(tinyxml2::XMLElement *farm)
  * If realtime == FIFO || RR -> priority
  * If realtime == DEADLINE -> runtime && type == periodic
  * affinity and exclusive_affinity are always optional and correct
+ * lock_memory and prefault are optional and only for realtime activities
  */
 void XmlParser::parseSchedule(tinyxml2::XMLElement *schedule_policy,
                               SchedulePolicySpec &policy, bool &is_parallel)
@@ -868,6 +915,8 @@ void XmlParser::parseSchedule(tinyxml2::XMLElement *schedule_policy,
         const char *runtime = schedule_policy->Attribute("runtime");
         const char *affinity = schedule_policy->Attribute("affinity");
         const char *exclusive_affinity =  schedule_policy->Attribute("exclusive_affinity");
+        const char *lock_memory = schedule_policy->Attribute("lock_memory");
+        const char *prefault = schedule_policy->Attribute("prefault");
 
         if (!activity)
         {
@@ -980,6 +1029,32 @@ void XmlParser::parseSchedule(tinyxml2::XMLElement *schedule_policy,
             COCO_FATAL() << "Realtime DEADLINE needs attribute runtime to be specified";
         }
 
+        policy.lock_memory = false;
+        if (lock_memory && (strcasecmp(lock_memory, "true") == 0 || strcmp(lock_memory, "1") == 0))
+        {
+            if (policy.realtime == "none")
+            {
+                COCO_FATAL() << "Cannot lock the memory of an activity that is not realtime";
+            }
+            policy.lock_memory = true;
+        }
+        if (prefault)
+        {
+            if (!policy.lock_memory)
+            {
+                COCO_FATAL() << "Attribute prefault requires lock_memory";
+            }
+            char *end = nullptr;
+            errno = 0;
+            long prefault_kb = std::strtol(prefault, &end, 10);
+            if (end == prefault || *end != '\0' || errno == ERANGE ||
+                prefault_kb <= 0 || prefault_kb > INT_MAX)
+            {
+                COCO_FATAL() << "Attribute prefault must be a positive number of KiB, not " << prefault;
+            }
+            policy.prefault_kb = static_cast<int>(prefault_kb);
+        }
+
         policy.affinity = -1;
         policy.exclusive = false;
         if (affinity)
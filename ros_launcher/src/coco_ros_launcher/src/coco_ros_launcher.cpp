@@ -140,13 +140,14 @@ void launchApp(const std::vector<std::string> & config_files_path, bool profilin
 
     loader->enableProfiling(profiling);
 
-    if (latency.size() != 0)
+    for (unsigned i = 0; i + 1 < latency.size(); i += 2)
     {
-        auto src_task = COCO_TASK(latency[0]);
-        auto dst_task = COCO_TASK(latency[1]);
+        auto src_task = COCO_TASK(latency[i]);
+        auto dst_task = COCO_TASK(latency[i + 1]);
 
         if ((!src_task || !dst_task) || (coco::isPeer(src_task) || coco::isPeer(dst_task)))
-            COCO_FATAL() << "To use latency specify the name of two valid task.";
+            COCO_FATAL() << "To use latency specify the name of two valid task: "
+                         << latency[i] << " " << latency[i + 1];
 
         src_task->setTaskLatencySource();
         dst_task->setTaskLatencyTarget();
@@ -157,10 +158,7 @@ void launchApp(const std::vector<std::string> & config_files_path, bool profilin
 
     if (web_server_port > 0)
     {
-        std::string graph_svg = loader->graphSvg();
-        if (graph_svg.empty())
-            COCO_FATAL() << "Failed to create svg graph from execution setup";
-        if (!coco::WebServer::start(web_server_port, graph_spec->name, graph_svg, web_server_root))
+        if (!coco::WebServer::start(web_server_port, graph_spec->name, "", web_server_root))
         {
             COCO_FATAL()<< "Failed to initialize server on port: " << web_server_port << std::endl;
         }
@@ -209,9 +207,9 @@ int main(int argc, char **argv)
             disabled_component.insert(d);
 
         std::vector<std::string> latency = options.getStringVector("latency");
-        if (latency.size() > 0 && latency.size() != 2)
+        if (latency.size() % 2 != 0)
         {
-            COCO_FATAL() << "To calculate latency specify the name of two task. [-L task1 task2]";
+            COCO_FATAL() << "To calculate latency specify pairs of source and target task. [-L source1 target1 ...]";
         }
         
         launchApp(config_file, profiling, graph, port, root, disabled_component, latency);
@@ -54,9 +54,17 @@ public:
 
         auto task = COCO_TASK("EzTask2"); // This macro allows to retreive any task
 		if (task)
+		{
 			// Enqueue on task "EzTask2" the operation hello()
 			// This works only if EzTask2 add hello as operation
 			task->enqueueOperation<void(int)>("hello", count_ ++); 
+			// Call square() on EzTask2, the result is received by this task
+			// among its pending operations, before one of the next onUpdate()
+			task->callOperation<int(int)>("square", count_).then(this, [this](int r)
+				{
+					COCO_LOG(2) << "square: " << r;
+				});
+		}
 
 		// Iterate over each peer and call their function run() if they have it
 		for (auto peer : peers())
@@ -18,6 +18,7 @@ public:
 	coco::Attribute<float> ad_ = {this, "d", d_};
 	coco::InputPort<int> in_ = {this, "IN", true};
 	coco::Operation<void(int) > op = {this, "hello", &EzTask2::hello, this};
+	coco::Operation<int(int) > osquare_ = {this, "square", &EzTask2::square, this};
 
 	EzTask2()
 	{
@@ -28,6 +29,11 @@ public:
 		COCO_LOG(2) << "hello: " << x;
 	}
 
+	int square(int x)
+	{
+		return x * x;
+	}
+
 	virtual void init()
 	{
 		
@@ -10,6 +10,7 @@
 
 #include <chrono>
 #include <thread>
+#include <algorithm>
 #include <numeric>
 #include <coco/coco.h>
  
@@ -45,8 +46,8 @@ public:
 
     void init()
     {
-        vec_.resize(vec_length_);
-        std::iota(vec_.begin(), vec_.end(), 0);
+        /* Configured after the tasks producing its input */
+        configureAfterPort("time_IN");
     }
     void onConfig() {}
 
@@ -63,17 +64,17 @@ public:
          * 100000 - 15ms
          * 10000  -  6ms
          */
+        /* Per step data comes from the scratch arena, reset after onUpdate() */
+        coco::util::ScratchVector<double> vec(vec_length_, 0.0, scratchAllocator<double>());
+        std::iota(vec.begin(), vec.end(), 0);
 
-        //std::random_shuffle(vec_.begin(), vec_.end());
-        std::sort(vec_.begin(), vec_.end());
+        //std::random_shuffle(vec.begin(), vec.end());
+        std::sort(vec.begin(), vec.end());
         if (time != 0)
             out_time_.write(time);
     }
 private:
     int long vec_length_ = 10;
-
-    std::vector<double> vec_;
-
 };
 
 COCO_REGISTER(TaskLatMiddle)
@@ -87,11 +88,7 @@ public:
 
     coco::Attribute<int long> asleep_time_ = {this, "vec_length", vec_length_};
 
-    void init()
-    {
-        vec_.resize(vec_length_);
-        std::iota(vec_.begin(), vec_.end(), 0);
-    }
+    void init() {}
     void onConfig() {}
 
     void onUpdate()
@@ -107,18 +104,18 @@ public:
          * 100000 - 15ms
          * 10000  -  6ms
          */
+        /* Per step data comes from the scratch arena, reset after onUpdate() */
+        coco::util::ScratchVector<double> vec(vec_length_, 0.0, scratchAllocator<double>());
+        std::iota(vec.begin(), vec.end(), 0);
 
-        //std::random_shuffle(vec_.begin(), vec_.end());
-        std::sort(vec_.begin(), vec_.end());
+        //std::random_shuffle(vec.begin(), vec.end());
+        std::sort(vec.begin(), vec.end());
 
         out_time_.write(time);
         out_time2_.write(time);
     }
 private:
     int long vec_length_ = 10;
-
-    std::vector<double> vec_;
-
 };
 
 COCO_REGISTER(TaskLatMiddleStart)
@@ -132,11 +129,7 @@ public:
 
     coco::Attribute<int long> asleep_time_ = {this, "vec_length", vec_length_};
 
-    void init()
-    {
-        vec_.resize(vec_length_);
-        std::iota(vec_.begin(), vec_.end(), 0);
-    }
+    void init() {}
     void onConfig() {}
 
     void onUpdate()
@@ -154,17 +147,17 @@ public:
          * 100000 - 15ms
          * 10000  -  6ms
          */
+        /* Per step data comes from the scratch arena, reset after onUpdate() */
+        coco::util::ScratchVector<double> vec(vec_length_, 0.0, scratchAllocator<double>());
+        std::iota(vec.begin(), vec.end(), 0);
 
-        //std::random_shuffle(vec_.begin(), vec_.end());
-        std::sort(vec_.begin(), vec_.end());
+        //std::random_shuffle(vec.begin(), vec.end());
+        std::sort(vec.begin(), vec.end());
 
         out_time_.write(time);
     }
 private:
     int long vec_length_ = 10;
-
-    std::vector<double> vec_;
-
 };
 
 COCO_REGISTER(TaskLatMiddleSink)
@@ -190,8 +183,9 @@ public:
         if ( time != 0 )
         {
             latency_ += coco::util::time() - time;
-            static int count = 1;
-            COCO_LOG_SAMPLE("TaskLatSink", 10) << "Latency: " << double(latency_ / count++) / 1000000.0;
+            static int count = 0;
+            ++count;
+            COCO_LOG_SAMPLE("TaskLatSink", 10) << "Latency: " << double(latency_ / count) / 1000000.0;
         }
     }
 private:
@@ -0,0 +1,114 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+/* Measures the cost of logging statements that are filtered out and
+ * compares the text and the binary log when writing to a file.
+ * Usage: coco_log_benchmark [iterations] [output directory]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <coco/coco.h>
+
+namespace
+{
+volatile int sink = 0;
+
+template <class F>
+double nsPerCall(const char *name, unsigned long iterations, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; ++i)
+        f(i);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    std::cout << name << ": " << ns << " ns per statement\n";
+    return ns;
+}
+
+std::size_t fileSize(const std::string &name)
+{
+    std::ifstream file(name, std::ios::binary | std::ios::ate);
+    return file.is_open() ? static_cast<std::size_t>(file.tellg()) : 0;
+}
+}  // end of anonymous namespace
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::string directory = argc > 2 ? argv[2] : "/tmp";
+
+    /* Only level 0 and errors are enabled */
+    coco::util::LoggerManager::instance()->init();
+    coco::util::LoggerManager::instance()->setTypes({coco::util::Type::ERR});
+    coco::util::LoggerManager::instance()->setLevels({0});
+
+    double empty = nsPerCall("empty loop", iterations, [](unsigned long i) { sink = i; });
+    double eager = nsPerCall("disabled COCO_LOG, message always built", iterations,
+                             [](unsigned long i)
+                             {
+                                 coco::util::LogMessage(coco::util::Type::LOG, 5, "bench").stream()
+                                     << "value " << i;
+                             });
+    double lazy = nsPerCall("disabled COCO_LOG", iterations,
+                            [](unsigned long i)
+                            {
+                                COCO_LOG(5, "bench") << "value " << i;
+                            });
+    nsPerCall("disabled COCO_DEBUG", iterations,
+              [](unsigned long i)
+              {
+                  COCO_DEBUG("bench") << "value " << i;
+              });
+    std::cout << "COCO_DEBUG compiled " << (COCO_LOG_DEBUG_ENABLED ? "in" : "out") << "\n";
+    std::cout << "speedup of the level check in the macro: "
+              << (eager - empty) / std::max(lazy - empty, 0.01) << "x\n";
+
+    /* Enabled messages written only to a file */
+    const std::string text_file = directory + "/coco_log_benchmark.txt";
+    const std::string binary_file = directory + "/coco_log_benchmark.bin";
+    coco::util::LoggerManager::instance()->setLevels({0, 1});
+    coco::util::LoggerManager::instance()->setUseStdout(false);
+    coco::util::LoggerManager::instance()->setOutLogFile(text_file);
+    double text = nsPerCall("text log to file", iterations,
+                            [](unsigned long i)
+                            {
+                                COCO_LOG(1, "bench") << "step " << i << " value " << i * 0.5;
+                            });
+    coco::util::BinaryLog::instance().open(binary_file);
+    double binary = nsPerCall("binary log to file", iterations,
+                              [](unsigned long i)
+                              {
+                                  COCO_LOG_BIN(1, "step {} value {}", i, i * 0.5);
+                              });
+    coco::util::BinaryLog::instance().close();
+    std::size_t binary_size = fileSize(binary_file);
+    /* The calling thread only fills its log ring, the logger thread writes the file */
+    coco::util::LoggerManager::instance()->enableAsync(1 << 24);
+    coco::util::BinaryLog::instance().open(binary_file);
+    nsPerCall("binary log to file, asynchronous", iterations,
+              [](unsigned long i)
+              {
+                  COCO_LOG_BIN(1, "step {} value {}", i, i * 0.5);
+              });
+    coco::util::BinaryLog::instance().close();
+    coco::util::LoggerManager::instance()->disableAsync();
+    std::cout << coco::util::LoggerManager::instance()->droppedMessages()
+              << " messages dropped, the log ring was full\n";
+    coco::util::LoggerManager::instance()->setOutLogFile("");
+    std::size_t text_size = fileSize(text_file);
+    std::cout << "text log: " << text_size << " bytes, binary log: " << binary_size << " bytes\n";
+    std::cout << "binary log is " << text / binary << "x faster and "
+              << double(text_size) / std::max<std::size_t>(binary_size, 1) << "x smaller\n";
+    return 0;
+}
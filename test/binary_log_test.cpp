@@ -0,0 +1,102 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coco/util/binary_log.h"
+#include "check.h"
+
+using coco::util::BinaryArg;
+using coco::util::BinaryLog;
+using coco::util::LoggerManager;
+
+static const char *LOG_FILE = "binary_log_test.bin";
+
+static std::string decodeFile()
+{
+    std::ifstream in(LOG_FILE, std::ios::binary);
+    std::ostringstream out;
+    CHECK(BinaryLog::decode(in, out));
+    return out.str();
+}
+
+static int count(const std::string &text, const std::string &what)
+{
+    int found = 0;
+    for (std::size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+        ++found;
+    return found;
+}
+
+/* The types are resolved at compile time from the arguments */
+static void argumentTypes()
+{
+    typedef decltype(BinaryLog::argList("", 1, 2u, 0.5f, true, 'c', "text", std::string())) List;
+    CHECK(List::types[0] == BinaryArg::INT);
+    CHECK(List::types[1] == BinaryArg::UINT);
+    CHECK(List::types[2] == BinaryArg::DOUBLE);
+    CHECK(List::types[3] == BinaryArg::BOOL);
+    CHECK(List::types[4] == BinaryArg::CHAR);
+    CHECK(List::types[5] == BinaryArg::STRING);
+    CHECK(List::types[6] == BinaryArg::STRING);
+}
+
+/* What is written, by the calling thread or by the logger thread, is decoded back */
+static void roundTrip()
+{
+    CHECK(BinaryLog::instance().open(LOG_FILE));
+    int value = -42;
+    COCO_LOG_BIN(0, "int {} uint {} double {}", value, 7u, 0.25);
+    COCO_LOG_BIN(0, "bool {} char {} string {} {}", true, 'x', "literal", std::string("std"));
+    COCO_LOG_BIN(0, "no arguments");
+    COCO_LOG_BIN(0, "extra", 1, 2);
+    BinaryLog::instance().close();
+    std::string text = decodeFile();
+    CHECK(text.find("int -42 uint 7 double 0.25") != std::string::npos);
+    CHECK(text.find("bool true char x string literal std") != std::string::npos);
+    CHECK(text.find("no arguments") != std::string::npos);
+    CHECK(text.find("extra 1 2") != std::string::npos);
+
+    const int THREADS = 4;
+    const int MESSAGES = 500;
+    LoggerManager::instance()->enableAsync();
+    CHECK(BinaryLog::instance().open(LOG_FILE));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([t]()
+        {
+            for (int i = 0; i < MESSAGES; ++i)
+                COCO_LOG_BIN(0, "thread {} message {}", t, i);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    BinaryLog::instance().close();
+    LoggerManager::instance()->disableAsync();
+    text = decodeFile();
+    CHECK(count(text, " message ") == THREADS * MESSAGES);
+    CHECK(text.find("thread 3 message 499") != std::string::npos);
+}
+
+int main()
+{
+    LoggerManager::instance()->init();
+    LoggerManager::instance()->setUseStdout(false);
+    argumentTypes();
+    roundTrip();
+    std::remove(LOG_FILE);
+    return TEST_RESULT;
+}
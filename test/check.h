@@ -0,0 +1,26 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#pragma once
+#include <iostream>
+
+/* Minimal checks shared by the tests: a failed check is printed and counted,
+ * TEST_RESULT is returned by main */
+static int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) \
+    { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition << " failed\n"; \
+        ++failures; \
+    }
+
+#define TEST_RESULT \
+    (failures == 0 ? (std::cout << "All tests passed\n", 0) : 1)
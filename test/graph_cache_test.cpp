@@ -0,0 +1,167 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "coco/util/logging.h"
+#include "graph_cache.h"
+#include "check.h"
+
+using coco::GraphCache;
+using coco::TaskGraphSpec;
+using coco::TaskSpec;
+
+static const char *CACHE_FILE = "graph_cache_test.bin";
+static const char *XML_FILE = "graph_cache_test.xml";
+
+static void writeFile(const std::string &file, const std::string &content)
+{
+    std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+    stream << content;
+}
+
+static std::shared_ptr<TaskSpec> task(const std::string &name, const std::string &instance_name)
+{
+    std::shared_ptr<TaskSpec> spec(new TaskSpec());
+    spec->name = name;
+    spec->instance_name = instance_name;
+    return spec;
+}
+
+/* Two tasks with a peer, a connection, an activity and a farm sharing the tasks */
+static void buildGraph(TaskGraphSpec &spec)
+{
+    spec.name = "cache_test";
+    spec.log_config = "<log><levels>0</levels></log>";
+    spec.resources_paths = {"/tmp/a", "/tmp/b"};
+
+    auto source = task("Source", "source");
+    source->attributes.emplace_back("period", "10");
+    source->contents["info"] = "text";
+    source->peers.push_back(task("Peer", "source_peer"));
+    source->peers[0]->is_peer = true;
+    auto sink = task("Sink", "sink");
+    spec.tasks[source->instance_name] = source;
+    spec.tasks[sink->instance_name] = sink;
+
+    std::unique_ptr<coco::ConnectionSpec> connection(new coco::ConnectionSpec());
+    connection->src_task = source;
+    connection->src_port = "out";
+    connection->dest_task = sink;
+    connection->dest_port = "in";
+    connection->policy.data = "DATA";
+    connection->policy.policy = "LOCKED";
+    connection->policy.transport = "LOCAL";
+    connection->policy.buffersize = "4";
+    spec.connections.push_back(std::move(connection));
+
+    std::unique_ptr<coco::ActivitySpec> activity(new coco::ActivitySpec());
+    activity->policy.type = "periodic";
+    activity->policy.period = 10;
+    activity->policy.affinity = 1;
+    activity->policy.lock_memory = true;
+    activity->tasks = {source, sink};
+    spec.activities.push_back(std::move(activity));
+
+    std::unique_ptr<coco::FarmSpec> farm(new coco::FarmSpec());
+    std::unique_ptr<coco::PipelineSpec> pipeline(new coco::PipelineSpec());
+    pipeline->tasks = {spec.cloneTaskSpec(sink, "_0")};
+    pipeline->in_ports = {"in"};
+    pipeline->out_ports = {"out"};
+    farm->pipelines.push_back(std::move(pipeline));
+    farm->source_task = source;
+    farm->source_port = "out";
+    farm->gather_task = sink;
+    farm->gather_port = "in";
+    farm->num_workers = 1;
+    spec.farms.push_back(std::move(farm));
+}
+
+/* What is stored is loaded back with the same structure and shared tasks */
+static void roundTrip()
+{
+    writeFile(XML_FILE, "<package></package>");
+    TaskGraphSpec stored;
+    buildGraph(stored);
+    GraphCache writer(CACHE_FILE);
+    CHECK(writer.store({XML_FILE}, {XML_FILE}, stored));
+
+    std::shared_ptr<TaskGraphSpec> loaded(new TaskGraphSpec());
+    GraphCache reader(CACHE_FILE);
+    CHECK(reader.load({XML_FILE}, loaded));
+    CHECK(reader.files() == std::vector<std::string>{XML_FILE});
+    CHECK(loaded->name == "cache_test");
+    CHECK(loaded->log_config == stored.log_config);
+    CHECK(loaded->resources_paths == stored.resources_paths);
+    CHECK(loaded->tasks.size() == 2);
+    auto source = loaded->tasks["source"];
+    auto sink = loaded->tasks["sink"];
+    CHECK(source && sink);
+    if (!source || !sink)
+        return;
+    CHECK(source->name == "Source");
+    CHECK(source->attributes.size() == 1 && source->attributes[0].value == "10");
+    CHECK(source->contents["info"] == "text");
+    CHECK(source->peers.size() == 1 && source->peers[0]->is_peer);
+
+    CHECK(loaded->connections.size() == 1);
+    CHECK(loaded->connections[0]->src_task == source);
+    CHECK(loaded->connections[0]->dest_task == sink);
+    CHECK(loaded->connections[0]->policy.buffersize == "4");
+
+    CHECK(loaded->activities.size() == 1);
+    CHECK(loaded->activities[0]->policy.period == 10);
+    CHECK(loaded->activities[0]->policy.affinity == 1);
+    CHECK(loaded->activities[0]->policy.lock_memory);
+    CHECK(loaded->activities[0]->tasks.size() == 2 && loaded->activities[0]->tasks[0] == source);
+
+    CHECK(loaded->farms.size() == 1);
+    CHECK(loaded->farms[0]->source_task == source);
+    CHECK(loaded->farms[0]->gather_task == sink);
+    CHECK(loaded->farms[0]->pipelines.size() == 1);
+    CHECK(loaded->farms[0]->pipelines[0]->tasks[0]->instance_name == "sink_0");
+}
+
+/* A changed, removed or different set of xml files is a cache miss */
+static void staleCache()
+{
+    std::shared_ptr<TaskGraphSpec> loaded(new TaskGraphSpec());
+    CHECK(!GraphCache(CACHE_FILE).load({"other.xml"}, loaded));
+
+    writeFile(XML_FILE, "<package><log/></package>");
+    CHECK(!GraphCache(CACHE_FILE).load({XML_FILE}, loaded));
+
+    std::remove(XML_FILE);
+    uint64_t hash = 0;
+    CHECK(!GraphCache::hashFile(XML_FILE, hash));
+    CHECK(!GraphCache(CACHE_FILE).load({XML_FILE}, loaded));
+
+    /* An unreadable file cannot be hashed and the graph is not stored */
+    TaskGraphSpec stored;
+    buildGraph(stored);
+    CHECK(!GraphCache(CACHE_FILE).store({XML_FILE}, {XML_FILE}, stored));
+    CHECK(loaded->tasks.empty());
+}
+
+int main()
+{
+    coco::util::LoggerManager::instance()->init();
+    coco::util::LoggerManager::instance()->setUseStdout(false);
+    roundTrip();
+    staleCache();
+    std::remove(CACHE_FILE);
+    std::remove(XML_FILE);
+    return TEST_RESULT;
+}
@@ -0,0 +1,143 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <memory>
+#include <string>
+
+#include "coco/util/inplace_function.h"
+#include "check.h"
+
+using coco::util::InplaceFunction;
+
+typedef InplaceFunction<int(int), 32> Function;
+
+/* Counts the instances alive and how they were made */
+struct Counted
+{
+    static int alive;
+    static int copies;
+    static int moves;
+
+    Counted() { ++alive; }
+    Counted(const Counted &) { ++alive; ++copies; }
+    Counted(Counted &&) noexcept { ++alive; ++moves; }
+    ~Counted() { --alive; }
+
+    static void clear() { alive = copies = moves = 0; }
+};
+int Counted::alive = 0;
+int Counted::copies = 0;
+int Counted::moves = 0;
+
+struct Small
+{
+    Counted counted;
+    int add = 1;
+    int operator()(int v) const { return v + add; }
+};
+
+struct Big
+{
+    Counted counted;
+    char padding[64] = {};
+    int operator()(int v) const { return v * 2; }
+};
+
+/* Like Small, but a throwing move cannot be relocated inside the buffer */
+struct ThrowingMove
+{
+    ThrowingMove() {}
+    ThrowingMove(const ThrowingMove &) {}
+    ThrowingMove(ThrowingMove &&) {}
+    int operator()(int v) const { return v; }
+};
+
+/* The buffer holds what fits, is aligned and moves without throwing */
+static void capacity()
+{
+    static_assert(Function::storedInline<Small>(), "Small fits in 32 bytes");
+    static_assert(!Function::storedInline<Big>(), "Big is allocated");
+    static_assert(!Function::storedInline<ThrowingMove>(), "a throwing move is allocated");
+    static_assert(Function::storedInline<int (*)(int)>(), "a function pointer fits");
+    CHECK(sizeof(Small) <= 32 && sizeof(Big) > 32);
+}
+
+/* A callable is moved in from an rvalue, copied from an lvalue, and destroyed
+ * once by reset(), by a new assign() or by the destructor */
+static void lifetime()
+{
+    Counted::clear();
+    {
+        Function fx;
+        CHECK(!fx);
+        fx.assign(Small());
+        CHECK(fx && fx(1) == 2);
+        CHECK(Counted::alive == 1 && Counted::copies == 0 && Counted::moves == 1);
+
+        Small small;
+        small.add = 10;
+        fx.assign(small);
+        CHECK(fx(1) == 11);
+        CHECK(Counted::alive == 2 && Counted::copies == 1);
+
+        fx.reset();
+        CHECK(!fx);
+        CHECK(Counted::alive == 1);
+        fx.reset();
+        CHECK(Counted::alive == 1);
+
+        fx.assign(std::move(small));
+        CHECK(Counted::alive == 2);
+    }
+    CHECK(Counted::alive == 0);
+
+    /* The allocated callables follow the same rules */
+    Counted::clear();
+    {
+        Function fx;
+        fx.assign(Big());
+        CHECK(fx(3) == 6);
+        CHECK(Counted::alive == 1 && Counted::copies == 0);
+        fx.assign(Small());
+        CHECK(Counted::alive == 1);
+        fx.assign(Big());
+    }
+    CHECK(Counted::alive == 0);
+}
+
+struct MoveOnly
+{
+    std::unique_ptr<int> value;
+    int operator()() const { return *value; }
+};
+
+/* Move only callables and references to the arguments are forwarded */
+static void moveOnly()
+{
+    MoveOnly move_only;
+    move_only.value.reset(new int(5));
+    InplaceFunction<int(), 32> fx;
+    fx.assign(std::move(move_only));
+    CHECK(!move_only.value && fx() == 5);
+
+    InplaceFunction<void(std::string &), 16> append;
+    append.assign([](std::string &text) { text += "!"; });
+    std::string text = "done";
+    append(text);
+    CHECK(text == "done!");
+}
+
+int main()
+{
+    capacity();
+    lifetime();
+    moveOnly();
+    return TEST_RESULT;
+}
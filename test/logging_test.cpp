@@ -0,0 +1,91 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coco/util/logging.h"
+#include "check.h"
+
+using coco::util::LoggerManager;
+
+static const char *LOG_FILE = "logging_test.txt";
+
+static int countLines(const std::string &text)
+{
+    std::ifstream file(LOG_FILE);
+    std::string line;
+    int count = 0;
+    while (std::getline(file, line))
+    {
+        if (line.find(text) != std::string::npos)
+            ++count;
+    }
+    return count;
+}
+
+/* Every message logged before disableAsync() returns is written, also across
+ * several enable/disable cycles */
+static void asyncCyclesKeepAllMessages()
+{
+    const int CYCLES = 3;
+    const int THREADS = 4;
+    const int MESSAGES = 200;
+    for (int cycle = 0; cycle < CYCLES; ++cycle)
+    {
+        LoggerManager::instance()->enableAsync();
+        CHECK(LoggerManager::instance()->isAsync());
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; ++t)
+        {
+            threads.emplace_back([]()
+            {
+                for (int i = 0; i < MESSAGES; ++i)
+                    COCO_LOG(0, "test") << "cycle message " << i;
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        LoggerManager::instance()->disableAsync();
+        CHECK(!LoggerManager::instance()->isAsync());
+        CHECK(countLines("cycle message") == (cycle + 1) * THREADS * MESSAGES);
+    }
+    CHECK(LoggerManager::instance()->droppedMessages() == 0);
+}
+
+/* Messages logged while disableAsync() runs are either queued and drained or written directly */
+static void disableWhileLogging()
+{
+    LoggerManager::instance()->enableAsync();
+    const int MESSAGES = 2000;
+    std::thread producer([]()
+    {
+        for (int i = 0; i < MESSAGES; ++i)
+            COCO_LOG(0, "test") << "racing message " << i;
+    });
+    std::this_thread::yield();
+    LoggerManager::instance()->disableAsync();
+    producer.join();
+    CHECK(countLines("racing message") + static_cast<int>(LoggerManager::instance()->droppedMessages()) == MESSAGES);
+}
+
+int main()
+{
+    LoggerManager::instance()->init();
+    LoggerManager::instance()->setUseStdout(false);
+    LoggerManager::instance()->setOutLogFile(LOG_FILE);
+    asyncCyclesKeepAllMessages();
+    disableWhileLogging();
+    std::remove(LOG_FILE);
+    return TEST_RESULT;
+}
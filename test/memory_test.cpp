@@ -0,0 +1,46 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <utility>
+
+#include "coco/util/memory.hpp"
+#include "check.h"
+
+/* A moved from pooled vector keeps its pool and can be filled again */
+static void movedVectorIsReusable()
+{
+    auto pool = std::make_shared<coco::util::MemoryPool>();
+    coco::util::Vector<int> source{coco::util::PoolAllocator<int>(pool)};
+    for (int i = 0; i < 100; ++i)
+        source.push_back(i);
+
+    coco::util::Vector<int> moved(std::move(source));
+    CHECK(moved.size() == 100);
+    CHECK(moved.get_allocator().pool() == pool);
+    CHECK(source.get_allocator().pool() == pool);
+
+    source.clear();
+    for (int i = 0; i < 100; ++i)
+        source.push_back(i);
+    CHECK(source.size() == 100 && source.back() == 99);
+
+    coco::util::Vector<int> assigned;
+    assigned = std::move(source);
+    CHECK(assigned.get_allocator().pool() == pool);
+    CHECK(source.get_allocator().pool() != nullptr);
+    source.push_back(1);
+    CHECK(source.size() == 1);
+}
+
+int main()
+{
+    movedVectorIsReusable();
+    return TEST_RESULT;
+}
@@ -0,0 +1,181 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "coco/util/mpsc_queue.h"
+#include "check.h"
+
+using coco::util::MpscNode;
+using coco::util::MpscQueue;
+using coco::util::NodePool;
+
+struct Item : public MpscNode
+{
+    int producer = 0;
+    int sequence = 0;
+    std::atomic<bool> in_use = {false};
+};
+
+/* A single thread gets back the nodes in the order they were pushed */
+static void fifo()
+{
+    MpscQueue<Item> queue;
+    CHECK(queue.pop() == nullptr);
+    Item items[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        items[i].sequence = i;
+        queue.push(&items[i]);
+    }
+    CHECK(queue.size() == 4);
+    for (int i = 0; i < 4; ++i)
+    {
+        Item *item = queue.pop();
+        CHECK(item == &items[i]);
+    }
+    CHECK(queue.pop() == nullptr);
+    CHECK(queue.size() == 0);
+
+    /* The stub is pushed again when the queue is drained, the nodes can be reused */
+    queue.push(&items[2]);
+    CHECK(queue.pop() == &items[2]);
+    queue.push(&items[2]);
+    CHECK(queue.pop() == &items[2]);
+    CHECK(queue.pop() == nullptr);
+}
+
+/* Every node is handed out once until released, then the pool is exhausted */
+static void poolExhaustion()
+{
+    const uint32_t N = 8;
+    NodePool<Item, N> pool;
+    std::set<Item *> acquired;
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        Item *item = pool.acquire();
+        CHECK(item && pool.owns(item));
+        acquired.insert(item);
+    }
+    CHECK(acquired.size() == N);
+    CHECK(pool.acquire() == nullptr);
+    Item outside;
+    CHECK(!pool.owns(&outside));
+
+    Item *last = *acquired.begin();
+    pool.release(last);
+    CHECK(pool.acquire() == last);
+    for (Item *item : acquired)
+        pool.release(item);
+    acquired.clear();
+    for (uint32_t i = 0; i < N; ++i)
+        acquired.insert(pool.acquire());
+    CHECK(acquired.size() == N && acquired.count(nullptr) == 0);
+}
+
+/* Threads acquire and release a few nodes as fast as they can: a stale head
+ * exchanged after the same node came back (ABA) hands a node out twice */
+static void poolReuse()
+{
+    const int THREADS = 4;
+    const int ROUNDS = 200000;
+    NodePool<Item, 4> pool;
+    std::atomic<int> double_acquire = {0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&]()
+        {
+            for (int i = 0; i < ROUNDS; ++i)
+            {
+                Item *item = pool.acquire();
+                if (!item)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (item->in_use.exchange(true))
+                    ++double_acquire;
+                item->in_use.store(false);
+                pool.release(item);
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    CHECK(double_acquire == 0);
+    int free_nodes = 0;
+    while (pool.acquire())
+        ++free_nodes;
+    CHECK(free_nodes == 4);
+}
+
+/* Producers push nodes taken from a small pool, the consumer pops them and gives
+ * them back: the order of each producer is preserved and nothing is lost */
+static void multiProducer()
+{
+    const int PRODUCERS = 4;
+    const int MESSAGES = 50000;
+    NodePool<Item, 64> pool;
+    MpscQueue<Item> queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        producers.emplace_back([&, p]()
+        {
+            for (int i = 0; i < MESSAGES; ++i)
+            {
+                Item *item;
+                while (!(item = pool.acquire()))
+                    std::this_thread::yield();
+                item->producer = p;
+                item->sequence = i;
+                queue.push(item);
+            }
+        });
+    }
+
+    std::vector<int> next(PRODUCERS, 0);
+    int received = 0;
+    int out_of_order = 0;
+    while (received < PRODUCERS * MESSAGES)
+    {
+        Item *item = queue.pop();
+        if (!item)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item->sequence != next[item->producer])
+            ++out_of_order;
+        next[item->producer] = item->sequence + 1;
+        ++received;
+        pool.release(item);
+    }
+    for (auto &producer : producers)
+        producer.join();
+    CHECK(out_of_order == 0);
+    CHECK(queue.pop() == nullptr);
+    CHECK(queue.size() == 0);
+    for (int p = 0; p < PRODUCERS; ++p)
+        CHECK(next[p] == MESSAGES);
+}
+
+int main()
+{
+    fifo();
+    poolExhaustion();
+    poolReuse();
+    multiProducer();
+    return TEST_RESULT;
+}
@@ -0,0 +1,127 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "coco/util/rcu.h"
+#include "check.h"
+
+using coco::util::Rcu;
+
+static const int ALIVE = 0x600d;
+static std::atomic<int> live_values = {0};
+
+/* The two halves are always updated together, the marker is cleared on destruction */
+struct Value
+{
+    Value() { ++live_values; }
+    Value(const Value &other)
+        : first(other.first), second(other.second)
+    {
+        ++live_values;
+    }
+    ~Value()
+    {
+        marker = 0;
+        --live_values;
+    }
+    int first = 0;
+    int second = 0;
+    volatile int marker = ALIVE;
+};
+
+/* An update is visible to the readers started after it */
+static void readUpdate()
+{
+    Rcu<Value> rcu;
+    CHECK(rcu.read()->first == 0);
+    rcu.update([](Value &value) { value.first = value.second = 3; });
+    auto guard = rcu.read();
+    CHECK(guard->first == 3 && (*guard).second == 3);
+    /* A moved guard still keeps the value */
+    auto moved = std::move(guard);
+    CHECK(moved->first == 3);
+}
+
+/* update() returns only after the readers of the old value released it */
+static void updateWaitsReaders()
+{
+    Rcu<Value> rcu;
+    std::atomic<bool> updated = {false};
+    std::thread writer;
+    {
+        auto guard = rcu.read();
+        writer = std::thread([&]()
+        {
+            rcu.update([](Value &value) { value.first = value.second = 1; });
+            updated = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(!updated);
+        CHECK(guard->marker == ALIVE && guard->first == 0);
+    }
+    writer.join();
+    CHECK(updated);
+    CHECK(rcu.read()->first == 1);
+}
+
+/* Readers never see a half updated or deleted value while writers replace it */
+static void concurrentUpdates()
+{
+    const int READERS = 3;
+    const int UPDATES = 2000;
+    {
+        Rcu<Value> rcu;
+        std::atomic<bool> stop = {false};
+        std::atomic<int> broken = {0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < READERS; ++r)
+        {
+            readers.emplace_back([&]()
+            {
+                while (!stop)
+                {
+                    auto guard = rcu.read();
+                    int first = guard->first;
+                    std::this_thread::yield();
+                    if (guard->marker != ALIVE || guard->second != first)
+                        ++broken;
+                }
+            });
+        }
+        std::thread second_writer([&]()
+        {
+            for (int i = 0; i < UPDATES; ++i)
+                rcu.update([](Value &value) { value.second = ++value.first; });
+        });
+        for (int i = 0; i < UPDATES; ++i)
+            rcu.update([](Value &value) { value.first = ++value.second; });
+        second_writer.join();
+        stop = true;
+        for (auto &reader : readers)
+            reader.join();
+        CHECK(broken == 0);
+        CHECK(rcu.read()->first == 2 * UPDATES);
+        /* The replaced values have been deleted */
+        CHECK(live_values == 1);
+    }
+    CHECK(live_values == 0);
+}
+
+int main()
+{
+    readUpdate();
+    updateWaitsReaders();
+    concurrentUpdates();
+    return TEST_RESULT;
+}
@@ -0,0 +1,196 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "coco/telemetry.h"
+#include "coco/util/logging.h"
+#include "check.h"
+
+using coco::TelemetryConnection;
+using coco::TelemetryHeader;
+using coco::TelemetryReader;
+using coco::TelemetrySnapshot;
+using coco::TelemetryTask;
+
+static const char *SEGMENT = "coco_telemetry_test";
+static const uint32_t MAX_TASKS = 4;
+static const uint32_t MAX_CONNECTIONS = 2;
+
+/* A segment written by the test itself, to control the seqlock of the writer */
+class Segment
+{
+public:
+    Segment()
+    {
+        std::string path = std::string("/") + SEGMENT;
+        shm_unlink(path.c_str());
+        size_ = sizeof(TelemetryHeader) + MAX_TASKS * sizeof(TelemetryTask) +
+                MAX_CONNECTIONS * sizeof(TelemetryConnection);
+        int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0 || ftruncate(fd, size_) < 0)
+            return;
+        void *memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+            return;
+        header_ = new (memory) TelemetryHeader();
+        memcpy(header_->magic, "COCOTLM", 8);
+        header_->version = coco::TELEMETRY_VERSION;
+        header_->max_tasks = MAX_TASKS;
+        header_->max_connections = MAX_CONNECTIONS;
+        header_->seq.store(0);
+        header_->task_count = MAX_TASKS;
+        tasks_ = reinterpret_cast<TelemetryTask *>(header_ + 1);
+    }
+    ~Segment()
+    {
+        if (header_)
+            munmap(header_, size_);
+        shm_unlink((std::string("/") + SEGMENT).c_str());
+    }
+    bool ok() const { return header_ != nullptr; }
+
+    /* Every value of an update is the same number, a torn copy mixes two of them */
+    void write(uint64_t value)
+    {
+        uint32_t seq = header_->seq.load(std::memory_order_relaxed);
+        header_->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header_->updates = value;
+        header_->time_us = static_cast<int64_t>(value);
+        for (uint32_t i = 0; i < MAX_TASKS; ++i)
+        {
+            tasks_[i].steps = value;
+            tasks_[i].triggers = value;
+            tasks_[i].memory_allocations = value;
+        }
+        header_->seq.store(seq + 2, std::memory_order_release);
+    }
+    TelemetryHeader *header_ = nullptr;
+
+private:
+    TelemetryTask *tasks_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+static bool consistent(const TelemetrySnapshot &snapshot)
+{
+    if (snapshot.tasks.size() != MAX_TASKS || snapshot.time_us != static_cast<int64_t>(snapshot.updates))
+        return false;
+    for (auto &task : snapshot.tasks)
+    {
+        if (task.steps != snapshot.updates || task.triggers != snapshot.updates ||
+            task.memory_allocations != snapshot.updates)
+            return false;
+    }
+    return true;
+}
+
+/* The copies taken while the writer updates the segment are never torn */
+static void concurrentReads()
+{
+    Segment segment;
+    CHECK(segment.ok());
+    if (!segment.ok())
+        return;
+    segment.write(1);
+    TelemetryReader reader;
+    CHECK(reader.open(SEGMENT));
+
+    std::atomic<bool> stop = {false};
+    std::thread writer([&]()
+    {
+        uint64_t value = 2;
+        while (!stop)
+            segment.write(value++);
+    });
+    int torn = 0;
+    int failed = 0;
+    uint64_t last = 0;
+    bool monotonic = true;
+    for (int i = 0; i < 20000; ++i)
+    {
+        TelemetrySnapshot snapshot;
+        if (!reader.read(snapshot))
+        {
+            ++failed;
+            continue;
+        }
+        if (!consistent(snapshot))
+            ++torn;
+        monotonic = monotonic && snapshot.updates >= last;
+        last = snapshot.updates;
+    }
+    stop = true;
+    writer.join();
+    CHECK(torn == 0);
+    CHECK(monotonic);
+    /* On a single core the writer can hold the odd sequence while the reader spins */
+    CHECK(failed < 20000);
+}
+
+/* A writer that never completes its update makes the read fail, not block */
+static void stuckWriter()
+{
+    Segment segment;
+    CHECK(segment.ok());
+    if (!segment.ok())
+        return;
+    segment.write(1);
+    TelemetryReader reader;
+    CHECK(reader.open(SEGMENT));
+    TelemetrySnapshot snapshot;
+    CHECK(reader.read(snapshot) && snapshot.updates == 1);
+    segment.header_->seq.store(segment.header_->seq.load() + 1);
+    CHECK(!reader.read(snapshot));
+
+    /* A segment of another version is not opened */
+    segment.header_->version = coco::TELEMETRY_VERSION + 1;
+    TelemetryReader other;
+    CHECK(!other.open(SEGMENT));
+}
+
+/* The publisher updates its segment until it is stopped, then removes it */
+static void publisher()
+{
+    CHECK(coco::Telemetry::start(SEGMENT, 100));
+    CHECK(coco::Telemetry::isRunning());
+    TelemetryReader reader;
+    CHECK(reader.open(SEGMENT));
+    TelemetrySnapshot first, second;
+    CHECK(reader.read(first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(reader.read(second));
+    CHECK(second.updates > first.updates);
+    CHECK(second.pid == static_cast<uint32_t>(getpid()));
+    CHECK(second.tasks.empty());
+    reader.close();
+
+    coco::Telemetry::stop();
+    CHECK(!coco::Telemetry::isRunning());
+    CHECK(!reader.open(SEGMENT));
+}
+
+int main()
+{
+    coco::util::LoggerManager::instance()->init();
+    coco::util::LoggerManager::instance()->setUseStdout(false);
+    concurrentReads();
+    stuckWriter();
+    publisher();
+    return TEST_RESULT;
+}
@@ -0,0 +1,90 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "coco/util/timing.h"
+#include "check.h"
+
+/* Readers never see a half published accumulator: the fields of a snapshot
+ * always belong to the same number of executions */
+static void readersSeeConsistentSnapshots()
+{
+    coco::util::Timer timer;
+    std::atomic<bool> done = {false};
+    std::atomic<int> torn = {0};
+    std::atomic<int> backwards = {0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r)
+    {
+        readers.emplace_back([&]()
+        {
+            unsigned long previous = 0;
+            while (!done)
+            {
+                auto t = timer.timeStatistics(false);
+                if (t.iterations < previous)
+                    ++backwards;
+                previous = t.iterations;
+                if (t.iterations == 0)
+                    continue;
+                double expected = t.mean * t.iterations;
+                if (std::fabs(expected - t.elapsed) > 1e-9 * std::max(1.0, t.elapsed) ||
+                    t.min > t.mean + 1e-12 || t.mean > t.max + 1e-12)
+                    ++torn;
+            }
+        });
+    }
+
+    const unsigned long STEPS = 200000;
+    volatile unsigned sink = 0;
+    for (unsigned long i = 0; i < STEPS; ++i)
+    {
+        timer.start();
+        for (unsigned j = 0; j < (i % 64) * 10; ++j)
+            sink = sink + j;
+        timer.stop();
+    }
+    done = true;
+    for (auto &reader : readers)
+        reader.join();
+
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    CHECK(timer.iterations() == STEPS);
+}
+
+/* A reset requested by another thread is applied at the next start */
+static void resetIsAppliedByTheWriter()
+{
+    coco::util::Timer timer;
+    for (int i = 0; i < 10; ++i)
+    {
+        timer.start();
+        timer.stop();
+    }
+    CHECK(timer.iterations() == 10);
+    timer.reset();
+    CHECK(timer.iterations() == 10);
+    timer.start();
+    timer.stop();
+    CHECK(timer.iterations() == 1);
+}
+
+int main()
+{
+    readersSeeConsistentSnapshots();
+    resetIsAppliedByTheWriter();
+    return TEST_RESULT;
+}
@@ -0,0 +1,53 @@
+/**
+ * Project: CoCo
+ * Copyright (c) 2016, Scuola Superiore Sant'Anna
+ *
+ * Authors: Filippo Brizzi <fi.brizzi@sssup.it>, Emanuele Ruffaldi
+ *
+ * This file is subject to the terms and conditions defined in
+ * file 'LICENSE.txt', which is part of this source code package.
+ */
+
+#include <memory>
+#include <string>
+
+#include "coco/util/tracing.h"
+#include "check.h"
+
+using coco::util::Tracer;
+
+/* Equal names share one copy, different names don't */
+static void internSharesEqualNames()
+{
+    std::string name = "task_a";
+    const char *first = Tracer::intern(name);
+    const char *second = Tracer::intern(std::string("task_") + "a");
+    CHECK(first == second);
+    CHECK(first != name.c_str());
+    CHECK(Tracer::intern("task_b") != first);
+}
+
+/* The events of a destroyed owner, e.g. a task removed at runtime, are still exported */
+static void eventsOutliveTheirOwner()
+{
+    Tracer::instance().enable(64);
+    {
+        std::unique_ptr<std::string> owner(new std::string("removed_task"));
+        const char *name = Tracer::intern(*owner);
+        Tracer::begin("task", name);
+        Tracer::end("task", name);
+        uint64_t flow = Tracer::flowOut("connection", name);
+        Tracer::flowIn("connection", name, flow);
+    }
+    Tracer::instance().disable();
+    std::string json = Tracer::instance().chromeJson();
+    CHECK(json.find("\"name\":\"removed_task\",\"cat\":\"task\",\"ph\":\"B\"") != std::string::npos);
+    CHECK(json.find("\"ph\":\"f\"") != std::string::npos);
+}
+
+int main()
+{
+    internSharesEqualNames();
+    eventsOutliveTheirOwner();
+    return TEST_RESULT;
+}
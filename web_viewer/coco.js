@@ -50,6 +50,115 @@ var json = null;
 var init = true;
 var plots_init = true;
 
+/* state holds the rows received from coco's webserver, indexed by section and key.
+ * The webserver sends the full state once and then only the changed rows,
+ * a null row has been removed.
+ */
+var state = {};
+var sections = ["activities", "tasks", "components", "stats", "connections", "overlay"];
+
+/* graph.svg is drawn by coco's webserver and downloaded again when graph_version changes.
+ * The load of the tasks and the rate of the connections are drawn on it from the "overlay"
+ * section, whose keys are the ids of the elements.
+ */
+var graph_version = null;
+var svgGraph = null;
+var svgDefs = null;
+
+function loadColor(load)
+{
+	load = Math.max(0, Math.min(1, load));
+	var hex = function(v) { return ("0" + Math.round(v).toString(16)).slice(-2); };
+	return "#ff" + hex(255 - 120 * load) + hex(255 - 255 * load);
+}
+
+function applyOverlay(key, row)
+{
+	var element = document.getElementById(key);
+	if (!element)
+		return;
+	var text = element.querySelector(".overlay");
+	if (key.indexOf("task:") == 0)
+	{
+		var load = row ? row.load : null;
+		text.textContent = load === null ? "" : (load * 100).toFixed(0) + "%";
+		element.querySelector("rect").setAttribute("fill", load === null ? "#ffffff" : loadColor(load));
+	}
+	else
+	{
+		var rate = row ? row.rate : null;
+		text.textContent = rate === null ? "" : (rate < 10 ? rate.toFixed(1) : rate.toFixed(0)) + "/s";
+		element.querySelector("path").setAttribute("stroke-width",
+			rate === null ? 1.2 : 1.2 + Math.min(4, Math.log(1 + rate) / Math.LN10));
+	}
+}
+
+function loadGraph()
+{
+	var snap = Snap(document.getElementById("svg"));
+	Snap.load("graph.svg", function(f) {
+		if (svgGraph)
+			svgGraph.remove();
+		if (svgDefs)
+			svgDefs.remove();
+		svg = f.select("svg");
+		svgDefs = f.select("defs");
+		svgGraph = f.select("#graph0");
+		snap.append(svgDefs);
+		snap.append(svgGraph);
+		svgGraph.drag();
+		for (var key in state.overlay)
+			applyOverlay(key, state.overlay[key]);
+		$("#svg").css("width", $("#content").width() * 0.99);
+		$("#svg").css("height", $("#content").height() - ($("#toolbar").height() * 1.5));
+	});
+}
+
+function rows(section)
+{
+	var list = [];
+	for (var key in state[section])
+		list.push(state[section][key]);
+	return list;
+}
+
+function applyState(delta)
+{
+	if (delta.full)
+	{
+		state = {};
+		for (var i=0; i<sections.length; i++)
+			state[sections[i]] = {};
+		state.info = delta.info;
+	}
+	for (var i=0; i<sections.length; i++)
+	{
+		var name = sections[i];
+		var changes = delta[name];
+		for (var key in changes)
+		{
+			if (changes[key] === null)
+				delete state[name][key];
+			else
+				state[name][key] = changes[key];
+			if (name == "overlay")
+				applyOverlay(key, changes[key]);
+		}
+	}
+	if (delta.graph !== graph_version)
+	{
+		if (graph_version !== null)
+			loadGraph();
+		graph_version = delta.graph;
+	}
+	if (delta.log)
+		$("#console").append("<pre>" + delta.log + "</pre>");
+
+	json = { info: state.info };
+	for (var i=0; i<sections.length; i++)
+		json[sections[i]] = rows(sections[i]);
+}
+
 
 /* plots_samples holds the last 50 samples for each plot */
 var plots_samples = [];
@@ -168,8 +277,6 @@ function ui() {
 		$("#project_name").text(json.info.project_name);
 		init = false;
 	}
-	// updates log console
-	$("#console").append("<pre>" + json.log + "</pre>");
 	// updates ui's content depending on which tab is selected:
 	// only the currently selected tab is updated to improve performance
 	if (selectedTab == "#tabs-activities")
@@ -234,28 +341,12 @@ $(function() {
 		value: 1,
 		slide: function(event, ui) {
 			var s = ui.value;
-			var t = svg.attr('viewBox');
-			svgGraph.transform('scale('+s+' '+s+') rotate(0) translate(4 '+(t.h-4)+')');
+			svgGraph.transform('scale('+s+' '+s+')');
 		}
 	});
 	
-	/* load the SVG from  */
-	var snap = Snap(document.getElementById("svg"));
-	Snap.load("graph.svg", function(f) {
-		svg = f.select("svg");
-		svgGraph = f.select("#graph0");
-		$.each(f.selectAll("#clust1"), function(idx, obj) {
-			obj.parent().drag();
-		});
-		// $.each(f.selectAll("g"), function(idx, obj) {
-		// 	obj.parent().drag();
-		// });
-		g = f.select("g");
-		snap.append(g);
-		g.drag();
-		$("#svg").css("width", $("#content").width() * 0.99);
-		$("#svg").css("height", $("#content").height() - ($("#toolbar").height() * 1.5));
-	});
+	/* load the SVG drawn by coco's webserver */
+	loadGraph();
 
 	// setup of the UI's data tables
 	tableActivities = $("#table-activities").DataTable({
@@ -301,7 +392,10 @@ $(function() {
 			{ "data": "time_exec_mean" },
 			{ "data": "time_exec_stddev" },
 			{ "data": "time_min" },
-			{ "data": "time_max" }
+			{ "data": "time_max" },
+			{ "data": "time_p50" },
+			{ "data": "time_p99" },
+			{ "data": "time_p999" }
 		],
 		"select": "single",
 		"scrollY": "500px",
@@ -366,14 +460,14 @@ $(function() {
 	if ("WebSocket" in window)
 	{
 		// creates the websocket client
-		// coco's webserver will spontaneously send json data every x milliseconds
+		// coco's webserver will spontaneously send the changes every x milliseconds
 		ws = new WebSocket("ws://" + document.location.host);
 		ws.onopen = function() {
 
 		};
 		ws.onmessage = function(evt) {
-			// parse the json sent by coco's server
-			json = $.parseJSON(evt.data);
+			// merge the changes sent by coco's server
+			applyState($.parseJSON(evt.data));
 		};
 		ws.onclose = function()
 		{